@@ -0,0 +1,88 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dlr_data_transform.h"
+
+/*! \brief Measures CategoricalString input transforms on random rows, looking up the JSON maps
+ * and using the compiled hash tables. Reports cells per second for the lookup alone and for
+ * TransformInput including parsing the JSON input.
+ */
+int main(int argc, char** argv) {
+  const int num_col = argc >= 2 ? std::stoi(argv[1]) : 40;
+  const int vocab_size = argc >= 3 ? std::stoi(argv[2]) : 1000;
+  const int num_row = argc >= 4 ? std::stoi(argv[3]) : 1000;
+  const int iterations = argc >= 5 ? std::stoi(argv[4]) : 20;
+
+  nlohmann::json maps = nlohmann::json::array();
+  for (int c = 0; c < num_col; c++) {
+    nlohmann::json map = nlohmann::json::object();
+    for (int v = 0; v < vocab_size; v++) {
+      map["column" + std::to_string(c) + "_category" + std::to_string(v)] = v;
+    }
+    maps.push_back(map);
+  }
+  nlohmann::json metadata;
+  metadata["DataTransform"]["Input"]["ColumnTransform"] = {
+      {{"Type", "CategoricalString"}, {"Map", maps}}};
+
+  // One in ten values is not in the map.
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> category(0, vocab_size * 10 / 9);
+  nlohmann::json rows = nlohmann::json::array();
+  for (int r = 0; r < num_row; r++) {
+    nlohmann::json row = nlohmann::json::array();
+    for (int c = 0; c < num_col; c++) {
+      row.push_back("column" + std::to_string(c) + "_category" + std::to_string(category(rng)));
+    }
+    rows.push_back(row);
+  }
+  const std::string input = rows.dump();
+  const int64_t shape[1] = {static_cast<int64_t>(input.size())};
+  const std::vector<DLDataType> dtypes = {DLDataType{kDLFloat, 32, 1}};
+  const DLContext ctx = {kDLCPU, 0};
+  const double num_cells = static_cast<double>(num_row) * num_col * iterations;
+  std::cout << "rows: " << num_row << ", columns: " << num_col << ", categories: " << vocab_size
+            << std::endl;
+
+  dlr::CategoricalStringTransformer transformer;
+  const nlohmann::json& transform = metadata["DataTransform"]["Input"]["ColumnTransform"][0];
+  auto start = std::chrono::steady_clock::now();
+  const std::vector<dlr::CategoricalStringTable> tables = transformer.Compile(transform);
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "compile: " << std::chrono::duration<double, std::milli>(end - start).count()
+            << " ms" << std::endl;
+
+  tvm::runtime::NDArray output = tvm::runtime::NDArray::Empty({num_row, num_col}, dtypes[0], ctx);
+  for (bool compiled : {false, true}) {
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      if (compiled) {
+        transformer.MapToNDArray(rows, tables, output);
+      } else {
+        transformer.MapToNDArray(rows, transform, output);
+      }
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout << (compiled ? "lookup, compiled tables: " : "lookup, JSON maps: ")
+              << num_cells / std::chrono::duration<double>(end - start).count() << " cells/s"
+              << std::endl;
+  }
+
+  for (bool compiled : {false, true}) {
+    dlr::DataTransform data_transform;
+    if (compiled) data_transform.CompileInputTransform(metadata);
+    std::vector<tvm::runtime::NDArray> transformed(1);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      data_transform.TransformInput(metadata, shape, input.data(), 1, dtypes, ctx, &transformed);
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout << (compiled ? "TransformInput, compiled tables: " : "TransformInput, JSON maps: ")
+              << num_cells / std::chrono::duration<double>(end - start).count() << " cells/s"
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+#include <dlr.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dmlc/logging.h"
+
+/*! \brief Compares a compiled Treelite model with the same model loaded from its XGBoost or
+ * LightGBM JSON by the GBDT backend, on load time and on throughput over random inputs.
+ */
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <treelite model dir> <json model dir> [rows] [iterations]" << std::endl;
+    return 1;
+  }
+  const int64_t num_row = argc >= 4 ? std::stoll(argv[3]) : 1024;
+  const int iterations = argc >= 5 ? std::stoi(argv[4]) : 100;
+
+  std::vector<float> data;
+  for (int m = 1; m <= 2; m++) {
+    DLRModelHandle model = NULL;
+    auto start = std::chrono::steady_clock::now();
+    if (CreateDLRModel(&model, argv[m], 1, 0) != 0) {
+      LOG(INFO) << DLRGetLastError() << std::endl;
+      throw std::runtime_error("Could not load DLR Model");
+    }
+    auto end = std::chrono::steady_clock::now();
+    const char* backend;
+    if (GetDLRBackend(&model, &backend) != 0) {
+      throw std::runtime_error(DLRGetLastError());
+    }
+    const double load_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    int64_t shape[2];
+    if (GetDLRInputShape(&model, 0, shape) != 0) {
+      throw std::runtime_error(DLRGetLastError());
+    }
+    shape[0] = num_row;
+    if (data.empty()) {
+      // Same rows for both models, with 10% missing values.
+      std::mt19937 rng(0);
+      std::uniform_real_distribution<float> value(0.0f, 1.0f);
+      data.resize(num_row * shape[1]);
+      for (auto& v : data) {
+        v = value(rng) < 0.1f ? NAN : value(rng);
+      }
+    }
+    if (SetDLRInput(&model, "data", shape, data.data(), 2) != 0) {
+      throw std::runtime_error(DLRGetLastError());
+    }
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      if (RunDLRModel(&model) != 0) {
+        throw std::runtime_error(DLRGetLastError());
+      }
+    }
+    end = std::chrono::steady_clock::now();
+    const double run_us = std::chrono::duration<double, std::micro>(end - start).count();
+    std::cout << backend << ": load " << load_ms << " ms, Run " << run_us / iterations << " us, "
+              << num_row * iterations / run_us << " rows/us" << std::endl;
+    DeleteDLRModel(&model);
+  }
+  return 0;
+}
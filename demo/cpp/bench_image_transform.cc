@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dlr_image_transform.h"
+
+namespace {
+
+/*! \brief Preprocessing the way clients usually write it: resize to a uint8 image, then convert,
+ * normalize and transpose in separate passes.
+ */
+void PreprocessInPasses(const std::vector<uint8_t>& image, int64_t src_height, int64_t src_width,
+                        int64_t height, int64_t width, const float* mean, const float* stddev,
+                        std::vector<uint8_t>* resized, std::vector<float>* normalized,
+                        std::vector<float>* out) {
+  for (int64_t y = 0; y < height; y++) {
+    const double sy = std::max((y + 0.5) * src_height / height - 0.5, 0.0);
+    const int64_t y0 = std::min<int64_t>(sy, src_height - 1);
+    const int64_t y1 = std::min<int64_t>(y0 + 1, src_height - 1);
+    for (int64_t x = 0; x < width; x++) {
+      const double sx = std::max((x + 0.5) * src_width / width - 0.5, 0.0);
+      const int64_t x0 = std::min<int64_t>(sx, src_width - 1);
+      const int64_t x1 = std::min<int64_t>(x0 + 1, src_width - 1);
+      for (int64_t c = 0; c < 3; c++) {
+        auto at = [&](int64_t yy, int64_t xx) { return image[(yy * src_width + xx) * 3 + c]; };
+        const double top = at(y0, x0) + (sx - x0) * (at(y0, x1) - at(y0, x0));
+        const double bottom = at(y1, x0) + (sx - x0) * (at(y1, x1) - at(y1, x0));
+        const double value = top + (sy - y0) * (bottom - top);
+        (*resized)[(y * width + x) * 3 + c] = static_cast<uint8_t>(value);
+      }
+    }
+  }
+  for (size_t i = 0; i < resized->size(); i++) {
+    (*normalized)[i] = ((*resized)[i] - mean[i % 3]) / stddev[i % 3];
+  }
+  for (int64_t c = 0; c < 3; c++) {
+    for (int64_t i = 0; i < height * width; i++) {
+      (*out)[c * height * width + i] = (*normalized)[i * 3 + c];
+    }
+  }
+}
+
+}  // namespace
+
+/*! \brief Measures the Image input transform from a random RGB image, and from an NV12 frame,
+ * to a 224x224 NCHW input, against the same preprocessing done in separate passes. Reports
+ * milliseconds per image.
+ */
+int main(int argc, char** argv) {
+  const int64_t src_height = argc >= 2 ? std::stoi(argv[1]) : 1080;
+  const int64_t src_width = argc >= 3 ? std::stoi(argv[2]) : 1920;
+  const int iterations = argc >= 4 ? std::stoi(argv[3]) : 100;
+  const int64_t height = 224;
+  const int64_t width = 224;
+  const float mean[3] = {123.675f, 116.28f, 103.53f};
+  const float stddev[3] = {58.395f, 57.12f, 57.375f};
+
+  nlohmann::json config;
+  config["Mean"] = std::vector<float>(mean, mean + 3);
+  config["Std"] = std::vector<float>(stddev, stddev + 3);
+  dlr::ImageTransform transform(config, "data", {1, 3, height, width});
+
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> pixel(0, 255);
+  std::vector<uint8_t> image(src_height * src_width * 3);
+  for (uint8_t& value : image) value = pixel(rng);
+  const int64_t shape[3] = {src_height, src_width, 3};
+  std::vector<float> out(3 * height * width);
+  std::cout << "image: " << src_height << "x" << src_width << ", input: " << height << "x"
+            << width << std::endl;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    transform.Apply(image.data(), shape, 3, {kDLFloat, 32, 1}, out.data());
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "fused: "
+            << std::chrono::duration<double, std::milli>(end - start).count() / iterations << " ms"
+            << std::endl;
+
+  // The same size frame in NV12, as delivered by camera pipelines.
+  std::vector<uint8_t> nv12(src_height * src_width * 3 / 2);
+  for (uint8_t& value : nv12) value = pixel(rng);
+  dlr::ImageView frame;
+  frame.format = dlr::ImageView::Format::kNV12;
+  frame.width = src_width;
+  frame.height = src_height;
+  frame.planes[0] = nv12.data();
+  frame.planes[1] = nv12.data() + src_height * src_width;
+  frame.strides[0] = frame.strides[1] = src_width;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    transform.Apply(&frame, 1, {kDLFloat, 32, 1}, out.data());
+  }
+  end = std::chrono::steady_clock::now();
+  std::cout << "fused from NV12: "
+            << std::chrono::duration<double, std::milli>(end - start).count() / iterations << " ms"
+            << std::endl;
+
+  std::vector<uint8_t> resized(height * width * 3);
+  std::vector<float> normalized(height * width * 3);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    PreprocessInPasses(image, src_height, src_width, height, width, mean, stddev, &resized,
+                       &normalized, &out);
+  }
+  end = std::chrono::steady_clock::now();
+  std::cout << "separate passes: "
+            << std::chrono::duration<double, std::milli>(end - start).count() / iterations << " ms"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dlr_postprocess.h"
+
+namespace {
+
+/*! \brief Post-processing the way clients usually write it: softmax over a copy of the row, then
+ * a sort of all class indices by probability.
+ */
+void SoftmaxAndSort(const float* row, int64_t num_classes, int64_t top_k,
+                    std::vector<float>* probs, std::vector<int32_t>* order,
+                    DLRClassScore* results) {
+  const float max = *std::max_element(row, row + num_classes);
+  float sum = 0.0f;
+  for (int64_t i = 0; i < num_classes; i++) {
+    (*probs)[i] = std::exp(row[i] - max);
+    sum += (*probs)[i];
+  }
+  for (int64_t i = 0; i < num_classes; i++) (*probs)[i] /= sum;
+  std::iota(order->begin(), order->end(), 0);
+  std::stable_sort(order->begin(), order->end(),
+                   [&](int32_t a, int32_t b) { return (*probs)[a] > (*probs)[b]; });
+  for (int64_t i = 0; i < top_k; i++) results[i] = {(*order)[i], (*probs)[(*order)[i]]};
+}
+
+}  // namespace
+
+/*! \brief Measures top-k softmax post-processing of random logits against softmax over a copy
+ * followed by a full sort. Reports microseconds per row.
+ */
+int main(int argc, char** argv) {
+  const int64_t num_classes = argc >= 2 ? std::stoi(argv[1]) : 1000;
+  const int64_t top_k = argc >= 3 ? std::stoi(argv[2]) : 5;
+  const int iterations = argc >= 4 ? std::stoi(argv[3]) : 10000;
+
+  std::mt19937 rng(0);
+  std::normal_distribution<float> dist(0.0f, 4.0f);
+  std::vector<float> logits(num_classes);
+  for (float& value : logits) value = dist(rng);
+  dlr::Postprocess postprocess(top_k, true);
+  std::vector<DLRClassScore> results(top_k);
+  std::cout << "classes: " << num_classes << ", top_k: " << top_k << std::endl;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    postprocess.Apply(logits.data(), 1, num_classes, results.data());
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "top-k softmax: "
+            << std::chrono::duration<double, std::micro>(end - start).count() / iterations
+            << " us" << std::endl;
+
+  std::vector<float> probs(num_classes);
+  std::vector<int32_t> order(num_classes);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    SoftmaxAndSort(logits.data(), num_classes, top_k, &probs, &order, results.data());
+  }
+  end = std::chrono::steady_clock::now();
+  std::cout << "softmax and sort: "
+            << std::chrono::duration<double, std::micro>(end - start).count() / iterations
+            << " us" << std::endl;
+  return 0;
+}
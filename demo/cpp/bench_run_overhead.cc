@@ -0,0 +1,120 @@
+#include <dlr.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dmlc/logging.h"
+
+/*! \brief Input buffer and shape used to feed the model on every iteration. */
+struct BenchInput {
+  std::string name;
+  std::vector<int64_t> shape;
+  std::vector<char> data;
+};
+
+size_t GetElementSize(const std::string& type) {
+  if (type == "bool" || type == "uint8" || type == "int8") return 1;
+  if (type == "uint16" || type == "int16" || type == "float16" || type == "bfloat16") return 2;
+  if (type == "uint32" || type == "int32" || type == "float32") return 4;
+  if (type == "uint64" || type == "int64" || type == "float64") return 8;
+  throw std::runtime_error("Unsupported input type " + type);
+}
+
+/*! \brief Allocates zero-filled inputs matching the model input shapes. Unknown (-1) dimensions
+ * are set to 1, so a trivial model measures framework overhead rather than compute.
+ */
+std::vector<BenchInput> PrepareInputs(DLRModelHandle model) {
+  int num_inputs;
+  GetDLRNumInputs(&model, &num_inputs);
+  std::vector<BenchInput> inputs(num_inputs);
+  for (int i = 0; i < num_inputs; i++) {
+    const char* name;
+    const char* type;
+    int64_t size;
+    int dim;
+    GetDLRInputName(&model, i, &name);
+    GetDLRInputType(&model, i, &type);
+    if (GetDLRInputSizeDim(&model, i, &size, &dim) != 0) {
+      throw std::runtime_error(DLRGetLastError());
+    }
+    inputs[i].name = name;
+    inputs[i].shape.resize(dim);
+    GetDLRInputShape(&model, i, inputs[i].shape.data());
+    int64_t num_elements = 1;
+    for (auto& d : inputs[i].shape) {
+      if (d < 0) d = 1;
+      num_elements *= d;
+    }
+    inputs[i].data.resize(num_elements * GetElementSize(type), 0);
+  }
+  return inputs;
+}
+
+void SetInputs(DLRModelHandle model, const std::vector<BenchInput>& inputs) {
+  for (const auto& input : inputs) {
+    if (SetDLRInput(&model, input.name.c_str(), input.shape.data(), input.data.data(),
+                    static_cast<int>(input.shape.size())) != 0) {
+      throw std::runtime_error(DLRGetLastError());
+    }
+  }
+}
+
+void Run(DLRModelHandle model) {
+  if (RunDLRModel(&model) != 0) {
+    throw std::runtime_error(DLRGetLastError());
+  }
+}
+
+template <typename F>
+double TimeMicrosPerIteration(int iterations, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+/*! \brief Measures per-Run framework overhead. Use a trivial model (e.g. a single add) so that
+ * the time is dominated by DLR and runtime dispatch rather than kernels.
+ */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <model dir> [iterations]" << std::endl;
+    return 1;
+  }
+  const int iterations = argc >= 3 ? std::stoi(argv[2]) : 10000;
+
+  DLRModelHandle model = NULL;
+  if (CreateDLRModel(&model, argv[1], 1, 0) != 0) {
+    LOG(INFO) << DLRGetLastError() << std::endl;
+    throw std::runtime_error("Could not load DLR Model");
+  }
+  const char* backend;
+  GetDLRBackend(&model, &backend);
+  std::vector<BenchInput> inputs = PrepareInputs(model);
+
+  // Warm up allocators and caches before timing.
+  for (int i = 0; i < 10; i++) {
+    SetInputs(model, inputs);
+    Run(model);
+  }
+  double set_and_run = TimeMicrosPerIteration(iterations, [&]() {
+    SetInputs(model, inputs);
+    Run(model);
+  });
+  double set_only = TimeMicrosPerIteration(iterations, [&]() { SetInputs(model, inputs); });
+  double run_only = TimeMicrosPerIteration(iterations, [&]() { Run(model); });
+
+  std::cout << "backend: " << backend << std::endl;
+  std::cout << "iterations: " << iterations << std::endl;
+  std::cout << "SetInput + Run: " << set_and_run << " us/iter" << std::endl;
+  std::cout << "SetInput: " << set_only << " us/iter" << std::endl;
+  std::cout << "Run: " << run_only << " us/iter" << std::endl;
+  DeleteDLRModel(&model);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <dlr.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dmlc/logging.h"
+
+/*! \brief Measures SetDLRInput and RunDLRModel time of a Treelite model for a range of missing
+ * value fractions, covering both the dense and the CSR input path.
+ */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <model dir> [rows] [iterations]" << std::endl;
+    return 1;
+  }
+  const int64_t num_row = argc >= 3 ? std::stoll(argv[2]) : 1024;
+  const int iterations = argc >= 4 ? std::stoi(argv[3]) : 100;
+
+  DLRModelHandle model = NULL;
+  if (CreateDLRModel(&model, argv[1], 1, 0) != 0) {
+    LOG(INFO) << DLRGetLastError() << std::endl;
+    throw std::runtime_error("Could not load DLR Model");
+  }
+  int64_t shape[2];
+  if (GetDLRInputShape(&model, 0, shape) != 0) {
+    throw std::runtime_error(DLRGetLastError());
+  }
+  const int64_t num_col = shape[1];
+  shape[0] = num_row;
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> value(0.0f, 1.0f);
+  std::cout << "rows: " << num_row << ", features: " << num_col << std::endl;
+  for (float missing : {0.0f, 0.25f, 0.5f, 0.75f, 0.9f, 0.99f}) {
+    std::vector<float> data(num_row * num_col);
+    for (auto& v : data) {
+      v = value(rng) < missing ? NAN : value(rng);
+    }
+    double set_us = 0;
+    double run_us = 0;
+    for (int i = 0; i < iterations; i++) {
+      auto start = std::chrono::steady_clock::now();
+      if (SetDLRInput(&model, "data", shape, data.data(), 2) != 0) {
+        throw std::runtime_error(DLRGetLastError());
+      }
+      auto middle = std::chrono::steady_clock::now();
+      if (RunDLRModel(&model) != 0) {
+        throw std::runtime_error(DLRGetLastError());
+      }
+      auto end = std::chrono::steady_clock::now();
+      set_us += std::chrono::duration<double, std::micro>(middle - start).count();
+      run_us += std::chrono::duration<double, std::micro>(end - middle).count();
+    }
+    std::cout << "missing " << missing << ": SetInput " << set_us / iterations << " us, Run "
+              << run_us / iterations << " us, "
+              << num_row * num_col * iterations / (set_us + run_us) << " values/us" << std::endl;
+  }
+  DeleteDLRModel(&model);
+  return 0;
+}
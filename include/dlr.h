@@ -58,6 +58,61 @@ typedef struct ModelElem {
 } DLRModelElem;
 #endif
 
+#ifndef DLR_MEMORY_STATS
+#define DLR_MEMORY_STATS
+/*! \brief Memory held by a model on one device. */
+typedef struct MemoryStats {
+  /*! \brief Device type, as in the DLDeviceType enum in dlpack.h. */
+  int device_type;
+  int device_id;
+  /*! \brief Bytes currently held, including cached bytes. */
+  int64_t current_bytes;
+  /*! \brief Highest current_bytes observed since the model was created. */
+  int64_t peak_bytes;
+  /*! \brief Bytes held but not in use, which TrimDLRModelMemory can release. */
+  int64_t cached_bytes;
+} DLRMemoryStats;
+#endif
+
+/*! \brief Pixel formats of DLRImage. */
+typedef enum {
+  /*! \brief Interleaved 8-bit RGB, one plane. */
+  DLR_IMAGE_RGB = 0,
+  /*! \brief Interleaved 8-bit BGR, one plane. */
+  DLR_IMAGE_BGR = 1,
+  /*! \brief Y plane, then a plane of interleaved U and V subsampled by 2 in both directions. */
+  DLR_IMAGE_NV12 = 2,
+  /*! \brief As DLR_IMAGE_NV12, with V before U. */
+  DLR_IMAGE_NV21 = 3,
+  /*! \brief Y, U and V planes, U and V subsampled by 2 in both directions. */
+  DLR_IMAGE_I420 = 4,
+} DLRImageFormat;
+
+/*! \brief An image in CPU memory for SetDLRImageInput(). */
+typedef struct {
+  DLRImageFormat format;
+  int64_t width;
+  int64_t height;
+  /*! \brief Plane pointers. RGB and BGR use planes[0], NV12 and NV21 planes[0..1], I420 all. */
+  const uint8_t* planes[3];
+  /*! \brief Bytes per row of each plane. */
+  int64_t strides[3];
+  /*! \brief Region to preprocess. The whole image if crop_width or crop_height is 0. */
+  int64_t crop_x;
+  int64_t crop_y;
+  int64_t crop_width;
+  int64_t crop_height;
+} DLRImage;
+
+#ifndef DLR_CLASS_SCORE
+#define DLR_CLASS_SCORE
+/*! \brief A class of a classification output and its score. */
+typedef struct ClassScore {
+  int32_t index;
+  float score;
+} DLRClassScore;
+#endif
+
 /*!
  * \brief Creates a DLR model
  * \param handle The pointer to save the model handle.
@@ -128,6 +183,65 @@ int DeleteDLRModel(DLRModelHandle* handle);
 DLR_DLL
 int RunDLRModel(DLRModelHandle* handle);
 
+/*!
+ \brief Runs a Treelite model with the given number of worker threads for this call only, e.g.
+ one thread for online requests and more for batch scoring. A thread count other than the last
+ one used reloads the predictor. Can only be used with Treelite models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param threads Number of worker threads for this call.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int RunDLRModelWithNumThreads(DLRModelHandle* handle, int threads);
+
+/*! \brief A pointer to a function that reads up to max_rows rows of input into buffer and returns
+ the number of rows read, or 0 at the end of the input. */
+typedef size_t (*DLRReadRowsFunctionPtr)(void* ctx, float* buffer, size_t max_rows);
+/*! \brief A pointer to a function that receives the predictions of num_row consecutive rows,
+ row_size values per row. */
+typedef void (*DLRWriteOutputFunctionPtr)(void* ctx, const float* out, size_t num_row,
+                                          size_t row_size);
+
+/*!
+ \brief Scores a stream of rows in chunks of at most chunk_rows rows, so that memory is bounded by
+ the chunk size rather than the number of rows. The next chunk is read and assembled while the
+ current one is predicted, so read_fn is called on a helper thread. write_fn is called on the
+ calling thread in row order. The input and output of the model are not changed. Can only be used
+ with Treelite models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param read_fn Function reading rows of num_col float32 values, missing values as NaN.
+ \param read_ctx Passed to read_fn.
+ \param num_col Number of values per row.
+ \param chunk_rows Maximum number of rows per chunk.
+ \param write_fn Function receiving the predictions of each chunk.
+ \param write_ctx Passed to write_fn.
+ \param num_rows Set to the number of rows scored. May be null.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int PredictDLRStream(DLRModelHandle* handle, DLRReadRowsFunctionPtr read_fn, void* read_ctx,
+                     size_t num_col, size_t chunk_rows, DLRWriteOutputFunctionPtr write_fn,
+                     void* write_ctx, size_t* num_rows);
+
+/*!
+ \brief Like PredictDLRStream(), reading rows from a file of row-major float32 values. The file is
+ memory mapped where supported. Can only be used with Treelite models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param path Path of the file.
+ \param num_col Number of values per row.
+ \param chunk_rows Maximum number of rows per chunk.
+ \param write_fn Function receiving the predictions of each chunk.
+ \param write_ctx Passed to write_fn.
+ \param num_rows Set to the number of rows scored. May be null.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int PredictDLRFile(DLRModelHandle* handle, const char* path, size_t num_col, size_t chunk_rows,
+                   DLRWriteOutputFunctionPtr write_fn, void* write_ctx, size_t* num_rows);
+
 /*!
  \brief Gets the number of inputs.
  \param handle The model handle returned from CreateDLRModel().
@@ -206,6 +320,74 @@ int SetDLRInput(DLRModelHandle* handle, const char* name, const int64_t* shape,
 DLR_DLL
 int SetDLRInputTensor(DLRModelHandle* handle, const char* name, void* tensor);
 
+/*!
+ \brief Sets a batched input from separate per-sample buffers. Samples are gathered directly into
+ the model's batched input storage, so no concatenated buffer is needed. Supported by TVM and
+ RelayVM models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param name The input node name.
+ \param samples Array of n pointers. Each points to one sample laid out as a single slice along the
+ first (batch) dimension of the input.
+ \param n Number of samples. For TVM models this must match the compiled batch size.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int SetDLRInputBatch(DLRModelHandle* handle, const char* name, const void** samples, int n);
+
+/*!
+ \brief Sets an input from camera frames or other 8-bit images, preprocessed by the "Image" input
+ transform of the model metadata. Each image, or its crop, is converted to RGB, resized and
+ normalized directly into the model's batched input, in a single pass over the source. Supported
+ by TVM, RelayVM and pipeline models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param name The input node name, which must be the input of the Image transform.
+ \param images Array of n images.
+ \param n Number of images. For TVM models this must match the compiled batch size.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int SetDLRImageInput(DLRModelHandle* handle, const char* name, const DLRImage* images, int n);
+
+/*!
+ \brief Sets a batched input from regions of interest of one frame, such as the detections of a
+ previous model. Each box is cropped, resized and normalized by the "Image" input transform of the
+ model metadata directly into its entry of the batch. Boxes are processed in parallel. Supported by
+ TVM, RelayVM and pipeline models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param name The input node name, which must be the input of the Image transform.
+ \param frame The frame to crop. Its crop fields are ignored.
+ \param boxes num_boxes boxes of 4 floats, [x1, y1, x2, y2] in pixels unless the Image transform
+ sets BoxOrder or BoxNormalized. Boxes are clipped to the frame.
+ \param num_boxes Number of boxes, at most the batch size of the input. For inputs with a static
+ batch size, the entries after the boxes are zeroed.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int SetDLRROIInput(DLRModelHandle* handle, const char* name, const DLRImage* frame,
+                   const float* boxes, int num_boxes);
+
+/*!
+ \brief Sets the input from a sparse matrix in CSR format. The arrays are passed to the model
+ without copying and must stay valid and unmodified until RunDLRModel() returns. Missing values
+ are the entries not stored in the matrix. Supported by Treelite models, and by pipelines whose
+ first model is a Treelite model.
+ \param handle The model handle returned from CreateDLRModel().
+ \param data Values of the stored entries, row_ptr[num_row] elements.
+ \param col_ind Column index of each stored entry, each less than num_col.
+ \param row_ptr num_row + 1 offsets into data and col_ind. row_ptr[0] must be 0 and offsets must
+ not decrease.
+ \param num_row Number of rows.
+ \param num_col Number of columns, at most the number of features of the model.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int SetDLRSparseInput(DLRModelHandle* handle, const float* data, const uint32_t* col_ind,
+                      const size_t* row_ptr, size_t num_row, size_t num_col);
+
 /*!
  \brief Gets the current value of the input according the node name.
  \param handle The model handle returned from CreateDLRModel().
@@ -263,6 +445,20 @@ int GetDLROutputShape(DLRModelHandle* handle, int index, int64_t* shape);
 DLR_DLL
 int GetDLROutput(DLRModelHandle* handle, int index, void* out);
 
+/*!
+ \brief Gets the index-th output from the model, scattering each slice along the first (batch)
+ dimension into a separate buffer. Supported by TVM and RelayVM models.
+ \param handle The model handle returned from CreateDLRModel().
+ \param index The index-th output.
+ \param dests Array of n pointers. Each should point to a buffer large enough for one slice of the
+ output, i.e. "size" from GetDLROutputSizeDim() divided by n.
+ \param n Number of samples. Must match the batch dimension of the output.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int GetDLROutputBatch(DLRModelHandle* handle, int index, void** dests, int n);
+
 /*!
  \brief Gets the index-th output from the model.
  \param handle The model handle returned from CreateDLRModel().
@@ -273,6 +469,36 @@ int GetDLROutput(DLRModelHandle* handle, int index, void* out);
 DLR_DLL
 int GetDLROutputPtr(DLRModelHandle* handle, int index, const void** out);
 
+/*!
+ \brief Configures post-processing of a float32 classification output, replacing the "Postprocess"
+ object of the output's DataTransform in the model metadata.
+ \param handle The model handle returned from CreateDLRModel().
+ \param index The index-th output.
+ \param top_k Number of classes kept per row of the last output dimension. 1 is argmax. 0 disables
+ post-processing.
+ \param softmax Whether scores are softmax probabilities rather than the logits.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SetDLROutputPostprocess(DLRModelHandle* handle, int index, int top_k, int softmax);
+
+/*!
+ \brief Gets the best classes of the index-th output after RunDLRModel(), post-processed as set by
+ SetDLROutputPostprocess() or the model metadata. Each row of the last output dimension gives
+ min(top_k, number of classes) results, best first, with ties going to the lower class index.
+ The output is read in place on CPU, without copying the logits, and only the selected scores are
+ normalized by softmax.
+ \param handle The model handle returned from CreateDLRModel().
+ \param index The index-th output.
+ \param scores Storage for capacity results.
+ \param capacity Number of results scores can hold.
+ \param num_scores The pointer to save the number of results.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLROutputClassScores(DLRModelHandle* handle, int index, DLRClassScore* scores,
+                            int64_t capacity, int64_t* num_scores);
+
 /*!
  * \brief Gets the index-th output from the model and copies it into the given DLTensor.
  *        Can only be used with TVM models (GraphRuntime and VMRuntime)
@@ -369,7 +595,8 @@ DLR_DLL
 const char* DLRGetLastError();
 
 /*!
- \brief Gets the name of the backend ("tvm", "treelite" or "tflite")
+ \brief Gets the name of the backend ("tvm", "treelite", "gbdt", "relayvm", "hexagon" or
+ "pipeline")
  \param handle The model handle returned from CreateDLRModel().
  \param name The pointer to save the null-terminated string containing the name.
  \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
@@ -398,7 +625,8 @@ DLR_DLL
 int GetDLRVersion(const char** out);
 
 /*!
- \brief Set the number of threads available to DLR
+ \brief Set the number of threads available to DLR. For TVM and RelayVM models this takes
+ effect on the next RunDLRModel().
  \param handle The model handle returned from CreateDLRModel().
  \param threads number of threads
  \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
@@ -408,7 +636,8 @@ DLR_DLL
 int SetDLRNumThreads(DLRModelHandle* handle, int threads);
 
 /*!
- \brief Enable or disable CPU Affinity
+ \brief Enable or disable CPU Affinity. For TVM and RelayVM models this takes effect on the
+ next RunDLRModel().
  \param handle The model handle returned from CreateDLRModel().
  \param use 0 to disable, 1 to enable
  \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
@@ -417,6 +646,87 @@ int SetDLRNumThreads(DLRModelHandle* handle, int threads);
 DLR_DLL
 int UseDLRCPUAffinity(DLRModelHandle* handle, int use);
 
+/*!
+ * \brief Run a RelayVM model with zero-filled inputs of the given shapes, so that its pooled
+ *        memory allocators are sized before real traffic arrives. Inputs set before the call are
+ *        kept. Can only be used with RelayVM models.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param num_shape_sets Number of shape sets. 0 uses the input shapes from model metadata.
+ * \param shapes Array of num_shape_sets * num_inputs shapes. shapes[s * num_inputs + i] is the
+ *        shape of input i in shape set s.
+ * \param dims Array of num_shape_sets * num_inputs dimensions, laid out like shapes.
+ * \param pool_bytes The pointer to save the bytes held by the VM memory pools after warmup. May be
+ *        NULL.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int WarmupDLRModel(DLRModelHandle* handle, int num_shape_sets, const int64_t** shapes,
+                   const int* dims, int64_t* pool_bytes);
+
+/*!
+ * \brief Get memory statistics of a RelayVM model, one entry per device it uses. current_bytes
+ *        covers the model's VM memory pool on the device and input storage cached by the model.
+ *        cached_bytes counts their idle blocks, which TrimDLRModelMemory releases. Can only be
+ *        used with RelayVM models.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param stats Array of at least max_stats entries to save the statistics.
+ * \param max_stats Number of entries in stats.
+ * \param num_stats The pointer to save the number of devices. At most max_stats entries are
+ *        written.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLRMemoryStats(DLRModelHandle* handle, DLRMemoryStats* stats, int max_stats,
+                      int* num_stats);
+
+/*!
+ * \brief Release cached memory of an idle RelayVM model, idle input storage and idle blocks of
+ *        its VM memory pools, until at most watermark_bytes of cached memory remain per device.
+ *        Must not be called concurrently with RunDLRModel. Can only be used with RelayVM models.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param watermark_bytes Cached bytes to keep per device. 0 releases all cached memory.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int TrimDLRModelMemory(DLRModelHandle* handle, int64_t watermark_bytes);
+
+/*!
+ * \brief Enable or disable zero-copy inputs for a RelayVM model on CPU or a Treelite model.
+ *        When enabled, RelayVM models use 64-byte aligned caller buffers given to SetDLRInput and
+ *        SetDLRInputTensor directly instead of copying them; other buffers are still copied. A
+ *        buffer used this way must stay valid and unmodified until the next RunDLRModel returns,
+ *        after which it is released and must be set again; outputs never refer to it. Treelite models use dense inputs given
+ *        to SetDLRInput directly; the buffer must stay valid and unmodified until RunDLRModel
+ *        returns. Can only be used with RelayVM and Treelite models.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param enable 1 to enable, 0 to disable. Disabled by default.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SetDLRZeroCopyInput(DLRModelHandle* handle, int enable);
+
+/*!
+ * \brief Set the maximum number of shape buckets a RelayVM model keeps per input. Input storage
+ *        is reused when SetDLRInput is called with a shape matching (or fitting into) a bucket.
+ *        Can only be used with RelayVM models.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param max_buckets Maximum number of buckets per input. 0 disables reuse.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SetDLRInputArenaMaxBuckets(DLRModelHandle* handle, int max_buckets);
+
+/*!
+ * \brief Get the number of SetDLRInput calls that reused input storage (hits) and that needed a
+ *        new allocation (misses), summed over all inputs. Can only be used with RelayVM models.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param hits The pointer to save the number of hits.
+ * \param misses The pointer to save the number of misses.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLRInputArenaStats(DLRModelHandle* handle, int64_t* hits, int64_t* misses);
+
 /*!
  * \brief Set custom allocator malloc function. Must be called before CreateDLRModel or
  *        CreateDLRPipeline. It is recommended to use with SetDLRCustomAllocatorFree and
@@ -8,9 +8,11 @@
 
 #include <nlohmann/json.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "dlr_allocator.h"
+#include "dlr_postprocess.h"
 
 #define LINE_SIZE 256
 
@@ -50,8 +52,26 @@ typedef struct ModelElem {
 } DLRModelElem;
 #endif
 
+#ifndef DLR_MEMORY_STATS
+#define DLR_MEMORY_STATS
+/*! \brief Memory held by a model on one device. */
+typedef struct MemoryStats {
+  /*! \brief Device type, as in the DLDeviceType enum in dlpack.h. */
+  int device_type;
+  int device_id;
+  /*! \brief Bytes currently held, including cached bytes. */
+  int64_t current_bytes;
+  /*! \brief Highest current_bytes observed since the model was created. */
+  int64_t peak_bytes;
+  /*! \brief Bytes held but not in use, which TrimDLRModelMemory can release. */
+  int64_t cached_bytes;
+} DLRMemoryStats;
+#endif
+
 namespace dlr {
 
+struct ImageView;
+
 /* The following file names are reserved by SageMaker and should not be used
  * as model JSON */
 constexpr const char* SAGEMAKER_AUXILIARY_JSON_FILES[] = {"model-shapes.json", "hyperparams.json"};
@@ -95,8 +115,8 @@ inline bool EndsWith(const std::string& mainStr, const std::string& toMatch) {
     return false;
 }
 
-enum class DLRBackend { kTVM, kTREELITE, kHEXAGON, kRELAYVM, kPIPELINE, kUNKNOWN };
-extern const char* kBackendToStr[6];
+enum class DLRBackend { kTVM, kTREELITE, kHEXAGON, kRELAYVM, kPIPELINE, kGBDT, kUNKNOWN };
+extern const char* kBackendToStr[7];
 
 /*! \brief Get the backend based on the contents of the model folder.
  */
@@ -117,6 +137,20 @@ DLR_DLL std::vector<std::string> MakePathVec(std::string model_path);
 
 bool HasNegative(const int64_t* arr, const size_t size);
 
+/*! \brief Copy n samples of sample_bytes each from separate buffers into one contiguous batch. */
+void GatherBatch(const void** samples, int n, size_t sample_bytes, void* batch);
+
+/*! \brief Copy n consecutive samples of sample_bytes each from one batch into separate buffers. */
+void ScatterBatch(const void* batch, int n, size_t sample_bytes, void** dests);
+
+/*! \brief Map each name to its index, the first one if a name repeats. Built at load so that name
+ * lookups do not scan the names or the metadata. */
+DLR_DLL std::unordered_map<std::string, int> MakeIndexMap(const std::vector<std::string>& names);
+
+/*! \brief Index of name in a map from MakeIndexMap, -1 if it is not there. The key is built in a
+ * buffer reused by the calling thread, so per-request lookups do not allocate. */
+DLR_DLL int FindIndex(const std::unordered_map<std::string, int>& indices, const char* name);
+
 #define CHECK_SHAPE(msg, value, expected) \
   CHECK_EQ(value, expected) << (msg) << ". Value read: " << (value) << ", Expected: " << (expected);
 
@@ -132,7 +166,11 @@ class DLR_DLL DLRModel {
   std::vector<std::string> input_names_;
   std::vector<std::string> input_types_;
   std::vector<std::vector<int64_t>> input_shapes_;
+  /*! \brief Post-processing by output index, set by SetOutputPostprocess or read from metadata on
+   * first use. */
+  std::unordered_map<int, Postprocess> postprocesses_;
   virtual void ValidateDeviceTypeIfExists();
+  const Postprocess& GetOutputPostprocess(int index);
 
  public:
   nlohmann::json metadata_ = nullptr;
@@ -148,6 +186,25 @@ class DLR_DLL DLRModel {
   virtual const std::vector<int64_t>& GetInputShape(int index) const;
   virtual void GetInput(const char* name, void* input) = 0;
   virtual void SetInput(const char* name, const int64_t* shape, const void* input, int dim) = 0;
+  virtual void SetInputBatch(const char* name, const void** samples, int n) {
+    throw dmlc::Error("SetInputBatch is not supported for this model.");
+  }
+  virtual void SetSparseInput(const float* data, const uint32_t* col_ind, const size_t* row_ptr,
+                              size_t num_row, size_t num_col) {
+    throw dmlc::Error("SetSparseInput is not supported for this model.");
+  }
+  /*! \brief Preprocess images with the model's Image transform into a batch for input name. */
+  virtual void SetImageInput(const char* name, const ImageView* images, int64_t n) {
+    throw dmlc::Error("SetImageInput is not supported for this model.");
+  }
+  /*! \brief Crop num_boxes boxes of frame with the model's Image transform into a batch for input
+   * name. */
+  virtual void SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                           int64_t num_boxes) {
+    throw dmlc::Error("SetROIInput is not supported for this model.");
+  }
+  /*! \brief Index of the input preprocessed by an Image transform, -1 if there is none. */
+  virtual int GetImageInputIndex() const { return -1; }
 
   /* Output related functions */
   virtual int GetNumOutputs() { return num_outputs_; }
@@ -167,6 +224,17 @@ class DLR_DLL DLRModel {
   virtual void GetOutputByName(const char* name, void* out) {
     throw dmlc::Error("GetOutputByName is not supported yet!");
   }
+  virtual void GetOutputBatch(int index, void** dests, int n) {
+    throw dmlc::Error("GetOutputBatch is not supported for this model.");
+  }
+  /*! \brief Configure post-processing of output index, replacing the one of the metadata. */
+  virtual void SetOutputPostprocess(int index, const Postprocess& postprocess);
+  /*! \brief Post-process the float32 output index in place into its best classes per row of the
+   * last dimension, see Postprocess. num_results receives the number of results, which must be
+   * at most capacity.
+   */
+  virtual void GetOutputClassScores(int index, DLRClassScore* results, int64_t capacity,
+                                    int64_t* num_results);
 
   /* Weights related functions */
   virtual int GetNumWeights() const { return num_weights_; }
@@ -3,19 +3,109 @@
 
 #include <tvm/runtime/ndarray.h>
 
+#include <functional>
+#include <limits>
 #include <nlohmann/json.hpp>
 
 #include "dlr_common.h"
+#include "dlr_image_transform.h"
 
 namespace dlr {
 
-/*! \brief Base case for input transformers. */
+/*! \brief Binary columnar input, an alternative to the JSON 2-D array for DataTransform inputs.
+ *
+ * All integers are little endian and nothing is aligned:
+ *
+ *   char[4] magic "DLRC", uint32 version (1), uint32 num_rows, uint32 num_cols
+ *   num_cols columns, each a uint32 type followed by its data:
+ *     kFloat32, kFloat64, kInt32, kInt64: num_rows values.
+ *     kString: uint32 offsets[num_rows + 1] into the bytes that follow, offsets[num_rows] bytes.
+ *     kDictionary: uint32 dict_size, uint32 offsets[dict_size + 1], offsets[dict_size] bytes of
+ *       dictionary strings, then uint32 codes[num_rows]. A code of kNullCode is a missing value.
+ *
+ * The input is only viewed, not copied, so it must outlive this object.
+ */
+class DLR_DLL ColumnarInput {
+ public:
+  enum ColumnType : uint32_t {
+    kFloat32 = 0,
+    kFloat64 = 1,
+    kInt32 = 2,
+    kInt64 = 3,
+    kString = 4,
+    kDictionary = 5,
+  };
+  static constexpr uint32_t kNullCode = 0xffffffff;
+
+  struct Column {
+    ColumnType type;
+    /*! \brief Numeric values or dictionary codes. */
+    const char* data;
+    /*! \brief uint32 offsets of the strings or dictionary entries, followed by their bytes. */
+    const char* offsets;
+    const char* bytes;
+    uint32_t dict_size;
+  };
+
+  /*! \brief Returns true if data of the given size starts with the columnar magic. */
+  static bool IsColumnar(const void* data, size_t size);
+
+  /*! \brief Validate and index the columns of data. Throws dmlc::Error if it is malformed. */
+  ColumnarInput(const void* data, size_t size);
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_cols() const { return columns_.size(); }
+  const Column& column(size_t index) const { return columns_[index]; }
+
+  /*! \brief Row of a kString column, or dictionary entry of a kDictionary column. */
+  static void GetString(const Column& column, size_t index, const char** str, size_t* length);
+  /*! \brief Dictionary code of a row of a kDictionary column. */
+  static uint32_t GetCode(const Column& column, size_t row);
+
+ private:
+  size_t num_rows_ = 0;
+  std::vector<Column> columns_;
+};
+
+class CategoricalStringTable;
+
+/*! \brief Base case for input transformers. Transformers are shared by all models and threads, so
+ * they must not have mutable state.
+ */
 class DLR_DLL Transformer {
  public:
+  virtual ~Transformer() = default;
   virtual void MapToNDArray(const nlohmann::json& input_json, const nlohmann::json& transform,
                             tvm::runtime::NDArray& input_array) const = 0;
+  /*! \brief Same as MapToNDArray, reading binary columnar input. */
+  virtual void MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                            tvm::runtime::NDArray& input_array) const = 0;
+  /*! \brief Number of columns of the transformed input, for num_cols input columns. */
+  virtual int64_t GetNumOutputColumns(const nlohmann::json& transform, int64_t num_cols) const {
+    return num_cols;
+  }
+  /*! \brief Lookup tables compiled from transform, one per input column, for the MapToNDArray
+   * overloads taking tables. Empty if the transformer does not use tables.
+   */
+  virtual std::vector<CategoricalStringTable> Compile(const nlohmann::json& transform) const;
+  /*! \brief Same as MapToNDArray, using tables compiled by Compile instead of the JSON. */
+  virtual void MapToNDArray(const nlohmann::json& input_json,
+                            const std::vector<CategoricalStringTable>& tables,
+                            tvm::runtime::NDArray& input_array) const;
+  virtual void MapToNDArray(const ColumnarInput& input,
+                            const std::vector<CategoricalStringTable>& tables,
+                            tvm::runtime::NDArray& input_array) const;
 };
 
+/*! \brief Convert str to float like std::stof, without throwing. Leading whitespace is skipped
+ * and anything after the number is ignored. Returns false if str does not start with a number or
+ * the value is out of range. Plain decimals are converted directly, anything else (long digit
+ * strings, hex, inf, nan) falls back to strtof.
+ */
+DLR_DLL bool ParseFloat(const char* str, float* out);
+/*! \brief Same as ParseFloat, for a string that is not null terminated. */
+DLR_DLL bool ParseFloat(const char* str, size_t length, float* out);
+
 class DLR_DLL FloatTransformer : public Transformer {
  private:
   /*! \brief When there is a value stof cannot convert to float, this value is used. */
@@ -24,6 +114,45 @@ class DLR_DLL FloatTransformer : public Transformer {
  public:
   void MapToNDArray(const nlohmann::json& input_json, const nlohmann::json& transform,
                     tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+};
+
+/*! \brief Open-addressing hash table compiled from the map of one CategoricalString column.
+ *
+ * Keys are stored back to back in one buffer. Each slot holds 32 bits of the key's hash, so a
+ * probe compares key bytes only when the hashes match. The table is at most half full, so a
+ * lookup usually reads a single slot.
+ */
+class DLR_DLL CategoricalStringTable {
+ public:
+  CategoricalStringTable() = default;
+  /*! \brief Compile mapping, a JSON object from strings to numbers. Entries whose value is not a
+   * number map to missing_value. */
+  CategoricalStringTable(const nlohmann::json& mapping, float missing_value);
+
+  /*! \brief Value of key, or missing_value if there is no entry for it. */
+  float Find(const char* key, size_t length) const;
+  float Find(const std::string& key) const { return Find(key.data(), key.size()); }
+
+  size_t size() const { return num_keys_; }
+
+ private:
+  static constexpr uint32_t kEmptySlot = 0xffffffff;
+  struct Slot {
+    uint32_t tag;
+    /*! \brief Offset of the key in keys_, kEmptySlot if the slot is unused. */
+    uint32_t offset;
+    uint32_t length;
+    float value;
+  };
+  std::vector<Slot> slots_;
+  std::string keys_;
+  size_t mask_ = 0;
+  size_t num_keys_ = 0;
+  float missing_value_ = 0.0f;
+
+  static uint64_t Hash(const char* key, size_t length);
 };
 
 class DLR_DLL CategoricalStringTransformer : public Transformer {
@@ -34,6 +163,135 @@ class DLR_DLL CategoricalStringTransformer : public Transformer {
  public:
   void MapToNDArray(const nlohmann::json& input_json, const nlohmann::json& transform,
                     tvm::runtime::NDArray& input_array) const;
+  /*! \brief Same as MapToNDArray, using tables compiled by Compile instead of the JSON map. */
+  void MapToNDArray(const nlohmann::json& input_json,
+                    const std::vector<CategoricalStringTable>& tables,
+                    tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const std::vector<CategoricalStringTable>& tables,
+                    tvm::runtime::NDArray& input_array) const;
+  /*! \brief Compile one table per column of the transform's map. */
+  std::vector<CategoricalStringTable> Compile(const nlohmann::json& transform) const;
+};
+
+/*! \brief Base of transformers that parse numbers like Float, then rewrite each column with
+ * parameters from the transform. Both passes run over blocks of rows in parallel.
+ */
+class DLR_DLL ColumnwiseTransformer : public FloatTransformer {
+ public:
+  void MapToNDArray(const nlohmann::json& input_json, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+
+ protected:
+  /*! \brief Per-column parameters: value * scale + offset, then values that are NaN, or equal to
+   * missing_value, are replaced by replacement. */
+  struct ColumnParams {
+    std::vector<float> scale;
+    std::vector<float> offset;
+    std::vector<float> replacement;
+    float missing_value = std::numeric_limits<float>::quiet_NaN();
+  };
+  virtual ColumnParams GetParams(const nlohmann::json& transform, size_t num_cols) const = 0;
+
+ private:
+  void Apply(const nlohmann::json& transform, tvm::runtime::NDArray& input_array) const;
+};
+
+/*! \brief Standardization, as sklearn StandardScaler: (value - Mean) / Scale per column.
+ * Mean defaults to 0 and Scale to 1. A Scale of 0 is treated as 1.
+ */
+class DLR_DLL StandardScalerTransformer : public ColumnwiseTransformer {
+ protected:
+  ColumnParams GetParams(const nlohmann::json& transform, size_t num_cols) const;
+};
+
+/*! \brief Range scaling, as sklearn MinMaxScaler: value * Scale + Min per column. */
+class DLR_DLL MinMaxTransformer : public ColumnwiseTransformer {
+ protected:
+  ColumnParams GetParams(const nlohmann::json& transform, size_t num_cols) const;
+};
+
+/*! \brief Imputation, as sklearn SimpleImputer: missing values of each column are replaced by its
+ * entry of Statistics. Missing values are nulls, strings that are not numbers, NaN, and values
+ * equal to the optional MissingValue.
+ */
+class DLR_DLL ImputerTransformer : public ColumnwiseTransformer {
+ protected:
+  ColumnParams GetParams(const nlohmann::json& transform, size_t num_cols) const;
+};
+
+/*! \brief One-hot encoding, as sklearn OneHotEncoder with handle_unknown="ignore". Column c
+ * expands to one output per entry of Categories[c], which may be strings or numbers. Unknown and
+ * missing values give all zeros.
+ */
+class DLR_DLL OneHotTransformer : public Transformer {
+ public:
+  void MapToNDArray(const nlohmann::json& input_json, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+  int64_t GetNumOutputColumns(const nlohmann::json& transform, int64_t num_cols) const;
+  /*! \brief One table per column, mapping each category to its output column. */
+  std::vector<CategoricalStringTable> Compile(const nlohmann::json& transform) const;
+  void MapToNDArray(const nlohmann::json& input_json,
+                    const std::vector<CategoricalStringTable>& tables,
+                    tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const std::vector<CategoricalStringTable>& tables,
+                    tvm::runtime::NDArray& input_array) const;
+};
+
+/*! \brief Feature hashing, as sklearn FeatureHasher: every value adds to one of NumFeatures
+ * outputs, chosen by the signed 32-bit MurmurHash3 of its feature name and negated for negative
+ * hashes unless AlternateSign is false. A string value is a feature of weight 1, named by the
+ * string, or "name=string" if the optional Names give the column names. A number is a feature
+ * weighted by the number and named by its column name, or column index without Names. Missing
+ * values are skipped.
+ */
+class DLR_DLL HashingTransformer : public Transformer {
+ public:
+  void MapToNDArray(const nlohmann::json& input_json, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+  void MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                    tvm::runtime::NDArray& input_array) const;
+  int64_t GetNumOutputColumns(const nlohmann::json& transform, int64_t num_cols) const;
+};
+
+/*! \brief MurmurHash3 x86 32-bit of key with seed 0, as a signed value like sklearn's. */
+DLR_DLL int32_t MurmurHash3(const char* key, size_t length);
+
+/*! \brief Integer-indexed labels of an output CategoricalString map, each stored as its
+ * serialized JSON value so that outputs are written without building a JSON document.
+ */
+class DLR_DLL OutputLabelTable {
+ public:
+  OutputLabelTable() = default;
+  /*! \brief Compile mapping, a JSON object from integer strings to labels. Labels of integers
+   * without an entry are unknown_label. */
+  OutputLabelTable(const nlohmann::json& mapping, const std::string& unknown_label);
+
+  /*! \brief Append the serialized label of value to out. */
+  void Append(int64_t value, std::string* out) const {
+    const uint64_t index = static_cast<uint64_t>(value) - static_cast<uint64_t>(min_value_);
+    const std::string* label = &unknown_label_;
+    if (index < dense_.size()) {
+      if (!dense_[index].empty()) label = &dense_[index];
+    } else if (!sparse_.empty()) {
+      auto it = sparse_.find(value);
+      if (it != sparse_.end()) label = &it->second;
+    }
+    out->append(*label);
+  }
+
+ private:
+  /*! \brief Labels of [min_value_, min_value_ + dense_.size()), empty where there is no entry. */
+  int64_t min_value_ = 0;
+  std::vector<std::string> dense_;
+  /*! \brief Labels of keys too far apart to be stored densely. */
+  std::unordered_map<int64_t, std::string> sparse_;
+  std::string unknown_label_;
 };
 
 /*! \brief Handles transformations of input and output data. */
@@ -42,26 +300,60 @@ class DLR_DLL DataTransform {
   /*! \brief When there is no mapping entry for TransformOutput, this value is used. */
   const char* kUnknownLabel = "<unknown_label>";
 
-  /*! \brief Buffers to store transformed outputs. Maps output index to transformed data. */
-  std::unordered_map<int, std::string> transformed_outputs_;
+  /*! \brief Tables compiled by CompileInputTransform, per ColumnTransform and column. Empty for
+   * transforms that are not CategoricalString. */
+  std::vector<std::vector<CategoricalStringTable>> input_tables_;
+  /*! \brief Transformer of each ColumnTransform, resolved by CompileInputTransform. */
+  std::vector<const Transformer*> input_transformers_;
+  /*! \brief Metadata, and its ColumnTransform array, the tables were compiled from. */
+  const nlohmann::json* compiled_metadata_ = nullptr;
+  const nlohmann::json* compiled_transforms_ = nullptr;
+
+  /*! \brief Image transform created by CompileImageTransform, and the index of its input. */
+  std::shared_ptr<ImageTransform> image_transform_;
+  int image_input_index_ = -1;
+
+  /*! \brief Output of TransformOutput, serialized on first access. */
+  struct TransformedOutput {
+    /*! \brief Metadata the labels were compiled from. */
+    const nlohmann::json* metadata = nullptr;
+    OutputLabelTable labels;
+    tvm::runtime::NDArray array;
+    /*! \brief True once data holds the serialized array. The buffer is reused across runs. */
+    bool serialized = false;
+    std::string data;
+  };
+
+  /*! \brief Maps output index to transformed output. Serialized lazily by const getters. */
+  mutable std::unordered_map<int, TransformedOutput> transformed_outputs_;
+
+  /*! \brief Check input_array against the preprocessed image shape, and call apply with its
+   * dtype and CPU memory to fill. */
+  void WriteImageInput(const std::vector<int64_t>& shape, tvm::runtime::NDArray& input_array,
+                       const std::function<void(DLDataType, void*)>& apply) const;
+
+  /*! \brief Serialized transformed output, serializing it if this is the first access. */
+  const std::string& GetTransformedOutput(int index) const;
 
   /*! \brief Helper function for TransformInput. Interpets 1-D char input as JSON. */
   nlohmann::json GetAsJson(const int64_t* shape, const void* input, int dim) const;
 
   /*! \brief Helper function for TransformInput. Allocates NDArray to store mapped input data. */
-  tvm::runtime::NDArray InitNDArray(const nlohmann::json& input_json, DLDataType dtype,
+  tvm::runtime::NDArray InitNDArray(int64_t num_rows, int64_t num_cols, DLDataType dtype,
                                     DLContext ctx) const;
 
-  const std::shared_ptr<std::unordered_map<std::string, std::shared_ptr<Transformer>>>
-  GetTransformerMap() const;
+  /*! \brief Apply transform i of transforms, using the compiled tables if there are any. */
+  template <typename Input>
+  void MapInput(const Input& input, int64_t num_rows, int64_t num_cols,
+                const nlohmann::json& transforms, int i, DLDataType dtype, DLContext ctx,
+                tvm::runtime::NDArray* input_array) const;
 
-  template <typename T>
-  nlohmann::json TransformOutputHelper1D(const nlohmann::json& mapping, const T* data,
-                                         const std::vector<int64_t>& shape) const;
+  /*! \brief Transformers by Type. Built once, and read-only afterwards, so that it is safe to use
+   * from any thread. */
+  static const std::unordered_map<std::string, std::shared_ptr<Transformer>>& GetTransformerMap();
 
-  template <typename T>
-  nlohmann::json TransformOutputHelper2D(const nlohmann::json& mapping, const T* data,
-                                         const std::vector<int64_t>& shape) const;
+  /*! \brief Transformer for the Type of transform. */
+  static const Transformer& GetTransformer(const nlohmann::json& transform);
 
  public:
   /*! \brief Returns true if the input requires a data transform */
@@ -70,11 +362,61 @@ class DLR_DLL DataTransform {
   /*! \brief Returns true if the output requires a data transform */
   bool HasOutputTransform(const nlohmann::json& metadata, int index) const;
 
+  /*! \brief Compile the CategoricalString maps of metadata into hash tables, which TransformInput
+   * uses instead of looking up strings in the JSON maps, and resolve the transformer of each
+   * ColumnTransform. metadata must outlive this object and stay unchanged.
+   */
+  void CompileInputTransform(const nlohmann::json& metadata);
+
+  /*! \brief Compile the CategoricalString map of output index into a label table, which
+   * TransformOutput uses without looking up the map in metadata. metadata must outlive this object
+   * and stay unchanged.
+   */
+  void CompileOutputTransform(const nlohmann::json& metadata, int index);
+
+  /*! \brief Returns true if the input requires an Image transform */
+  bool HasImageTransform(const nlohmann::json& metadata) const;
+
+  /*! \brief Set up the Image input transform of metadata for the model inputs. */
+  void CompileImageTransform(const nlohmann::json& metadata,
+                             const std::vector<std::string>& input_names,
+                             const std::vector<std::vector<int64_t>>& input_shapes);
+
+  /*! \brief Index of the input preprocessed by the Image transform, -1 if there is none. */
+  int GetImageInputIndex() const { return image_input_index_; }
+
+  /*! \brief Shape of the preprocessed input for uint8 images of shape [H, W, C] or [N, H, W, C].
+   */
+  std::vector<int64_t> GetImageShape(const int64_t* shape, int dim) const;
+
+  /*! \brief Shape of the preprocessed input for a batch of num_images ImageViews. */
+  std::vector<int64_t> GetImageShape(int64_t num_images) const;
+
+  /*! \brief Preprocess uint8 images of shape [H, W, C] or [N, H, W, C] into input_array, a
+   * float32, int8 or uint8 array of shape GetImageShape(shape, dim). Arrays on other devices are
+   * filled through a CPU buffer.
+   */
+  void TransformImage(const int64_t* shape, const void* input, int dim,
+                      tvm::runtime::NDArray& input_array) const;
+
+  /*! \brief Preprocess images, such as NV12 camera frames or crops of them, into input_array of
+   * shape GetImageShape(num_images).
+   */
+  void TransformImage(const ImageView* images, int64_t num_images,
+                      tvm::runtime::NDArray& input_array) const;
+
+  /*! \brief Crop and resize num_boxes boxes of frame into the first entries of input_array, whose
+   * batch size must be at least num_boxes. The remaining entries are zeroed.
+   */
+  void TransformROIs(const ImageView& frame, const float* boxes, int64_t num_boxes,
+                     tvm::runtime::NDArray& input_array) const;
+
   /*! \brief Transform string input using CategoricalString input DataTransform. When
    * this map is present in the metadata file, the user is expected to provide string inputs to
    * SetDLRInput as 1-D vector. This function will interpret the user's input as JSON, apply the
    * mapping to convert strings to numbers, and produce a numeric NDArray which can be given to TVM
-   * for the model input.
+   * for the model input. Input starting with the ColumnarInput magic is read as binary columns
+   * instead of JSON.
    */
   void TransformInput(const nlohmann::json& metadata, const int64_t* shape, const void* input,
                       int dim, const std::vector<DLDataType>& dtypes, DLContext ctx,
@@ -85,6 +427,8 @@ class DLR_DLL DataTransform {
    * JSON string, where numbers are mapped back to strings according to the CategoricalString map in
    * the metadata file. A buffer is created to store the transformed output, and it's contents can
    * be accessed using the GetOutputShape, GetOutputSizeDim, GetOutput and GetOutputPtr methods.
+   * The output is only serialized when one of them is first called, so outputs that are never
+   * read cost nothing. output_array must not be modified until then.
    */
   void TransformOutput(const nlohmann::json& metadata, int index,
                        const tvm::runtime::NDArray& output_array);
@@ -0,0 +1,130 @@
+#ifndef DLR_GBDT_H_
+#define DLR_GBDT_H_
+
+#include "dlr_allocator.h"
+#include "dlr_common.h"
+#include "dlr_thread_pool.h"
+
+#if defined(_MSC_VER) || defined(_WIN32)
+#define DLR_DLL __declspec(dllexport)
+#else
+#define DLR_DLL
+#endif  // defined(_MSC_VER) || defined(_WIN32)
+
+namespace dlr {
+
+/*! \brief Node of a GBDT tree, 16 bytes so that four nodes share a cache line.
+ *
+ * A row goes to the left child if its feature value is less than threshold, and to the default
+ * child if the value is missing. Leaves hold their value in threshold and point to themselves,
+ * so that a tree can be traversed for a fixed number of steps without branching.
+ */
+struct GBDTNode {
+  static constexpr uint32_t kFeatureMask = 0x3fffffff;
+  /*! \brief Missing values go to the left child. */
+  static constexpr uint32_t kDefaultLeft = 1u << 31;
+  /*! \brief Zero values are treated as missing (LightGBM missing_type Zero). */
+  static constexpr uint32_t kZeroIsMissing = 1u << 30;
+
+  float threshold;
+  /*! \brief Feature index and flags. */
+  uint32_t feature;
+  int32_t left;
+  int32_t right;
+};
+
+/*! \brief Get the paths of the GBDT model files.
+ */
+ModelPath SetGBDTPaths(const std::vector<std::string>& files);
+
+/*! \brief class GBDTModel
+ *
+ * Evaluates XGBoost JSON models (save_model with a .json extension) and LightGBM JSON dumps
+ * (dump_model) without compiling them. Trees are stored breadth first in one node array, and
+ * rows are scored in blocks: each tree is applied to a whole block of rows before moving to the
+ * next one, stepping every row one level per iteration (eight rows per instruction with AVX2).
+ */
+class DLR_DLL GBDTModel : public DLRModel {
+ private:
+  static const std::string INPUT_NAME;
+  static const std::string INPUT_TYPE;
+  static const std::string OUTPUT_TYPE;
+  static const int kInputDim = 2;
+
+  enum class Transform { kIdentity, kSigmoid, kSoftmax, kExp, kArgmax };
+
+  struct Tree {
+    int32_t root;
+    /*! \brief Number of steps from the root to the deepest leaf. */
+    int32_t depth;
+    /*! \brief Output group the tree contributes to. */
+    int32_t group;
+  };
+
+  std::vector<GBDTNode, DLRAllocator<GBDTNode>> nodes_;
+  std::vector<Tree> trees_;
+  size_t num_feature_ = 0;
+  size_t num_group_ = 1;
+  std::vector<float> base_margin_;
+  Transform transform_ = Transform::kIdentity;
+  float sigmoid_alpha_ = 1.0f;
+  /*! \brief Factor applied to the margin before the transform, 1 / num_iteration for LightGBM
+   * random forests. */
+  float margin_scale_ = 1.0f;
+  size_t output_size_ = 1;
+
+  // Input rows padded with NaN to num_feature_ columns, so traversal needs no bounds checks.
+  std::vector<float, DLRAllocator<float>> input_;
+  int64_t num_row_ = -1;
+  std::vector<float, DLRAllocator<float>> margin_;
+  std::vector<float, DLRAllocator<float>> output_;
+  TVMThreadPoolConfig thread_pool_;
+
+  void SetupGBDTModule(const std::vector<std::string>& files);
+  void LoadXGBoost(const nlohmann::json& model);
+  void LoadLightGBM(const nlohmann::json& model);
+  /*! \brief Score rows [begin, end). */
+  void PredictBlock(size_t begin, size_t end);
+  void TraverseTree(const Tree& tree, const float* rows, size_t num_row, int32_t* leaves) const;
+  void TransformRow(const float* margin, float* out) const;
+  void UpdateInputShapes();
+
+ public:
+  /*! \brief Rows scored together, small enough that their leaf indices stay in registers or L1. */
+  static const size_t kBlockRows = 64;
+
+  /*! \brief Load model files from given folder path.
+   */
+  explicit GBDTModel(const std::vector<std::string>& files, const DLContext& ctx)
+      : DLRModel(ctx, DLRBackend::kGBDT) {
+    SetupGBDTModule(files);
+  }
+
+  virtual const int GetInputDim(int index) const override;
+  virtual const int64_t GetInputSize(int index) const override;
+  virtual const char* GetInputName(int index) const override;
+  virtual const char* GetInputType(int index) const override;
+  virtual void GetInput(const char* name, void* input) override;
+  virtual void SetInput(const char* name, const int64_t* shape, const void* input,
+                        int dim) override;
+
+  virtual void GetOutput(int index, void* out) override;
+  virtual const void* GetOutputPtr(int index) const override;
+  virtual void GetOutputShape(int index, int64_t* shape) const override;
+  virtual void GetOutputSizeDim(int index, int64_t* size, int* dim) override;
+  virtual const char* GetOutputType(int index) const override;
+
+  virtual const char* GetWeightName(int index) const override;
+  virtual std::vector<std::string> GetWeightNames() const override;
+
+  virtual void Run() override;
+  virtual void SetNumThreads(int threads) override;
+  virtual void UseCPUAffinity(bool use) override;
+
+  size_t GetNumTrees() const { return trees_.size(); }
+  size_t GetNumNodes() const { return nodes_.size(); }
+};
+
+}  // namespace dlr
+
+#endif  // DLR_GBDT_H_
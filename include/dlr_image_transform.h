@@ -0,0 +1,166 @@
+#ifndef DLR_IMAGE_TRANSFORM_H_
+#define DLR_IMAGE_TRANSFORM_H_
+
+#include <nlohmann/json.hpp>
+
+#include "dlr_common.h"
+
+namespace dlr {
+
+/*! \brief An 8-bit image in CPU memory, and the region of it to preprocess. */
+struct DLR_DLL ImageView {
+  enum class Format {
+    /*! \brief Interleaved channels in RGB order, one plane. */
+    kPacked,
+    /*! \brief Interleaved BGR, one plane. */
+    kBGR,
+    /*! \brief Y plane, then a half resolution plane of interleaved U and V. */
+    kNV12,
+    /*! \brief As kNV12, with V before U. */
+    kNV21,
+    /*! \brief Y, U and V planes, U and V at half resolution. */
+    kI420,
+  };
+  Format format = Format::kPacked;
+  /*! \brief Channels of a kPacked image. The other formats have 3. */
+  int64_t channels = 3;
+  int64_t width = 0;
+  int64_t height = 0;
+  const uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+  /*! \brief Bytes per row of each plane. */
+  int64_t strides[3] = {0, 0, 0};
+  /*! \brief Region to preprocess, the whole image if crop_width or crop_height is 0. */
+  float crop_x = 0.0f;
+  float crop_y = 0.0f;
+  float crop_width = 0.0f;
+  float crop_height = 0.0f;
+};
+
+/*! \brief Preprocessing of 8-bit images into a model's normalized input.
+ *
+ * Configured by the "Image" object of the metadata's DataTransform Input, for example:
+ *
+ *   "Image": {
+ *     "InputName": "data",          // Default: the first model input.
+ *     "Height": 224, "Width": 224,  // Default: taken from the model input shape.
+ *     "Layout": "NCHW",             // Layout of the model input, "NCHW" or "NHWC".
+ *     "ChannelOrder": "BGR",        // Channel order of the model input. Images are RGB.
+ *     "Scale": 1.0,                 // Pixels are multiplied by Scale,
+ *     "Mean": [103.53, 116.28, 123.675],  // then normalized per model channel.
+ *     "Std": [57.375, 57.12, 58.395],
+ *     "Resize": "Bilinear",         // Or "Nearest".
+ *     "YUVMatrix": "BT601",         // Or "BT709", for NV12, NV21 and I420 images.
+ *     "YUVRange": "Limited",        // Or "Full".
+ *     "BoxOrder": "XYXY",           // Or "YXYX", for the boxes of ApplyROIs.
+ *     "BoxNormalized": false,       // Whether box coordinates are relative to the frame size.
+ *     "ROI": {"Boxes": "detection_boxes"}  // In a pipeline, crop boxes of the previous model.
+ *   }
+ *
+ * The model input may be float32, or int8 or uint8, in which case normalized values are rounded
+ * and saturated; quantization parameters are folded into Scale, Mean and Std.
+ *
+ * Every output row is produced in one pass over the source: the sampled pixels of the two source
+ * rows are blended vertically into a float row buffer and converted to RGB if they are YUV, so
+ * that each sampled column is converted once. The row is then sampled horizontally, normalized
+ * with one multiply-add per value and written to its channel plane.
+ */
+class DLR_DLL ImageTransform {
+ public:
+  enum class Layout { kNCHW, kNHWC };
+  enum class Resize { kBilinear, kNearest };
+  static const int kMaxChannels = 4;
+
+  /*! \brief Parse config for a model input of the given name and 4-D shape. */
+  ImageTransform(const nlohmann::json& config, const std::string& input_name,
+                 const std::vector<int64_t>& input_shape);
+
+  const std::string& GetInputName() const { return input_name_; }
+
+  /*! \brief Shape of the preprocessed input for a batch of images. */
+  std::vector<int64_t> GetOutputShape(int64_t batch) const;
+
+  /*! \brief Shape of the preprocessed input for images of shape [H, W, C] or [N, H, W, C]. */
+  std::vector<int64_t> GetOutputShape(const int64_t* shape, int dim) const;
+
+  /*! \brief Preprocess packed RGB images of shape [H, W, C] or [N, H, W, C] into out, which holds
+   * GetOutputShape(shape, dim) values of type dtype.
+   */
+  void Apply(const uint8_t* images, const int64_t* shape, int dim, DLDataType dtype,
+             void* out) const;
+
+  /*! \brief Preprocess num_images images into out, which holds GetOutputShape(num_images) values
+   * of type dtype. Each image or crop is resized to the model input.
+   */
+  void Apply(const ImageView* images, int64_t num_images, DLDataType dtype, void* out) const;
+
+  /*! \brief Crop num_boxes regions of interest from frame, resize them like Apply and write them to
+   * the first num_boxes entries of out, which holds GetOutputShape(batch) values of type dtype. The
+   * remaining entries are zeroed. Boxes are 4 floats each, in BoxOrder, and are clipped to the
+   * frame. Crop and resize is one bilinear sample per output pixel, as in ROIAlign with aligned
+   * pixel centers.
+   */
+  void ApplyROIs(const ImageView& frame, const float* boxes, int64_t num_boxes, int64_t batch,
+                 DLDataType dtype, void* out) const;
+
+ private:
+  /*! \brief Source index pair and weight of the second one, for one output row or column. */
+  struct Tap {
+    int32_t first;
+    int32_t second;
+    float weight;
+  };
+
+  /*! \brief Sampling of one image. */
+  struct Plan {
+    std::vector<Tap> row_taps;
+    /*! \brief Sampled source columns, ascending. col_taps index into them. */
+    std::vector<int32_t> columns;
+    std::vector<Tap> col_taps;
+    /*! \brief Whether columns is a whole span, converted without gathering. */
+    bool contiguous;
+    /*! \brief Values per sampled pixel in a converted row. */
+    int64_t pixel_channels;
+    /*! \brief Row value read for each model channel. */
+    int source_channel[kMaxChannels];
+  };
+
+  std::string input_name_;
+  Layout layout_ = Layout::kNCHW;
+  Resize resize_ = Resize::kBilinear;
+  int64_t height_ = 0;
+  int64_t width_ = 0;
+  int64_t channels_ = 0;
+  /*! \brief RGB channel read for each model channel. */
+  int source_channel_[kMaxChannels];
+  /*! \brief Each model channel is pixel * scale_ + bias_. */
+  float scale_[kMaxChannels];
+  float bias_[kMaxChannels];
+  /*! \brief YUV to RGB: R = luma * (Y - luma_offset) + rv * V, G = ... - gu * U - gv * V,
+   * B = ... + bu * U, with U and V centered on 128. */
+  float luma_offset_ = 16.0f;
+  float luma_ = 0.0f;
+  float rv_ = 0.0f;
+  float gu_ = 0.0f;
+  float gv_ = 0.0f;
+  float bu_ = 0.0f;
+  /*! \brief Boxes are [y1, x1, y2, x2] rather than [x1, y1, x2, y2]. */
+  bool box_yx_ = false;
+  bool box_normalized_ = false;
+
+  std::vector<Tap> MakeTaps(double origin, double size, int64_t limit, int64_t dst_size) const;
+  Plan MakePlan(const ImageView& image) const;
+  /*! \brief Convert the sampled pixels of source row y to float, as Y, U, V for YUV images. */
+  void LoadRow(const ImageView& image, const Plan& plan, int64_t y, float* row) const;
+  /*! \brief Convert a blended row of Y, U, V values to RGB in place. */
+  void ConvertRow(size_t num_columns, float* row) const;
+  /*! \brief Blend the two source rows of output row y into row. other is scratch space. */
+  void BlendRows(const ImageView& image, const Plan& plan, int64_t y, float* row,
+                 float* other) const;
+  /*! \brief Sample row horizontally, normalize it and write output row y of one image. */
+  template <typename T>
+  void WriteRow(const Plan& plan, const float* row, int64_t y, T* out) const;
+};
+
+}  // namespace dlr
+
+#endif  // DLR_IMAGE_TRANSFORM_H_
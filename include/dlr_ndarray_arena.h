@@ -0,0 +1,79 @@
+#ifndef DLR_NDARRAY_ARENA_H_
+#define DLR_NDARRAY_ARENA_H_
+
+#include <tvm/runtime/ndarray.h>
+
+#include <vector>
+
+#include "dlr_common.h"
+
+namespace dlr {
+
+/*! \brief Hit and miss counters for NDArrayArena. */
+struct NDArrayArenaStats {
+  /*! \brief Requests served from an existing bucket. */
+  uint64_t hits = 0;
+  /*! \brief Requests that required a new allocation. */
+  uint64_t misses = 0;
+};
+
+/*! \brief Caches NDArray storage bucketed by shape, so that repeated requests for the same (or a
+ * smaller) shape reuse an existing allocation instead of calling NDArray::Empty every time.
+ *
+ * A request is served from the bucket with the exact shape if there is one, otherwise from the
+ * smallest bucket whose storage fits the request without wasting more than half of it. Requests
+ * served from a larger bucket get a view of the bucket storage. When the number of buckets would
+ * exceed the maximum, the least recently used bucket is replaced. A maximum of 0 disables caching.
+ *
+ * Only idle buckets, whose storage is not referenced outside the arena, are handed out again. An
+ * array returned by Get() keeps its storage to itself for as long as it is held; while it is, a
+ * request for its shape gets a new bucket.
+ */
+class DLR_DLL NDArrayArena {
+ public:
+  static constexpr size_t kDefaultMaxBuckets = 8;
+
+  explicit NDArrayArena(size_t max_buckets = kDefaultMaxBuckets) : max_buckets_(max_buckets) {}
+
+  /*! \brief Get an array with the given shape and dtype on ctx, from an idle bucket if one fits. */
+  tvm::runtime::NDArray Get(const std::vector<int64_t>& shape, DLDataType dtype, DLContext ctx);
+
+  /*! \brief Set the maximum number of buckets, evicting least recently used ones if needed. */
+  void SetMaxBuckets(size_t max_buckets);
+  size_t GetMaxBuckets() const { return max_buckets_; }
+  size_t GetNumBuckets() const { return buckets_.size(); }
+
+  const NDArrayArenaStats& GetStats() const { return stats_; }
+  void ResetStats() { stats_ = NDArrayArenaStats(); }
+
+  /*! \brief Release all cached buckets. */
+  void Clear() { buckets_.clear(); }
+
+  /*! \brief Bytes of storage held by all buckets. */
+  size_t GetBytes() const;
+  /*! \brief Bytes of storage held by buckets whose arrays are not referenced outside the arena. */
+  size_t GetIdleBytes() const;
+  /*! \brief Release idle buckets, least recently used first, until at most watermark_bytes of
+   * idle storage remain. Returns the number of bytes released.
+   */
+  size_t TrimIdle(size_t watermark_bytes);
+
+ private:
+  struct Bucket {
+    std::vector<int64_t> shape;
+    DLDataType dtype;
+    size_t nbytes;
+    uint64_t last_used;
+    tvm::runtime::NDArray storage;
+  };
+  size_t max_buckets_;
+  uint64_t clock_ = 0;
+  std::vector<Bucket> buckets_;
+  NDArrayArenaStats stats_;
+
+  void EvictLeastRecentlyUsed();
+};
+
+}  // namespace dlr
+
+#endif  // DLR_NDARRAY_ARENA_H_
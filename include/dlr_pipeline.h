@@ -5,6 +5,7 @@
 #include <tvm/runtime/memory.h>
 
 #include "dlr_common.h"
+#include "dlr_image_transform.h"
 
 #if defined(_MSC_VER) || defined(_WIN32)
 #define DLR_DLL __declspec(dllexport)
@@ -15,13 +16,54 @@
 namespace dlr {
 
 /*! \brief class PipelineModel
+ *
+ * Outputs of each model are the inputs of the next. A model input with an Image transform whose
+ * config has an "ROI" object instead receives boxes of the previous model, such as detections,
+ * cropped from the frame given to SetImageInput, which must stay valid until Run returns:
+ *
+ *   "ROI": {
+ *     "Boxes": "detection_boxes",     // Output of boxes, shape [..., 4], by name or index.
+ *     "Count": "num_detections",      // Optional output with the number of valid leading boxes.
+ *     "Scores": "detection_scores",   // Optional output with one score per box,
+ *     "ScoreThreshold": 0.5           // below which boxes are skipped. Default: 0.
+ *   }
+ *
+ * Padding boxes past Count are not cropped. With a static batch size, boxes beyond it are
+ * dropped, as detectors emit boxes by descending score; the remaining batch entries are zeroed.
+ * The other inputs of the model receive the outputs of the same index.
+ *
+ * When no box is selected, as for a frame without detections, the model and the ones after it are
+ * not run and the pipeline reports empty outputs: batch 0 in GetOutputShape, size 0 in
+ * GetOutputSizeDim, no class scores, and a null GetOutputPtr.
  */
 class DLR_DLL PipelineModel : public DLRModel {
  private:
   int count_;
   const std::vector<DLRModelPtr> dlr_models_;
+  /*! \brief Images given to SetImageInput, cropped by boxes between models. */
+  std::vector<ImageView> frames_;
+  /*! \brief Outputs of the previous model cropped into an Image input, from its "ROI" config. */
+  struct ROILink {
+    int input = -1;
+    int boxes = -1;
+    int count = -1;
+    int scores = -1;
+    float score_threshold = 0.0f;
+  };
+  /*! \brief ROI link of each model, input -1 if it has none. */
+  std::vector<ROILink> roi_links_;
+  /*! \brief Boxes that pass the score threshold, reused across runs. */
+  std::vector<float> roi_boxes_;
+  /*! \brief Whether the last Run stopped at a model given no boxes, leaving outputs empty. */
+  bool empty_outputs_ = false;
   void CheckModelsCompatibility(const DLRModelPtr& m0, const DLRModelPtr& m1, const int m1_id,
                                 const bool is_runtime_check);
+  /*! \brief Whether input j of model m1_id receives crops of boxes of the previous model. */
+  bool IsROIInput(int m1_id, int j) const { return roi_links_[m1_id].input == j; }
+  ROILink MakeROILink(int m1_id) const;
+  /*! \brief Select at most max_boxes boxes from the outputs of the previous model. */
+  int64_t SelectROIs(const DLRModelPtr& m0, const ROILink& link, int64_t max_boxes,
+                     const float** boxes);
   void SetupPipelineModel();
 
  public:
@@ -39,8 +81,19 @@ class DLR_DLL PipelineModel : public DLRModel {
   virtual void GetInput(const char* name, void* input) override;
   virtual void SetInput(const char* name, const int64_t* shape, const void* input,
                         int dim) override;
+  virtual void SetInputBatch(const char* name, const void** samples, int n) override;
+  virtual void SetImageInput(const char* name, const ImageView* images, int64_t n) override;
+  virtual void SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                           int64_t num_boxes) override;
+  virtual int GetImageInputIndex() const override;
+  virtual void SetSparseInput(const float* data, const uint32_t* col_ind, const size_t* row_ptr,
+                              size_t num_row, size_t num_col) override;
 
   virtual void GetOutput(int index, void* out) override;
+  virtual void GetOutputBatch(int index, void** dests, int n) override;
+  virtual void SetOutputPostprocess(int index, const Postprocess& postprocess) override;
+  virtual void GetOutputClassScores(int index, DLRClassScore* results, int64_t capacity,
+                                    int64_t* num_results) override;
   virtual const void* GetOutputPtr(int index) const override;
   virtual void GetOutputShape(int index, int64_t* shape) const override;
   virtual void GetOutputSizeDim(int index, int64_t* size, int* dim) override;
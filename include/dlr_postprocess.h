@@ -0,0 +1,65 @@
+#ifndef DLR_POSTPROCESS_H_
+#define DLR_POSTPROCESS_H_
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+#if defined(_MSC_VER) || defined(_WIN32)
+#define DLR_DLL __declspec(dllexport)
+#else
+#define DLR_DLL
+#endif  // defined(_MSC_VER) || defined(_WIN32)
+
+#ifndef DLR_CLASS_SCORE
+#define DLR_CLASS_SCORE
+/*! \brief A class of a classification output and its score. */
+typedef struct ClassScore {
+  int32_t index;
+  float score;
+} DLRClassScore;
+#endif
+
+namespace dlr {
+
+/*! \brief Post-processing of float32 classification outputs into their best classes.
+ *
+ * Configured by the "Postprocess" object of the metadata's DataTransform Output, for example:
+ *
+ *   "DataTransform": {"Output": {"0": {"Postprocess": {"TopK": 5, "Softmax": true}}}}
+ *
+ * Each row of the output's last dimension gives TopK results, best first, with ties going to the
+ * lower class index. TopK 1 is argmax. Scores are softmax probabilities if Softmax is set and the
+ * logits otherwise. Rows are read in place: one pass selects the classes, skipping blocks whose
+ * maximum cannot enter the selection, and since softmax preserves the order, a second pass only
+ * sums the softmax denominator. Both run branch-free loops that the compiler vectorizes. Logits
+ * must not be NaN.
+ */
+class DLR_DLL Postprocess {
+ public:
+  /*! \brief Disabled post-processing, which has no results. */
+  Postprocess() = default;
+  Postprocess(int64_t top_k, bool softmax);
+  /*! \brief Parse a "Postprocess" object of the metadata. */
+  explicit Postprocess(const nlohmann::json& config);
+
+  bool Enabled() const { return top_k_ > 0; }
+  int64_t GetTopK() const { return top_k_; }
+  bool GetSoftmax() const { return softmax_; }
+  /*! \brief Results per row of num_classes classes. */
+  int64_t GetNumResults(int64_t num_classes) const {
+    return top_k_ < num_classes ? top_k_ : num_classes;
+  }
+  /*! \brief Select the best classes of num_rows rows of num_classes logits each, writing
+   * num_rows * GetNumResults(num_classes) results. Rows are processed in parallel.
+   */
+  void Apply(const float* logits, int64_t num_rows, int64_t num_classes,
+             DLRClassScore* results) const;
+
+ private:
+  int64_t top_k_ = 0;
+  bool softmax_ = false;
+};
+
+}  // namespace dlr
+
+#endif  // DLR_POSTPROCESS_H_
@@ -12,6 +12,9 @@
 
 #include "dlr_common.h"
 #include "dlr_data_transform.h"
+#include "dlr_ndarray_arena.h"
+#include "dlr_thread_pool.h"
+#include "dlr_vm_memory_pool.h"
 
 #ifdef _WIN32
 #define LIBEXT ".dll"
@@ -32,25 +35,63 @@
 
 namespace dlr {
 
+class RelayVirtualMachine;
+
 class DLR_DLL RelayVMModel : public DLRModel {
  private:
   static const std::string ENTRY_FUNCTION;
   std::vector<std::string> output_names_;
   std::vector<std::string> output_types_;
   std::shared_ptr<tvm::runtime::Module> vm_module_;
+  /*! \brief The VM of vm_module_, which owns it. */
+  RelayVirtualMachine* vm_ = nullptr;
   std::shared_ptr<tvm::runtime::Module> vm_executable_;
   std::vector<tvm::runtime::NDArray> inputs_;
+  /*! \brief Input dtypes parsed from metadata at load. bits == 0 marks an unknown dtype. */
+  std::vector<DLDataType> input_dtypes_;
+  /*! \brief Per-input storage reused across SetInput calls with the same shape. */
+  std::vector<NDArrayArena> input_arenas_;
+  /*! \brief Whether inputs_[i] wraps caller memory instead of owning a copy. */
+  std::vector<bool> input_borrowed_;
+  bool zero_copy_input_ = false;
   tvm::runtime::ObjectRef output_ref_;
   std::vector<tvm::runtime::NDArray> outputs_;
   std::vector<std::vector<int64_t>> output_shapes_;
+  /*! \brief Name lookups and transform flags compiled from metadata at load, so that per-request
+   * calls do not walk the metadata JSON. */
+  std::unordered_map<std::string, int> input_indices_;
+  std::unordered_map<std::string, int> output_indices_;
+  bool has_input_transform_ = false;
+  std::vector<bool> has_output_transform_;
   DataTransform data_transform_;
+  TVMThreadPoolConfig thread_pool_config_;
+  /*! \brief Devices used by the VM, ctx_ first, and the memory pools of the model on them. */
+  std::vector<DLContext> memory_ctxs_;
+  std::vector<VMMemoryPool*> vm_pools_;
+  std::vector<int64_t> peak_bytes_;
+  /*! \brief VM functions looked up once at load. */
+  tvm::runtime::PackedFunc set_input_;
+  tvm::runtime::PackedFunc invoke_;
+  /*! \brief Argument storage for set_input, the entry function name is bound at load. */
+  std::vector<TVMValue> set_input_values_;
+  std::vector<int> set_input_type_codes_;
   void SetupVMModule(const std::vector<std::string>& paths);
   void SetupVMModule(const std::vector<DLRModelElem>& model_elems);
   void FetchInputNodesData();
   void FetchOutputNodesData();
   void UpdateOutputs();
   void UpdateInputs();
-  DLDataType GetInputDLDataType(int index);
+  DLDataType GetInputDLDataType(int index) const;
+  bool BorrowInput(int index, const DLTensor& tensor);
+  void ReleaseBorrowedInputs();
+  /*! \brief Drop the references of the model and the VM to input index. */
+  void ReleaseInput(int index);
+  /*! \brief Release input index and get storage for its next value from the input arena. */
+  tvm::runtime::NDArray GetInputStorage(int index, const std::vector<int64_t>& shape,
+                                        DLDataType dtype);
+  int64_t GetVMPoolBytes() const;
+  int64_t GetInputArenaBytes() const;
+  void UpdatePeakMemory();
 
  public:
   explicit RelayVMModel(const std::vector<std::string>& files, const DLContext& ctx)
@@ -65,6 +106,7 @@ class DLR_DLL RelayVMModel : public DLRModel {
     FetchInputNodesData();
     FetchOutputNodesData();
   }
+  ~RelayVMModel();
 
   int GetInputIndex(const char* name) const;
   virtual const int GetInputDim(int index) const override;
@@ -77,10 +119,20 @@ class DLR_DLL RelayVMModel : public DLRModel {
   virtual void SetInput(const char* name, const int64_t* shape, const void* input,
                         int dim) override;
   void SetInputTensor(const char* name, DLTensor* tensor);
+  virtual void SetInputBatch(const char* name, const void** samples, int n) override;
+  virtual void SetImageInput(const char* name, const ImageView* images, int64_t n) override;
+  virtual void SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                           int64_t num_boxes) override;
+  virtual int GetImageInputIndex() const override;
+  /*! \brief Whether inputs are converted by a ColumnTransform of the metadata. */
+  bool HasInputTransform() const { return has_input_transform_; }
+  /*! \brief Whether output index is converted by a transform of the metadata. */
+  bool HasOutputTransform(int index) const { return has_output_transform_[index]; }
   virtual int GetNumInputs() const override;
   virtual void Run() override;
   tvm::runtime::NDArray GetOutput(int index);
   virtual void GetOutput(int index, void* out) override;
+  virtual void GetOutputBatch(int index, void** dests, int n) override;
   void GetOutputManagedTensorPtr(int index, const DLManagedTensor** out);
   virtual const void* GetOutputPtr(int index) const override;
   virtual void GetOutputShape(int index, int64_t* shape) const override;
@@ -90,6 +142,35 @@ class DLR_DLL RelayVMModel : public DLRModel {
   virtual void SetNumThreads(int threads) override;
   virtual void UseCPUAffinity(bool use) override;
 
+  /*! \brief Run the model once per shape set with zero-filled inputs, so that the pooled VM
+   * allocators reach the size needed for those shapes before real traffic arrives. Each shape set
+   * holds one shape per input. An empty list uses the input shapes from metadata, which must be
+   * concrete. Previously set inputs are kept; outputs of a previous Run are overwritten.
+   * \return Bytes held by the VM memory pools of the model's devices after warmup.
+   */
+  int64_t Warmup(const std::vector<std::vector<std::vector<int64_t>>>& shape_sets);
+  /*! \brief Get memory held per device, ctx_ first: the VM memory pools of the model, and on
+   * ctx_ the input arenas. Cached bytes are their idle blocks and buckets.
+   */
+  std::vector<DLRMemoryStats> GetMemoryStats();
+  /*! \brief Release idle input storage and idle VM pool blocks until at most watermark_bytes
+   * remain cached per device. Memory of other models is not touched. Must not be called during
+   * Run.
+   */
+  void TrimMemory(int64_t watermark_bytes);
+  /*! \brief Enable or disable zero-copy inputs. When enabled on a CPU context, SetInput and
+   * SetInputTensor wrap suitably aligned caller buffers instead of copying them. The buffer must
+   * stay valid and unmodified until the next Run returns. When Run returns, the model and the VM
+   * drop every reference to it, so it has to be set again before the next Run, and outputs that
+   * share its memory, such as reshapes of the input, are copied. Inputs that cannot be wrapped
+   * are copied as usual.
+   */
+  void SetZeroCopyInput(bool enable);
+  /*! \brief Set the maximum number of shape buckets kept per input. 0 disables input reuse. */
+  void SetInputArenaMaxBuckets(size_t max_buckets);
+  /*! \brief Get input arena hit and miss counts, summed over all inputs. */
+  NDArrayArenaStats GetInputArenaStats() const;
+
   /*
     Following methods use metadata file to lookup input and output names.
   */
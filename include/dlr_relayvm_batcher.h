@@ -0,0 +1,91 @@
+#ifndef DLR_RELAYVM_BATCHER_H_
+#define DLR_RELAYVM_BATCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dlr_relayvm.h"
+
+namespace dlr {
+
+/*! \brief Configuration of RelayVMBatcher. */
+struct DLR_DLL RelayVMBatcherConfig {
+  /*! \brief Ascending upper bounds of the sequence length buckets. Longer sequences go to an
+   * extra overflow bucket. */
+  std::vector<int64_t> bucket_boundaries = {16, 32, 64, 128, 256};
+  /*! \brief Maximum number of requests run in one invoke. */
+  int max_batch_size = 8;
+  /*! \brief Longest time a request waits for its bucket to fill before it is run anyway. */
+  std::chrono::microseconds max_queue_delay{2000};
+};
+
+/*! \brief Dynamic batching front-end for RelayVM sequence models.
+ *
+ * Every model input must have the shape [batch, sequence, ...] with static trailing dimensions,
+ * and every output must have the batch as its first dimension. Models with input or output
+ * transforms in their metadata are rejected, since batches are built from raw tensors.
+ * Concurrent Predict calls are grouped by sequence length into buckets. Each bucket is padded
+ * with zeros to the longest sequence in it, run with one VM invoke, and each caller receives its
+ * row of every output.
+ *
+ * The batcher runs the model on its own worker thread, so the model must not be used directly
+ * while the batcher exists.
+ */
+class DLR_DLL RelayVMBatcher {
+ public:
+  RelayVMBatcher(RelayVMModel* model, const RelayVMBatcherConfig& config);
+  ~RelayVMBatcher();
+
+  /*! \brief Run one request and block until its results are ready.
+   * \param inputs One buffer per model input, each of shape [length, ...] without the batch
+   *        dimension.
+   * \param length Sequence length of this request.
+   * \param outputs Set to one buffer per model output, holding this request's row.
+   * \param output_shapes Set to the shape of each output row, with a batch dimension of 1.
+   *        Outputs with a sequence dimension are padded to the longest sequence in the batch.
+   */
+  void Predict(const std::vector<const void*>& inputs, int64_t length,
+               std::vector<std::vector<char>>* outputs,
+               std::vector<std::vector<int64_t>>* output_shapes);
+
+  /*! \brief Index of the bucket for a sequence length. */
+  size_t GetBucketIndex(int64_t length) const;
+
+ private:
+  struct Request {
+    const std::vector<const void*>* inputs;
+    int64_t length;
+    std::vector<std::vector<char>>* outputs;
+    std::vector<std::vector<int64_t>>* output_shapes;
+    std::chrono::steady_clock::time_point enqueue_time;
+    std::promise<void> done;
+  };
+
+  RelayVMModel* model_;
+  const RelayVMBatcherConfig config_;
+  /*! \brief Per input: element size in bytes and trailing dimensions after the sequence. */
+  std::vector<size_t> input_elem_bytes_;
+  std::vector<std::vector<int64_t>> input_trailing_shapes_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::deque<Request*>> buckets_;
+  bool stop_ = false;
+  std::thread worker_;
+
+  void WorkerLoop();
+  /*! \brief Pick a bucket that is full or whose oldest request waited long enough. Returns -1 and
+   * sets wake_time to the next deadline if there is none. */
+  int SelectBucket(std::chrono::steady_clock::time_point now,
+                   std::chrono::steady_clock::time_point* wake_time) const;
+  void RunBatch(const std::vector<Request*>& batch);
+};
+
+}  // namespace dlr
+
+#endif  // DLR_RELAYVM_BATCHER_H_
@@ -0,0 +1,46 @@
+#ifndef DLR_THREAD_POOL_H_
+#define DLR_THREAD_POOL_H_
+
+#include <functional>
+
+#include "dlr_common.h"
+
+namespace dlr {
+
+/*! \brief Thread count and CPU affinity for the TVM runtime thread pool, shared by the TVM based
+ * backends.
+ *
+ * TVM keeps one thread pool per calling thread, shared by all models run on it. Apply()
+ * reconfigures the pool of the calling thread whenever it was last configured with other
+ * settings, e.g. by another model, so each model runs with its own. Models that set nothing use
+ * the thread count and affinity TVM picked from the environment when the first model was created.
+ * Disabling affinity unpins workers that an earlier configuration pinned.
+ *
+ * TVM_NUM_THREADS is raised to the largest thread count requested, so that pools created later
+ * have enough workers; an existing pool cannot grow beyond the number it was created with.
+ */
+class DLR_DLL TVMThreadPoolConfig {
+ public:
+  TVMThreadPoolConfig();
+
+  void SetNumThreads(int threads);
+  void UseCPUAffinity(bool use);
+
+  /*! \brief Reconfigure the thread pool of the calling thread if its settings differ. */
+  void Apply() const;
+
+ private:
+  int num_threads_;
+  bool bind_;
+};
+
+/*! \brief Split [0, num_items) into contiguous ranges of at least min_items items and call
+ * fn(begin, end) for each range on the TVM runtime thread pool. Runs inline when there is only
+ * one range. Rethrows the first exception thrown by fn.
+ */
+DLR_DLL void ParallelFor(size_t num_items, size_t min_items,
+                         const std::function<void(size_t, size_t)>& fn);
+
+}  // namespace dlr
+
+#endif  // DLR_THREAD_POOL_H_
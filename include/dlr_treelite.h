@@ -3,6 +3,8 @@
 
 #include <treelite/c_api_runtime.h>
 
+#include <functional>
+
 #include "dlr_allocator.h"
 #include "dlr_common.h"
 
@@ -17,14 +19,37 @@ namespace dlr {
 /*! \brief Structure to hold Treelite Input.
  */
 struct TreeliteInput {
+  // CSR buffers, used when the input is assembled as a sparse batch.
   std::vector<float, DLRAllocator<float>> data;
   std::vector<uint32_t, DLRAllocator<uint32_t>> col_ind;
   std::vector<size_t, DLRAllocator<size_t>> row_ptr;
-  size_t num_row;
-  size_t num_col;
-  CSRBatchHandle handle;
+  // Copy of a dense input, unless the caller's buffer is used directly.
+  std::vector<float, DLRAllocator<float>> dense_data;
+  // Single instance, predicted with TreelitePredictorPredictInst instead of a batch.
+  std::vector<TreelitePredictorEntry> inst;
+  size_t num_row = 0;
+  size_t num_col = 0;
+  bool is_instance = false;
+  // Whether handle is a CSRBatchHandle or a DenseBatchHandle.
+  bool is_sparse = false;
+  void* handle = nullptr;
+
+  TreeliteInput() = default;
+  TreeliteInput(const TreeliteInput&) = delete;
+  TreeliteInput& operator=(const TreeliteInput&) = delete;
+  ~TreeliteInput() { ReleaseBatch(); }
+
+  /*! \brief Release the batch assembled by Treelite, keeping the buffers for reuse. */
+  void ReleaseBatch();
 };
 
+/*! \brief Reads up to max_rows rows into buffer and returns the number of rows read. Returning 0
+ * ends the stream. */
+using TreeliteStreamReader = std::function<size_t(float* buffer, size_t max_rows)>;
+/*! \brief Receives the predictions of num_row consecutive rows, row_size values per row. */
+using TreeliteStreamWriter =
+    std::function<void(const float* out, size_t num_row, size_t row_size)>;
+
 /*! \brief Get the paths of the Treelite model files.
  */
 ModelPath SetTreelitePaths(const std::vector<std::string>& files);
@@ -38,7 +63,13 @@ class DLR_DLL TreeliteModel : public DLRModel {
   static const std::string OUTPUT_TYPE;
   static const int kInputDim = 2;
   // fields for Treelite model
-  PredictorHandle treelite_model_;
+  // Treelite fixes the worker count at load, so the predictor is reloaded for another thread
+  // count, and the workers of the previous one are stopped.
+  PredictorHandle treelite_model_ = nullptr;
+  int predictor_threads_ = 0;
+  std::string model_lib_path_;
+  int num_threads_;
+  bool use_cpu_affinity_ = true;
   size_t treelite_num_feature_;
   // size of temporary buffer per instance
   size_t treelite_output_buffer_size_;
@@ -46,8 +77,27 @@ class DLR_DLL TreeliteModel : public DLRModel {
   size_t treelite_output_size_;
   std::unique_ptr<TreeliteInput> treelite_input_;
   std::vector<float, DLRAllocator<float>> treelite_output_;
+  bool zero_copy_input_ = false;
   void SetupTreeliteModule(const std::vector<std::string>& files);
   void UpdateInputShapes();
+  /*! \brief Assemble a dense or CSR batch, whichever is cheaper for the sampled sparsity. */
+  void AssembleBatch(TreeliteInput* treelite_input, const float* input, size_t num_row,
+                     size_t num_col, bool copy, bool parallel);
+  void AssembleDense(TreeliteInput* treelite_input, const float* input, size_t num_row,
+                     size_t num_col, bool copy);
+  void AssembleCSR(TreeliteInput* treelite_input, const float* input, size_t num_row,
+                   size_t num_col, bool parallel);
+  void SetInstanceInput(const float* input, size_t num_col);
+  TreeliteInput* PrepareInput();
+  struct StreamChunk;
+  /*! \brief Predict chunks filled by next_chunk until it returns false, assembling the next chunk
+   * on a helper thread while the current one is predicted. */
+  size_t PredictChunks(const std::function<bool(StreamChunk*)>& next_chunk, size_t num_col,
+                       size_t chunk_rows, const TreeliteStreamWriter& writer);
+  /*! \brief Load the predictor with the given number of threads, unless it already is. */
+  void LoadPredictor(int threads);
+  void FreePredictor();
+  void Predict(PredictorHandle predictor);
 
  public:
   /*! \brief Load model files from given folder path.
@@ -56,6 +106,7 @@ class DLR_DLL TreeliteModel : public DLRModel {
       : DLRModel(ctx, DLRBackend::kTREELITE) {
     SetupTreeliteModule(files);
   }
+  ~TreeliteModel();
 
   virtual const int GetInputDim(int index) const override;
   virtual const int64_t GetInputSize(int index) const override;
@@ -64,6 +115,10 @@ class DLR_DLL TreeliteModel : public DLRModel {
   virtual void GetInput(const char* name, void* input) override;
   virtual void SetInput(const char* name, const int64_t* shape, const void* input,
                         int dim) override;
+  /*! \brief Use caller CSR arrays as input without copying. They must stay valid until Run
+   * returns. */
+  virtual void SetSparseInput(const float* data, const uint32_t* col_ind, const size_t* row_ptr,
+                              size_t num_row, size_t num_col) override;
 
   virtual void GetOutput(int index, void* out) override;
   virtual const void* GetOutputPtr(int index) const override;
@@ -75,8 +130,38 @@ class DLR_DLL TreeliteModel : public DLRModel {
   virtual std::vector<std::string> GetWeightNames() const override;
 
   virtual void Run() override;
+  /*! \brief Run with a thread count for this call only, e.g. fewer threads for online requests
+   * and more for batch scoring. A thread count other than the last one used reloads the
+   * predictor, and the next Run() reloads it again with the configured count.
+   */
+  void Run(int threads);
+  /*! \brief Set the number of Treelite worker threads used by Run. */
   virtual void SetNumThreads(int threads) override;
+  /*! \brief Treelite pins its workers and the loading thread to cores when it loads a model.
+   * When disabled, predictors are loaded with TREELITE_BIND_THREADS=0, so that no thread is pinned
+   * and they share cores with other runtimes. Changing it reloads the predictor.
+   */
   virtual void UseCPUAffinity(bool use) override;
+
+  /*! \brief Score a stream of rows in chunks of at most chunk_rows rows, without holding the
+   * whole batch in memory. Rows have num_col float values with missing values as NaN. The next
+   * chunk is read and assembled on a helper thread while the current one is predicted, so reader
+   * runs on that thread and at most two chunks are held at a time. writer is called on the
+   * calling thread in row order. Does not change the input or output of the model.
+   * Returns the number of rows scored.
+   */
+  size_t PredictStream(const TreeliteStreamReader& reader, size_t num_col, size_t chunk_rows,
+                       const TreeliteStreamWriter& writer);
+  /*! \brief Like PredictStream, reading rows from a file of row-major float32 values. The file
+   * is memory mapped where supported and chunks are assembled directly from the mapping.
+   */
+  size_t PredictFile(const std::string& path, size_t num_col, size_t chunk_rows,
+                     const TreeliteStreamWriter& writer);
+
+  /*! \brief When enabled, dense inputs are passed to Treelite without copying them. The buffer
+   * given to SetInput must then stay valid and unmodified until Run returns.
+   */
+  void SetZeroCopyInput(bool enable) { zero_copy_input_ = enable; }
 };
 
 }  // namespace dlr
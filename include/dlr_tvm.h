@@ -6,6 +6,8 @@
 #include <tvm/runtime/registry.h>
 
 #include "dlr_common.h"
+#include "dlr_data_transform.h"
+#include "dlr_thread_pool.h"
 
 #if defined(_MSC_VER) || defined(_WIN32)
 #define DLR_DLL __declspec(dllexport)
@@ -23,10 +25,21 @@ class DLR_DLL TVMModel : public DLRModel {
   std::shared_ptr<tvm::runtime::Module> tvm_module_;
   std::vector<const DLTensor*> outputs_;
   std::vector<std::string> output_types_;
+  /*! \brief Output names from metadata, compiled at load with their indices so that lookups by
+   * index or name do not walk the metadata JSON. Empty without metadata. */
+  std::vector<std::string> output_names_;
+  std::unordered_map<std::string, int> output_indices_;
+  /*! \brief Graph runtime index of each input name. */
+  std::unordered_map<std::string, int> input_indices_;
   std::vector<std::string> weight_names_;
+  TVMThreadPoolConfig thread_pool_config_;
+  DataTransform data_transform_;
   void SetupTVMModule(const std::vector<std::string>& files);
   void SetupTVMModule(const std::vector<DLRModelElem>& model_elems);
   void UpdateInputShapes();
+  void FetchOutputNames();
+  /*! \brief Graph runtime index of an input or weight, -1 if there is none. */
+  int GetInputIndex(const char* name) const;
 
  public:
   /*! \brief Load model files from given folder path.
@@ -48,8 +61,14 @@ class DLR_DLL TVMModel : public DLRModel {
   virtual void SetInput(const char* name, const int64_t* shape, const void* input,
                         int dim) override;
   void SetInputTensor(const char* name, DLTensor* tensor);
+  virtual void SetInputBatch(const char* name, const void** samples, int n) override;
+  virtual void SetImageInput(const char* name, const ImageView* images, int64_t n) override;
+  virtual void SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                           int64_t num_boxes) override;
+  virtual int GetImageInputIndex() const override;
 
   virtual void GetOutput(int index, void* out) override;
+  virtual void GetOutputBatch(int index, void** dests, int n) override;
   void GetOutputManagedTensorPtr(int index, const DLManagedTensor** out);
   virtual const void* GetOutputPtr(int index) const override;
   virtual void GetOutputShape(int index, int64_t* shape) const override;
@@ -0,0 +1,62 @@
+#ifndef DLR_VM_MEMORY_POOL_H_
+#define DLR_VM_MEMORY_POOL_H_
+
+#include <tvm/runtime/vm/memory_manager.h>
+
+#include <map>
+#include <mutex>
+
+#include "dlr_common.h"
+
+namespace dlr {
+
+/*! \brief Pooled allocator of VM storage for one model and device.
+ *
+ * Works like TVM's PooledAllocator: sizes are rounded up to whole pages and freed blocks are kept
+ * for reuse by later requests of the same rounded size. Unlike the process-wide TVM pools, each
+ * model owns its pools, which report their idle blocks and release them down to a watermark
+ * without touching the memory of other models.
+ *
+ * VM storage keeps a raw pointer to its allocator and outputs may outlive the model, so the model
+ * calls Detach instead of deleting a pool. The pool deletes itself once its last block is freed.
+ */
+class DLR_DLL VMMemoryPool final : public tvm::runtime::vm::Allocator {
+ public:
+  static constexpr size_t kPageSize = 4096;
+
+  explicit VMMemoryPool(DLContext ctx)
+      : tvm::runtime::vm::Allocator(tvm::runtime::vm::kPooled), ctx_(ctx) {}
+
+  tvm::runtime::vm::Buffer Alloc(size_t nbytes, size_t alignment, DLDataType type_hint) override;
+  void Free(const tvm::runtime::vm::Buffer& buffer) override;
+  /*! \brief Bytes held by the pool, in use or idle. */
+  size_t UsedMemory() const override;
+
+  DLContext GetContext() const { return ctx_; }
+  /*! \brief Bytes of idle blocks kept for reuse. */
+  size_t GetIdleBytes() const;
+  /*! \brief Release idle blocks, largest first, until at most watermark_bytes of them remain.
+   * Returns the number of bytes released.
+   */
+  size_t TrimIdle(size_t watermark_bytes);
+  /*! \brief Release all idle blocks and delete the pool once no block is in use. The pool must not
+   * be used by the caller afterwards.
+   */
+  void Detach();
+
+ private:
+  ~VMMemoryPool() override = default;
+
+  const DLContext ctx_;
+  mutable std::mutex mutex_;
+  /*! \brief Idle blocks by rounded size. */
+  std::multimap<size_t, void*> idle_;
+  size_t idle_bytes_ = 0;
+  size_t used_bytes_ = 0;
+  size_t num_in_use_ = 0;
+  bool detached_ = false;
+};
+
+}  // namespace dlr
+
+#endif  // DLR_VM_MEMORY_POOL_H_
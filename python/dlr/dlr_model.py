@@ -303,9 +303,12 @@ class DLRModelImpl(IDLRModel):
         input_dtype = self._get_input_or_weight_dtype_by_name(name)
         if input_dtype == "json":
             # Special case for DataTransformed inputs. DLR will expect input as a serialized json
-            # string.
-            in_data = json.dumps(data.tolist())
-            in_data_pointer = c_char_p(in_data.encode('utf-8'))
+            # string, or as bytes in the binary columnar format (see ColumnarInput).
+            if isinstance(data, (bytes, bytearray)):
+                in_data = bytes(data)
+            else:
+                in_data = json.dumps(data.tolist()).encode('utf-8')
+            in_data_pointer = c_char_p(in_data)
             shape = np.array([len(in_data)], dtype=np.int64)
         else:
             # float32 inputs can accept any data (backward compatibility).
@@ -325,7 +328,7 @@ class DLRModelImpl(IDLRModel):
                                      shape.ctypes.data_as(POINTER(c_longlong)),
                                      in_data_pointer,
                                      c_int(len(shape))))
-        if self.backend == 'treelite':
+        if self.backend in ('treelite', 'gbdt'):
             self._lazy_init_output_shape()
 
     def _run(self):
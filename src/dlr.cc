@@ -1,6 +1,8 @@
 #include "dlr.h"
 
 #include "dlr_common.h"
+#include "dlr_gbdt.h"
+#include "dlr_image_transform.h"
 #include "dlr_pipeline.h"
 #include "dlr_relayvm.h"
 #include "dlr_treelite.h"
@@ -104,6 +106,83 @@ extern "C" int SetDLRInputTensor(DLRModelHandle* handle, const char* name, void*
   API_END();
 }
 
+extern "C" int SetDLRInputBatch(DLRModelHandle* handle, const char* name, const void** samples,
+                                int n) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  model->SetInputBatch(name, samples, n);
+  API_END();
+}
+
+namespace {
+
+ImageView ToImageView(const DLRImage& image) {
+  ImageView view;
+  switch (image.format) {
+    case DLR_IMAGE_RGB:
+      view.format = ImageView::Format::kPacked;
+      break;
+    case DLR_IMAGE_BGR:
+      view.format = ImageView::Format::kBGR;
+      break;
+    case DLR_IMAGE_NV12:
+      view.format = ImageView::Format::kNV12;
+      break;
+    case DLR_IMAGE_NV21:
+      view.format = ImageView::Format::kNV21;
+      break;
+    case DLR_IMAGE_I420:
+      view.format = ImageView::Format::kI420;
+      break;
+    default:
+      throw dmlc::Error("Unsupported image format: " + std::to_string(image.format));
+  }
+  view.width = image.width;
+  view.height = image.height;
+  for (int p = 0; p < 3; ++p) {
+    view.planes[p] = image.planes[p];
+    view.strides[p] = image.strides[p];
+  }
+  view.crop_x = image.crop_x;
+  view.crop_y = image.crop_y;
+  view.crop_width = image.crop_width;
+  view.crop_height = image.crop_height;
+  return view;
+}
+
+}  // namespace
+
+extern "C" int SetDLRImageInput(DLRModelHandle* handle, const char* name, const DLRImage* images,
+                                int n) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  CHECK_GT(n, 0) << "Number of images must be positive.";
+  std::vector<ImageView> views;
+  for (int i = 0; i < n; ++i) views.push_back(ToImageView(images[i]));
+  model->SetImageInput(name, views.data(), n);
+  API_END();
+}
+
+extern "C" int SetDLRROIInput(DLRModelHandle* handle, const char* name, const DLRImage* frame,
+                              const float* boxes, int num_boxes) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  model->SetROIInput(name, ToImageView(*frame), boxes, num_boxes);
+  API_END();
+}
+
+extern "C" int SetDLRSparseInput(DLRModelHandle* handle, const float* data, const uint32_t* col_ind,
+                                 const size_t* row_ptr, size_t num_row, size_t num_col) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  model->SetSparseInput(data, col_ind, row_ptr, num_row, num_col);
+  API_END();
+}
+
 extern "C" int GetDLRInput(DLRModelHandle* handle, const char* name, void* input) {
   API_BEGIN();
   DLRModel* model = static_cast<DLRModel*>(*handle);
@@ -120,6 +199,14 @@ extern "C" int GetDLROutput(DLRModelHandle* handle, int index, void* out) {
   API_END();
 }
 
+extern "C" int GetDLROutputBatch(DLRModelHandle* handle, int index, void** dests, int n) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  model->GetOutputBatch(index, dests, n);
+  API_END();
+}
+
 extern "C" int GetDLROutputPtr(DLRModelHandle* handle, int index, const void** out) {
   API_BEGIN();
   DLRModel* model = static_cast<DLRModel*>(*handle);
@@ -128,6 +215,25 @@ extern "C" int GetDLROutputPtr(DLRModelHandle* handle, int index, const void** o
   API_END();
 }
 
+extern "C" int SetDLROutputPostprocess(DLRModelHandle* handle, int index, int top_k,
+                                       int softmax) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  CHECK_GE(top_k, 0) << "top_k must not be negative.";
+  model->SetOutputPostprocess(index, top_k > 0 ? Postprocess(top_k, softmax != 0) : Postprocess());
+  API_END();
+}
+
+extern "C" int GetDLROutputClassScores(DLRModelHandle* handle, int index, DLRClassScore* scores,
+                                       int64_t capacity, int64_t* num_scores) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  model->GetOutputClassScores(index, scores, capacity, num_scores);
+  API_END();
+}
+
 extern "C" int GetDLROutputTensor(DLRModelHandle* handle, int index, void* tensor) {
   API_BEGIN();
   DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
@@ -256,6 +362,8 @@ DLRModelPtr CreateDLRModelPtr(const char* model_path, DLContext& ctx) {
     return std::make_shared<RelayVMModel>(files, ctx);
   } else if (backend == DLRBackend::kTREELITE) {
     return std::make_shared<TreeliteModel>(files, ctx);
+  } else if (backend == DLRBackend::kGBDT) {
+    return std::make_shared<GBDTModel>(files, ctx);
 #ifdef DLR_HEXAGON
   } else if (backend == DLRBackend::kHEXAGON) {
     return std::make_shared<HexagonModel>(files, ctx, 1 /*debug_level*/);
@@ -307,6 +415,8 @@ extern "C" int CreateDLRModel(DLRModelHandle* handle, const char* model_path, in
       model = new RelayVMModel(files, ctx);
     } else if (backend == DLRBackend::kTREELITE) {
       model = new TreeliteModel(files, ctx);
+    } else if (backend == DLRBackend::kGBDT) {
+      model = new GBDTModel(files, ctx);
 #ifdef DLR_HEXAGON
     } else if (backend == DLRBackend::kHEXAGON) {
       model = new HexagonModel(files, ctx, 1 /*debug_level*/);
@@ -392,6 +502,59 @@ extern "C" int RunDLRModel(DLRModelHandle* handle) {
   API_END();
 }
 
+extern "C" int RunDLRModelWithNumThreads(DLRModelHandle* handle, int threads) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTREELITE)
+      << "model is not a TreeliteModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'treelite'";
+  static_cast<TreeliteModel*>(dlr_model)->Run(threads);
+  API_END();
+}
+
+extern "C" int PredictDLRStream(DLRModelHandle* handle, DLRReadRowsFunctionPtr read_fn,
+                                void* read_ctx, size_t num_col, size_t chunk_rows,
+                                DLRWriteOutputFunctionPtr write_fn, void* write_ctx,
+                                size_t* num_rows) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTREELITE)
+      << "model is not a TreeliteModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'treelite'";
+  CHECK(read_fn != nullptr && write_fn != nullptr) << "read_fn and write_fn must not be null.";
+  const size_t n = static_cast<TreeliteModel*>(dlr_model)->PredictStream(
+      [&](float* buffer, size_t max_rows) { return read_fn(read_ctx, buffer, max_rows); },
+      num_col, chunk_rows,
+      [&](const float* out, size_t num_row, size_t row_size) {
+        write_fn(write_ctx, out, num_row, row_size);
+      });
+  if (num_rows != nullptr) *num_rows = n;
+  API_END();
+}
+
+extern "C" int PredictDLRFile(DLRModelHandle* handle, const char* path, size_t num_col,
+                              size_t chunk_rows, DLRWriteOutputFunctionPtr write_fn,
+                              void* write_ctx, size_t* num_rows) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTREELITE)
+      << "model is not a TreeliteModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'treelite'";
+  CHECK(path != nullptr && write_fn != nullptr) << "path and write_fn must not be null.";
+  const size_t n = static_cast<TreeliteModel*>(dlr_model)->PredictFile(
+      path, num_col, chunk_rows, [&](const float* out, size_t num_row, size_t row_size) {
+        write_fn(write_ctx, out, num_row, row_size);
+      });
+  if (num_rows != nullptr) *num_rows = n;
+  API_END();
+}
+
 extern "C" const char* DLRGetLastError() { return TVMGetLastError(); }
 
 extern "C" int GetDLRBackend(DLRModelHandle* handle, const char** name) {
@@ -437,6 +600,104 @@ extern "C" int UseDLRCPUAffinity(DLRModelHandle* handle, int use) {
   API_END();
 }
 
+extern "C" int WarmupDLRModel(DLRModelHandle* handle, int num_shape_sets, const int64_t** shapes,
+                              const int* dims, int64_t* pool_bytes) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kRELAYVM)
+      << "model is not a RelayVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'relayvm'";
+  CHECK_GE(num_shape_sets, 0) << "num_shape_sets must not be negative";
+  const int num_inputs = dlr_model->GetNumInputs();
+  std::vector<std::vector<std::vector<int64_t>>> shape_sets(num_shape_sets);
+  for (int s = 0; s < num_shape_sets; s++) {
+    for (int i = 0; i < num_inputs; i++) {
+      const int64_t* shape = shapes[s * num_inputs + i];
+      shape_sets[s].emplace_back(shape, shape + dims[s * num_inputs + i]);
+    }
+  }
+  int64_t bytes = static_cast<RelayVMModel*>(dlr_model)->Warmup(shape_sets);
+  if (pool_bytes != nullptr) {
+    *pool_bytes = bytes;
+  }
+  API_END();
+}
+
+extern "C" int GetDLRMemoryStats(DLRModelHandle* handle, DLRMemoryStats* stats, int max_stats,
+                                 int* num_stats) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kRELAYVM)
+      << "model is not a RelayVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'relayvm'";
+  std::vector<DLRMemoryStats> model_stats =
+      static_cast<RelayVMModel*>(dlr_model)->GetMemoryStats();
+  *num_stats = static_cast<int>(model_stats.size());
+  for (int i = 0; i < max_stats && i < *num_stats; i++) {
+    stats[i] = model_stats[i];
+  }
+  API_END();
+}
+
+extern "C" int TrimDLRModelMemory(DLRModelHandle* handle, int64_t watermark_bytes) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kRELAYVM)
+      << "model is not a RelayVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'relayvm'";
+  static_cast<RelayVMModel*>(dlr_model)->TrimMemory(watermark_bytes);
+  API_END();
+}
+
+extern "C" int SetDLRZeroCopyInput(DLRModelHandle* handle, int enable) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kRELAYVM || backend == DLRBackend::kTREELITE)
+      << "model is not a RelayVMModel or TreeliteModel. Found '"
+      << kBackendToStr[static_cast<int>(backend)] << "' but expected 'relayvm' or 'treelite'";
+  if (backend == DLRBackend::kRELAYVM) {
+    static_cast<RelayVMModel*>(dlr_model)->SetZeroCopyInput(enable != 0);
+  } else {
+    static_cast<TreeliteModel*>(dlr_model)->SetZeroCopyInput(enable != 0);
+  }
+  API_END();
+}
+
+extern "C" int SetDLRInputArenaMaxBuckets(DLRModelHandle* handle, int max_buckets) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kRELAYVM)
+      << "model is not a RelayVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'relayvm'";
+  CHECK_GE(max_buckets, 0) << "max_buckets must not be negative";
+  static_cast<RelayVMModel*>(dlr_model)->SetInputArenaMaxBuckets(max_buckets);
+  API_END();
+}
+
+extern "C" int GetDLRInputArenaStats(DLRModelHandle* handle, int64_t* hits, int64_t* misses) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kRELAYVM)
+      << "model is not a RelayVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'relayvm'";
+  NDArrayArenaStats stats = static_cast<RelayVMModel*>(dlr_model)->GetInputArenaStats();
+  *hits = static_cast<int64_t>(stats.hits);
+  *misses = static_cast<int64_t>(stats.misses);
+  API_END();
+}
+
 extern "C" int SetDLRCustomAllocatorMalloc(DLRMallocFunctionPtr custom_malloc_fn) {
   API_BEGIN();
   DLRAllocatorFunctions::SetMallocFunction(custom_malloc_fn);
@@ -2,12 +2,34 @@
 
 #include <dmlc/filesystem.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <fstream>
 #include <locale>
 
 using namespace dlr;
 
-const char* dlr::kBackendToStr[] = {"tvm", "treelite", "hexagon", "relayvm", "pipeline", "unknown"};
+const char* dlr::kBackendToStr[] = {"tvm",      "treelite", "hexagon", "relayvm",
+                                     "pipeline", "gbdt",     "unknown"};
+
+namespace {
+
+/*! \brief Whether a JSON file is an XGBoost JSON model or a LightGBM JSON dump. Only the beginning
+ * of the file is read, where both formats have their identifying keys.
+ */
+bool IsGBDTModelJson(const std::string& path) {
+  std::ifstream file(path);
+  char buffer[4096];
+  file.read(buffer, sizeof(buffer));
+  std::string head(buffer, static_cast<size_t>(file.gcount()));
+  head.erase(std::remove_if(head.begin(), head.end(), [](char c) { return std::isspace(c); }),
+             head.end());
+  return head.find("\"learner\":") != std::string::npos ||
+         head.find("\"name\":\"tree\"") != std::string::npos;
+}
+
+}  // namespace
 
 bool dlr::IsFileEmpty(const std::string& filePath) {
   std::ifstream pFile(filePath);
@@ -128,6 +150,11 @@ DLRBackend dlr::GetBackend(const std::vector<std::string>& files) {
     }
   }
   if (has_tvm_lib) return DLRBackend::kTREELITE;
+  for (auto filename : files) {
+    if (EndsWith(filename, ".json") && IsGBDTModelJson(filename)) {
+      return DLRBackend::kGBDT;
+    }
+  }
   return DLRBackend::kUNKNOWN;
 }
 
@@ -209,6 +236,57 @@ const std::vector<int64_t>& DLRModel::GetInputShape(int index) const {
 
 bool DLRModel::HasMetadata() const { return !this->metadata_.is_null(); }
 
+const Postprocess& DLRModel::GetOutputPostprocess(int index) {
+  auto it = postprocesses_.find(index);
+  if (it != postprocesses_.end()) return it->second;
+  Postprocess postprocess;
+  const std::string index_str = std::to_string(index);
+  if (HasMetadata() && metadata_.count("DataTransform") &&
+      metadata_.at("DataTransform").count("Output") &&
+      metadata_.at("DataTransform").at("Output").count(index_str) &&
+      metadata_.at("DataTransform").at("Output").at(index_str).count("Postprocess")) {
+    postprocess =
+        Postprocess(metadata_.at("DataTransform").at("Output").at(index_str).at("Postprocess"));
+  }
+  return postprocesses_.emplace(index, postprocess).first->second;
+}
+
+void DLRModel::SetOutputPostprocess(int index, const Postprocess& postprocess) {
+  CHECK(index >= 0 && index < GetNumOutputs()) << "Output index is out of range.";
+  postprocesses_[index] = postprocess;
+}
+
+void DLRModel::GetOutputClassScores(int index, DLRClassScore* results, int64_t capacity,
+                                    int64_t* num_results) {
+  CHECK(index >= 0 && index < GetNumOutputs()) << "Output index is out of range.";
+  const Postprocess& postprocess = GetOutputPostprocess(index);
+  CHECK(postprocess.Enabled()) << "Output " << index << " has no post-processing configured.";
+  CHECK_EQ(strcmp(GetOutputType(index), "float32"), 0)
+      << "Output post-processing is only supported for float32 outputs.";
+  int64_t size = 0;
+  int dim = 0;
+  GetOutputSizeDim(index, &size, &dim);
+  // Dynamic sizes are only known once Run has produced the output.
+  CHECK_GE(size, 0) << "Output " << index << " is not available before Run.";
+  CHECK_GT(dim, 0) << "Output post-processing needs classes in the last output dimension.";
+  std::vector<int64_t> shape(dim);
+  GetOutputShape(index, shape.data());
+  const int64_t num_classes = shape.back();
+  const int64_t num_rows = num_classes > 0 ? size / num_classes : 0;
+  *num_results = num_rows * postprocess.GetNumResults(num_classes);
+  CHECK_LE(*num_results, capacity) << "Output post-processing needs room for " << *num_results
+                                   << " results.";
+  if (ctx_.device_type == kDLCPU) {
+    postprocess.Apply(static_cast<const float*>(GetOutputPtr(index)), num_rows, num_classes,
+                      results);
+    return;
+  }
+  // Outputs of other devices are copied to CPU memory first.
+  std::vector<float> logits(size);
+  GetOutput(index, logits.data());
+  postprocess.Apply(logits.data(), num_rows, num_classes, results);
+}
+
 void DLRModel::ValidateDeviceTypeIfExists() {
   DLDeviceType device_type;
   try {
@@ -306,6 +384,37 @@ bool dlr::HasNegative(const int64_t* arr, const size_t size) {
   return std::any_of(arr, arr + size, [](int64_t x) { return x < 0; });
 }
 
+std::unordered_map<std::string, int> dlr::MakeIndexMap(const std::vector<std::string>& names) {
+  std::unordered_map<std::string, int> indices;
+  for (size_t i = 0; i < names.size(); ++i) indices.emplace(names[i], static_cast<int>(i));
+  return indices;
+}
+
+int dlr::FindIndex(const std::unordered_map<std::string, int>& indices, const char* name) {
+  static thread_local std::string key;
+  key.assign(name);
+  auto it = indices.find(key);
+  return it != indices.end() ? it->second : -1;
+}
+
+void dlr::GatherBatch(const void** samples, int n, size_t sample_bytes, void* batch) {
+  CHECK(samples != nullptr) << "samples is nullptr";
+  char* dst = static_cast<char*>(batch);
+  for (int i = 0; i < n; i++) {
+    CHECK(samples[i] != nullptr) << "Sample " << i << " is nullptr";
+    std::memcpy(dst + i * sample_bytes, samples[i], sample_bytes);
+  }
+}
+
+void dlr::ScatterBatch(const void* batch, int n, size_t sample_bytes, void** dests) {
+  CHECK(dests != nullptr) << "dests is nullptr";
+  const char* src = static_cast<const char*>(batch);
+  for (int i = 0; i < n; i++) {
+    CHECK(dests[i] != nullptr) << "Destination " << i << " is nullptr";
+    std::memcpy(dests[i], src + i * sample_bytes, sample_bytes);
+  }
+}
+
 std::vector<std::string> dlr::MakePathVec(std::string model_path) {
   std::vector<std::string> path_vec;
   int start = 0;
@@ -1,7 +1,396 @@
 #include "dlr_data_transform.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "dlr_thread_pool.h"
+
 using namespace dlr;
 
+namespace {
+
+/*! \brief Rows per task when transforming inputs in parallel. */
+constexpr size_t kRowsPerTask = 256;
+
+/*! \brief Powers of ten that are exact in double. */
+constexpr double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+constexpr char kColumnarMagic[4] = {'D', 'L', 'R', 'C'};
+constexpr uint32_t kColumnarVersion = 1;
+
+uint32_t ReadUInt32(const char* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/*! \brief Convert numeric column values [begin, end) to float, writing every stride floats. */
+template <typename T>
+void CopyNumbers(const char* values, size_t begin, size_t end, size_t stride, float* out) {
+  for (size_t r = begin; r < end; ++r) {
+    T value;
+    std::memcpy(&value, values + r * sizeof(T), sizeof(T));
+    out[r * stride] = static_cast<float>(value);
+  }
+}
+
+/*! \brief Map rows [begin, end) of every column, see MapColumns. */
+template <typename Lookup>
+void MapColumnBlock(const ColumnarInput& input, Lookup lookup, bool pass_numbers,
+                    float missing_value, const std::vector<std::vector<float>>& dict_values,
+                    size_t begin, size_t end, float* data) {
+  const size_t num_cols = input.num_cols();
+  for (size_t c = 0; c < num_cols; ++c) {
+    const ColumnarInput::Column& column = input.column(c);
+    float* out = data + c;
+    if (column.type == ColumnarInput::kString) {
+      for (size_t r = begin; r < end; ++r) {
+        const char* str;
+        size_t length;
+        ColumnarInput::GetString(column, r, &str, &length);
+        out[r * num_cols] = lookup(c, str, length);
+      }
+    } else if (column.type == ColumnarInput::kDictionary) {
+      for (size_t r = begin; r < end; ++r) {
+        const uint32_t code = ColumnarInput::GetCode(column, r);
+        out[r * num_cols] =
+            code == ColumnarInput::kNullCode ? missing_value : dict_values[c][code];
+      }
+    } else if (!pass_numbers) {
+      for (size_t r = begin; r < end; ++r) out[r * num_cols] = missing_value;
+    } else if (column.type == ColumnarInput::kFloat32) {
+      CopyNumbers<float>(column.data, begin, end, num_cols, out);
+    } else if (column.type == ColumnarInput::kFloat64) {
+      CopyNumbers<double>(column.data, begin, end, num_cols, out);
+    } else if (column.type == ColumnarInput::kInt32) {
+      CopyNumbers<int32_t>(column.data, begin, end, num_cols, out);
+    } else {
+      CopyNumbers<int64_t>(column.data, begin, end, num_cols, out);
+    }
+  }
+}
+
+/*! \brief Fill the [num_rows, num_cols] float array data from columnar input. Strings are mapped
+ * with lookup(column index, str, length), which is called once per dictionary entry for
+ * dictionary columns. Numeric columns are converted if pass_numbers is set. Null dictionary
+ * codes, and numeric columns otherwise, get missing_value.
+ */
+template <typename Lookup>
+void MapColumns(const ColumnarInput& input, Lookup lookup, bool pass_numbers, float missing_value,
+                float* data) {
+  const size_t num_cols = input.num_cols();
+  std::vector<std::vector<float>> dict_values(num_cols);
+  for (size_t c = 0; c < num_cols; ++c) {
+    const ColumnarInput::Column& column = input.column(c);
+    if (column.type != ColumnarInput::kDictionary) continue;
+    dict_values[c].resize(column.dict_size);
+    for (uint32_t k = 0; k < column.dict_size; ++k) {
+      const char* str;
+      size_t length;
+      ColumnarInput::GetString(column, k, &str, &length);
+      dict_values[c][k] = lookup(c, str, length);
+    }
+  }
+  dlr::ParallelFor(input.num_rows(), kRowsPerTask, [&](size_t task_begin, size_t task_end) {
+    // Column by column within blocks of rows, so the rows being written stay in cache.
+    for (size_t begin = task_begin; begin < task_end; begin += kRowsPerTask) {
+      const size_t end = std::min(begin + kRowsPerTask, task_end);
+      MapColumnBlock(input, lookup, pass_numbers, missing_value, dict_values, begin, end, data);
+    }
+  });
+}
+
+template <typename T>
+float ReadNumber(const char* values, size_t r) {
+  T value;
+  std::memcpy(&value, values + r * sizeof(T), sizeof(T));
+  return static_cast<float>(value);
+}
+
+/*! \brief Row r of a numeric column as float. */
+float GetNumber(const ColumnarInput::Column& column, size_t r) {
+  switch (column.type) {
+    case ColumnarInput::kFloat32:
+      return ReadNumber<float>(column.data, r);
+    case ColumnarInput::kFloat64:
+      return ReadNumber<double>(column.data, r);
+    case ColumnarInput::kInt32:
+      return ReadNumber<int32_t>(column.data, r);
+    default:
+      return ReadNumber<int64_t>(column.data, r);
+  }
+}
+
+/*! \brief Values of key in transform, which must be an array with one number per column. */
+std::vector<float> GetColumnValues(const nlohmann::json& transform, const char* key,
+                                   size_t num_cols) {
+  const nlohmann::json& values = transform.at(key);
+  CHECK(values.is_array() && values.size() == num_cols)
+      << key << " must have one value per input column, input has " << num_cols << " columns.";
+  std::vector<float> out(num_cols);
+  for (size_t c = 0; c < num_cols; ++c) out[c] = values[c].get<float>();
+  return out;
+}
+
+/*! \brief Same as GetColumnValues, with default_value for every column if key is absent. */
+std::vector<float> GetColumnValues(const nlohmann::json& transform, const char* key,
+                                   size_t num_cols, float default_value) {
+  if (!transform.count(key)) return std::vector<float>(num_cols, default_value);
+  return GetColumnValues(transform, key, num_cols);
+}
+
+/*! \brief Table key of a numeric category: a NUL byte and the bits of the value, so that numbers
+ * are matched exactly and never match strings. */
+constexpr size_t kNumericKeySize = 1 + sizeof(float);
+
+void MakeNumericKey(float value, char* key) {
+  // -0 and 0 are the same category.
+  if (value == 0.0f) value = 0.0f;
+  key[0] = '\0';
+  std::memcpy(key + 1, &value, sizeof(value));
+}
+
+float FindNumber(const CategoricalStringTable& table, float value) {
+  char key[kNumericKeySize];
+  MakeNumericKey(value, key);
+  return table.Find(key, sizeof(key));
+}
+
+/*! \brief Parameters of a Hashing transform, and the hashed names of numeric features. */
+struct HashingParams {
+  size_t num_features;
+  bool alternate_sign;
+  /*! \brief "name=" per column, empty without Names. */
+  std::vector<std::string> prefixes;
+  /*! \brief Output index and sign of the number feature of each column. */
+  std::vector<size_t> number_index;
+  std::vector<float> number_sign;
+};
+
+/*! \brief Output index and sign of a feature name, as in sklearn FeatureHasher. */
+void HashFeature(const HashingParams& params, const char* name, size_t length, size_t* index,
+                 float* sign) {
+  const int32_t h = MurmurHash3(name, length);
+  const size_t n = params.num_features;
+  // abs(INT32_MIN) overflows, sklearn gives it the index abs would give with 64-bit integers.
+  *index = h == std::numeric_limits<int32_t>::min() ? (2147483647 - (n - 1)) % n
+                                                     : static_cast<size_t>(std::abs(h)) % n;
+  *sign = params.alternate_sign && h < 0 ? -1.0f : 1.0f;
+}
+
+HashingParams GetHashingParams(const nlohmann::json& transform, size_t num_cols) {
+  HashingParams params;
+  params.num_features = transform.at("NumFeatures").get<int64_t>();
+  params.alternate_sign = transform.value("AlternateSign", true);
+  std::vector<std::string> names(num_cols);
+  if (transform.count("Names")) {
+    const nlohmann::json& json_names = transform["Names"];
+    CHECK(json_names.is_array() && json_names.size() == num_cols)
+        << "Names must have one name per input column, input has " << num_cols << " columns.";
+    for (size_t c = 0; c < num_cols; ++c) {
+      names[c] = json_names[c].get<std::string>();
+      params.prefixes.push_back(names[c] + "=");
+    }
+  } else {
+    for (size_t c = 0; c < num_cols; ++c) names[c] = std::to_string(c);
+  }
+  params.number_index.resize(num_cols);
+  params.number_sign.resize(num_cols);
+  for (size_t c = 0; c < num_cols; ++c) {
+    HashFeature(params, names[c].data(), names[c].size(), &params.number_index[c],
+                &params.number_sign[c]);
+  }
+  return params;
+}
+
+/*! \brief Add the feature of string value str of column c to the output row. buffer is scratch
+ * space for the feature name. */
+void AddStringFeature(const HashingParams& params, size_t c, const char* str, size_t length,
+                      std::string* buffer, float* row) {
+  size_t index;
+  float sign;
+  if (params.prefixes.empty()) {
+    HashFeature(params, str, length, &index, &sign);
+  } else {
+    buffer->assign(params.prefixes[c]);
+    buffer->append(str, length);
+    HashFeature(params, buffer->data(), buffer->size(), &index, &sign);
+  }
+  row[index] += sign;
+}
+
+/*! \brief Add the feature of numeric value of column c to the output row. NaN is missing. */
+void AddNumberFeature(const HashingParams& params, size_t c, float value, float* row) {
+  if (std::isnan(value)) return;
+  row[params.number_index[c]] += params.number_sign[c] * value;
+}
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+/*! \brief Parse a plain decimal whose digits fit in a double and whose exponent has an exact power
+ * of ten, so that one multiplication or division gives the correctly rounded double. Returns false
+ * for anything else.
+ */
+bool ParseDecimal(const char* p, float* out) {
+  const bool negative = *p == '-';
+  if (*p == '-' || *p == '+') ++p;
+  uint64_t mantissa = 0;
+  int num_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  for (; IsDigit(*p); ++p) {
+    has_digits = true;
+    if (mantissa == 0 && *p == '0') continue;
+    mantissa = mantissa * 10 + (*p - '0');
+    ++num_digits;
+  }
+  // Hexadecimal, such as "0x1A" or "0x1p3", is left to strtof.
+  if (*p == 'x' || *p == 'X') return false;
+  if (*p == '.') {
+    for (++p; IsDigit(*p); ++p) {
+      has_digits = true;
+      --exponent;
+      if (mantissa == 0 && *p == '0') continue;
+      mantissa = mantissa * 10 + (*p - '0');
+      ++num_digits;
+    }
+  }
+  if (!has_digits || num_digits > 15) return false;
+  if (*p == 'e' || *p == 'E') {
+    const char* q = p + 1;
+    const bool negative_exponent = *q == '-';
+    if (*q == '-' || *q == '+') ++q;
+    // Without digits the 'e' is not part of the number.
+    if (IsDigit(*q)) {
+      int value = 0;
+      for (; IsDigit(*q); ++q) {
+        if (value < 1000) value = value * 10 + (*q - '0');
+      }
+      exponent += negative_exponent ? -value : value;
+    }
+  }
+  if (mantissa == 0) {
+    *out = negative ? -0.0f : 0.0f;
+    return true;
+  }
+  if (exponent < -22 || exponent > 22) return false;
+  double value = static_cast<double>(mantissa);
+  value = exponent < 0 ? value / kPowersOfTen[-exponent] : value * kPowersOfTen[exponent];
+  // Rounding the correctly rounded double to float gives the correctly rounded float, unless the
+  // double is exactly halfway between two floats.
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x1fffffff) == 0x10000000) return false;
+  *out = static_cast<float>(negative ? -value : value);
+  return true;
+}
+
+}  // namespace
+
+bool dlr::ParseFloat(const char* str, float* out) {
+  const char* p = str;
+  while (std::isspace(static_cast<unsigned char>(*p))) ++p;
+  if (ParseDecimal(p, out)) return true;
+  char* end;
+  errno = 0;
+  const float value = std::strtof(p, &end);
+  if (end == p || errno == ERANGE) return false;
+  *out = value;
+  return true;
+}
+
+bool dlr::ParseFloat(const char* str, size_t length, float* out) {
+  char buffer[64];
+  if (length >= sizeof(buffer)) return ParseFloat(std::string(str, length).c_str(), out);
+  std::memcpy(buffer, str, length);
+  buffer[length] = '\0';
+  return ParseFloat(buffer, out);
+}
+
+bool ColumnarInput::IsColumnar(const void* data, size_t size) {
+  return size >= sizeof(kColumnarMagic) &&
+         std::memcmp(data, kColumnarMagic, sizeof(kColumnarMagic)) == 0;
+}
+
+ColumnarInput::ColumnarInput(const void* data, size_t size) {
+  const char* p = static_cast<const char*>(data);
+  const char* const end = p + size;
+  auto take = [&](size_t bytes) {
+    CHECK_LE(bytes, static_cast<size_t>(end - p)) << "Columnar input is truncated.";
+    const char* begin = p;
+    p += bytes;
+    return begin;
+  };
+  // Offsets must be ascending, the last one is the number of bytes that follow.
+  auto take_strings = [&](size_t count, Column* column) {
+    column->offsets = take((count + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < count; ++i) {
+      CHECK_LE(ReadUInt32(column->offsets + i * sizeof(uint32_t)),
+               ReadUInt32(column->offsets + (i + 1) * sizeof(uint32_t)))
+          << "Columnar input string offsets must be ascending.";
+    }
+    column->bytes = take(ReadUInt32(column->offsets + count * sizeof(uint32_t)));
+  };
+
+  CHECK(IsColumnar(data, size)) << "Columnar input must start with DLRC.";
+  take(sizeof(kColumnarMagic));
+  const uint32_t version = ReadUInt32(take(sizeof(uint32_t)));
+  CHECK_EQ(version, kColumnarVersion) << "Unsupported columnar input version " << version;
+  num_rows_ = ReadUInt32(take(sizeof(uint32_t)));
+  const uint32_t num_cols = ReadUInt32(take(sizeof(uint32_t)));
+  CHECK(num_rows_ > 0 && num_cols > 0) << "Columnar input must have rows and columns.";
+  columns_.resize(num_cols);
+  for (Column& column : columns_) {
+    column = Column{kFloat32, nullptr, nullptr, nullptr, 0};
+    const uint32_t type = ReadUInt32(take(sizeof(uint32_t)));
+    switch (type) {
+      case kFloat32:
+      case kInt32:
+        column.data = take(num_rows_ * 4);
+        break;
+      case kFloat64:
+      case kInt64:
+        column.data = take(num_rows_ * 8);
+        break;
+      case kString:
+        take_strings(num_rows_, &column);
+        break;
+      case kDictionary:
+        column.dict_size = ReadUInt32(take(sizeof(uint32_t)));
+        CHECK_NE(column.dict_size, kNullCode) << "Columnar input dictionary is too large.";
+        take_strings(column.dict_size, &column);
+        column.data = take(num_rows_ * sizeof(uint32_t));
+        for (size_t r = 0; r < num_rows_; ++r) {
+          const uint32_t code = GetCode(column, r);
+          CHECK(code < column.dict_size || code == kNullCode)
+              << "Columnar input dictionary code " << code << " is out of range.";
+        }
+        break;
+      default:
+        throw dmlc::Error("Unsupported columnar input column type: " + std::to_string(type));
+    }
+    column.type = static_cast<ColumnType>(type);
+  }
+  CHECK(p == end) << "Columnar input has " << (end - p) << " trailing bytes.";
+}
+
+void ColumnarInput::GetString(const Column& column, size_t index, const char** str,
+                              size_t* length) {
+  const uint32_t begin = ReadUInt32(column.offsets + index * sizeof(uint32_t));
+  *str = column.bytes + begin;
+  *length = ReadUInt32(column.offsets + (index + 1) * sizeof(uint32_t)) - begin;
+}
+
+uint32_t ColumnarInput::GetCode(const Column& column, size_t row) {
+  return ReadUInt32(column.data + row * sizeof(uint32_t));
+}
+
 bool DataTransform::HasInputTransform(const nlohmann::json& metadata) const {
   try {
     if (metadata.at("DataTransform").at("Input").count("ColumnTransform")) {
@@ -24,19 +413,129 @@ void DataTransform::TransformInput(const nlohmann::json& metadata, const int64_t
                                    const void* input, int dim,
                                    const std::vector<DLDataType>& dtypes, DLContext ctx,
                                    std::vector<tvm::runtime::NDArray>* tvm_inputs) const {
-  nlohmann::json input_json = GetAsJson(shape, input, dim);
-  const auto& transforms = metadata["DataTransform"]["Input"]["ColumnTransform"];
+  const auto& transforms = &metadata == compiled_metadata_
+                               ? *compiled_transforms_
+                               : metadata["DataTransform"]["Input"]["ColumnTransform"];
   CHECK_LE(tvm_inputs->size(), transforms.size());
+  if (dim == 1 && ColumnarInput::IsColumnar(input, shape[0])) {
+    ColumnarInput columnar(input, shape[0]);
+    for (int i = 0; i < tvm_inputs->size(); i++) {
+      MapInput(columnar, columnar.num_rows(), columnar.num_cols(), transforms, i, dtypes[i], ctx,
+               &tvm_inputs->at(i));
+    }
+    return;
+  }
+  nlohmann::json input_json = GetAsJson(shape, input, dim);
   for (int i = 0; i < tvm_inputs->size(); i++) {
-    tvm_inputs->at(i) = InitNDArray(input_json, dtypes[i], ctx);
+    MapInput(input_json, input_json.size(), input_json[0].size(), transforms, i, dtypes[i], ctx,
+             &tvm_inputs->at(i));
+  }
+}
+
+template <typename Input>
+void DataTransform::MapInput(const Input& input, int64_t num_rows, int64_t num_cols,
+                             const nlohmann::json& transforms, int i, DLDataType dtype,
+                             DLContext ctx, tvm::runtime::NDArray* input_array) const {
+  const bool compiled = compiled_transforms_ == &transforms;
+  const Transformer& transformer =
+      compiled ? *input_transformers_[i] : GetTransformer(transforms[i]);
+  *input_array =
+      InitNDArray(num_rows, transformer.GetNumOutputColumns(transforms[i], num_cols), dtype, ctx);
+  if (compiled && !input_tables_[i].empty()) {
+    transformer.MapToNDArray(input, input_tables_[i], *input_array);
+  } else {
+    transformer.MapToNDArray(input, transforms[i], *input_array);
+  }
+}
+
+void DataTransform::CompileInputTransform(const nlohmann::json& metadata) {
+  const auto& transforms = metadata.at("DataTransform").at("Input").at("ColumnTransform");
+  input_tables_.clear();
+  input_tables_.resize(transforms.size());
+  input_transformers_.resize(transforms.size());
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    input_transformers_[i] = &GetTransformer(transforms[i]);
+    input_tables_[i] = input_transformers_[i]->Compile(transforms[i]);
+  }
+  compiled_metadata_ = &metadata;
+  compiled_transforms_ = &transforms;
+}
+
+bool DataTransform::HasImageTransform(const nlohmann::json& metadata) const {
+  try {
+    return metadata.at("DataTransform").at("Input").count("Image") > 0;
+  } catch (nlohmann::json::exception& e) {
+    return false;
+  }
+}
+
+void DataTransform::CompileImageTransform(const nlohmann::json& metadata,
+                                          const std::vector<std::string>& input_names,
+                                          const std::vector<std::vector<int64_t>>& input_shapes) {
+  const auto& config = metadata.at("DataTransform").at("Input").at("Image");
+  CHECK(!input_names.empty()) << "Image transform requires a model input.";
+  const std::string name = config.value("InputName", input_names[0]);
+  auto it = std::find(input_names.begin(), input_names.end(), name);
+  CHECK(it != input_names.end()) << "Image transform input " << name << " is not a model input.";
+  image_input_index_ = it - input_names.begin();
+  image_transform_ =
+      std::make_shared<ImageTransform>(config, name, input_shapes[image_input_index_]);
+}
+
+std::vector<int64_t> DataTransform::GetImageShape(const int64_t* shape, int dim) const {
+  CHECK(image_transform_) << "Model has no Image transform.";
+  return image_transform_->GetOutputShape(shape, dim);
+}
+
+std::vector<int64_t> DataTransform::GetImageShape(int64_t num_images) const {
+  CHECK(image_transform_) << "Model has no Image transform.";
+  return image_transform_->GetOutputShape(num_images);
+}
 
-    const std::string& transformer_type = transforms[i]["Type"].get_ref<const std::string&>();
-    auto it = GetTransformerMap()->find(transformer_type);
-    CHECK(it != GetTransformerMap()->end())
-        << transformer_type << " is not a valid DataTransform type.";
-    const auto transformer = it->second;
+void DataTransform::TransformImage(const int64_t* shape, const void* input, int dim,
+                                   tvm::runtime::NDArray& input_array) const {
+  CHECK(image_transform_) << "Model has no Image transform.";
+  WriteImageInput(image_transform_->GetOutputShape(shape, dim), input_array,
+                  [&](DLDataType dtype, void* out) {
+                    image_transform_->Apply(static_cast<const uint8_t*>(input), shape, dim,
+                                            dtype, out);
+                  });
+}
+
+void DataTransform::TransformImage(const ImageView* images, int64_t num_images,
+                                   tvm::runtime::NDArray& input_array) const {
+  CHECK(image_transform_) << "Model has no Image transform.";
+  WriteImageInput(image_transform_->GetOutputShape(num_images), input_array,
+                  [&](DLDataType dtype, void* out) {
+                    image_transform_->Apply(images, num_images, dtype, out);
+                  });
+}
+
+void DataTransform::TransformROIs(const ImageView& frame, const float* boxes, int64_t num_boxes,
+                                  tvm::runtime::NDArray& input_array) const {
+  CHECK(image_transform_) << "Model has no Image transform.";
+  CHECK_GT(input_array->ndim, 0) << "ROI input requires a batch dimension.";
+  const int64_t batch = input_array->shape[0];
+  WriteImageInput(image_transform_->GetOutputShape(batch), input_array,
+                  [&](DLDataType dtype, void* out) {
+                    image_transform_->ApplyROIs(frame, boxes, num_boxes, batch, dtype, out);
+                  });
+}
 
-    transformer->MapToNDArray(input_json, transforms[i], tvm_inputs->at(i));
+void DataTransform::WriteImageInput(const std::vector<int64_t>& shape,
+                                    tvm::runtime::NDArray& input_array,
+                                    const std::function<void(DLDataType, void*)>& apply) const {
+  CHECK(input_array->ndim == static_cast<int>(shape.size()) &&
+        std::equal(shape.begin(), shape.end(), input_array->shape))
+      << "Preprocessed image does not match the shape of input "
+      << image_transform_->GetInputName();
+  if (input_array->ctx.device_type == kDLCPU) {
+    apply(input_array->dtype, static_cast<char*>(input_array->data) + input_array->byte_offset);
+  } else {
+    tvm::runtime::NDArray staging =
+        tvm::runtime::NDArray::Empty(shape, input_array->dtype, DLContext{kDLCPU, 0});
+    apply(staging->dtype, staging->data);
+    input_array.CopyFrom(staging);
   }
 }
 
@@ -55,16 +554,31 @@ nlohmann::json DataTransform::GetAsJson(const int64_t* shape, const void* input,
   return input_json;
 }
 
-tvm::runtime::NDArray DataTransform::InitNDArray(const nlohmann::json& input_json, DLDataType dtype,
-                                                 DLContext ctx) const {
+tvm::runtime::NDArray DataTransform::InitNDArray(int64_t num_rows, int64_t num_cols,
+                                                 DLDataType dtype, DLContext ctx) const {
   // Create NDArray for transformed input which will be passed to TVM.
-  std::vector<int64_t> arr_shape = {static_cast<int64_t>(input_json.size()),
-                                    static_cast<int64_t>(input_json[0].size())};
+  std::vector<int64_t> arr_shape = {num_rows, num_cols};
   CHECK(dtype.code == kDLFloat && dtype.bits == 32 && dtype.lanes == 1)
-      << "DataTransform CategoricalString is only supported for float32 inputs.";
+      << "DataTransform is only supported for float32 inputs.";
   return tvm::runtime::NDArray::Empty(arr_shape, dtype, ctx);
 }
 
+std::vector<CategoricalStringTable> Transformer::Compile(const nlohmann::json& transform) const {
+  return {};
+}
+
+void Transformer::MapToNDArray(const nlohmann::json& input_json,
+                               const std::vector<CategoricalStringTable>& tables,
+                               tvm::runtime::NDArray& input_array) const {
+  throw dmlc::Error("DataTransform does not use compiled tables for this Type.");
+}
+
+void Transformer::MapToNDArray(const ColumnarInput& input,
+                               const std::vector<CategoricalStringTable>& tables,
+                               tvm::runtime::NDArray& input_array) const {
+  throw dmlc::Error("DataTransform does not use compiled tables for this Type.");
+}
+
 void FloatTransformer::MapToNDArray(const nlohmann::json& input_json,
                                     const nlohmann::json& transform,
                                     tvm::runtime::NDArray& input_array) const {
@@ -72,21 +586,40 @@ void FloatTransformer::MapToNDArray(const nlohmann::json& input_json,
   CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
       << "DataTransform is only supported for CPU.";
   float* data = static_cast<float*>(input_tensor->data);
+  const size_t num_col = input_json[0].size();
   for (size_t r = 0; r < input_json.size(); ++r) {
-    CHECK_EQ(input_json[r].size(), input_json[0].size()) << "Inconsistent number of columns";
-    for (size_t c = 0; c < input_json[r].size(); ++c) {
-      const int out_index = r * input_json[r].size() + c;
-      // Data is numeric, pass through. Attempt to convert string to float.
-      try {
-        data[out_index] = input_json[r][c].is_number()
-                              ? input_json[r][c].get<float>()
-                              : std::stof(input_json[r][c].get_ref<const std::string&>());
-      } catch (const std::exception& ex) {
-        // Any error will fallback safely to kBadValue.
-        data[out_index] = kBadValue;
+    CHECK_EQ(input_json[r].size(), num_col) << "Inconsistent number of columns";
+  }
+  dlr::ParallelFor(input_json.size(), kRowsPerTask, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      const nlohmann::json& row = input_json[r];
+      for (size_t c = 0; c < num_col; ++c) {
+        const nlohmann::json& cell = row[c];
+        float* out = data + r * num_col + c;
+        // Data is numeric, pass through. Attempt to convert string to float. Anything else falls
+        // back to kBadValue.
+        if (cell.is_number()) {
+          *out = cell.get<float>();
+        } else if (!cell.is_string() ||
+                   !ParseFloat(cell.get_ref<const std::string&>().c_str(), out)) {
+          *out = kBadValue;
+        }
       }
     }
-  }
+  });
+}
+
+void FloatTransformer::MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                                    tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform is only supported for CPU.";
+  const float bad_value = kBadValue;
+  auto parse = [bad_value](size_t c, const char* str, size_t length) {
+    float value;
+    return ParseFloat(str, length, &value) ? value : bad_value;
+  };
+  MapColumns(input, parse, true, kBadValue, static_cast<float*>(input_tensor->data));
 }
 
 void CategoricalStringTransformer::MapToNDArray(const nlohmann::json& input_json,
@@ -119,78 +652,568 @@ void CategoricalStringTransformer::MapToNDArray(const nlohmann::json& input_json
   }
 }
 
-const std::shared_ptr<std::unordered_map<std::string, std::shared_ptr<Transformer>>>
-DataTransform::GetTransformerMap() const {
-  static auto map =
-      std::make_shared<std::unordered_map<std::string, std::shared_ptr<Transformer>>>();
-  if (!map->empty()) return map;
-  map->emplace("Float", std::make_shared<FloatTransformer>());
-  map->emplace("CategoricalString", std::make_shared<CategoricalStringTransformer>());
-  return map;
+std::vector<CategoricalStringTable> CategoricalStringTransformer::Compile(
+    const nlohmann::json& transform) const {
+  std::vector<CategoricalStringTable> tables;
+  for (const auto& column_map : transform.at("Map")) {
+    tables.emplace_back(column_map, kMissingValue);
+  }
+  return tables;
 }
 
-template <typename T>
-nlohmann::json DataTransform::TransformOutputHelper1D(const nlohmann::json& mapping, const T* data,
-                                                      const std::vector<int64_t>& shape) const {
-  CHECK_EQ(shape.size(), 1);
-  nlohmann::json output_json = nlohmann::json::array();
-  for (int64_t i = 0; i < shape[0]; ++i) {
-    auto it = mapping.find(std::to_string(data[i]));
-    if (it == mapping.end()) {
-      output_json.push_back(kUnknownLabel);
-    } else {
-      output_json.push_back(*it);
+void CategoricalStringTransformer::MapToNDArray(const nlohmann::json& input_json,
+                                                const std::vector<CategoricalStringTable>& tables,
+                                                tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform CategoricalString is only supported for CPU.";
+  const size_t num_col = input_json[0].size();
+  CHECK_EQ(num_col, tables.size())
+      << "Input has " << num_col << " columns, but model requires " << tables.size();
+  float* data = static_cast<float*>(input_tensor->data);
+  for (size_t r = 0; r < input_json.size(); ++r) {
+    const nlohmann::json& row = input_json[r];
+    CHECK_EQ(row.size(), num_col) << "Inconsistent number of columns";
+    for (size_t c = 0; c < num_col; ++c) {
+      const nlohmann::json& cell = row[c];
+      // Only strings are looked up, anything else is missing.
+      data[r * num_col + c] = cell.is_string()
+                                  ? tables[c].Find(cell.get_ref<const std::string&>())
+                                  : kMissingValue;
     }
   }
-  return output_json;
 }
 
-template <typename T>
-nlohmann::json DataTransform::TransformOutputHelper2D(const nlohmann::json& mapping, const T* data,
-                                                      const std::vector<int64_t>& shape) const {
-  CHECK_EQ(shape.size(), 2);
-  nlohmann::json output_json = nlohmann::json::array();
-  for (int64_t i = 0; i < shape[0]; ++i) {
-    output_json.push_back(TransformOutputHelper1D<T>(mapping, data + i * shape[1], {shape[1]}));
+void CategoricalStringTransformer::MapToNDArray(const ColumnarInput& input,
+                                                const nlohmann::json& transform,
+                                                tvm::runtime::NDArray& input_array) const {
+  const nlohmann::json& mapping = transform["Map"];
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform CategoricalString is only supported for CPU.";
+  CHECK_EQ(input.num_cols(), mapping.size())
+      << "Input has " << input.num_cols() << " columns, but model requires " << mapping.size();
+  const float missing_value = kMissingValue;
+  auto find = [&mapping, missing_value](size_t c, const char* str, size_t length) {
+    auto it = mapping[c].find(std::string(str, length));
+    return it != mapping[c].end() && it->is_number() ? it->get<float>() : missing_value;
+  };
+  MapColumns(input, find, false, kMissingValue, static_cast<float*>(input_tensor->data));
+}
+
+void CategoricalStringTransformer::MapToNDArray(const ColumnarInput& input,
+                                                const std::vector<CategoricalStringTable>& tables,
+                                                tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform CategoricalString is only supported for CPU.";
+  CHECK_EQ(input.num_cols(), tables.size())
+      << "Input has " << input.num_cols() << " columns, but model requires " << tables.size();
+  auto find = [&tables](size_t c, const char* str, size_t length) {
+    return tables[c].Find(str, length);
+  };
+  MapColumns(input, find, false, kMissingValue, static_cast<float*>(input_tensor->data));
+}
+
+void ColumnwiseTransformer::MapToNDArray(const nlohmann::json& input_json,
+                                         const nlohmann::json& transform,
+                                         tvm::runtime::NDArray& input_array) const {
+  FloatTransformer::MapToNDArray(input_json, transform, input_array);
+  Apply(transform, input_array);
+}
+
+void ColumnwiseTransformer::MapToNDArray(const ColumnarInput& input,
+                                         const nlohmann::json& transform,
+                                         tvm::runtime::NDArray& input_array) const {
+  FloatTransformer::MapToNDArray(input, transform, input_array);
+  Apply(transform, input_array);
+}
+
+void ColumnwiseTransformer::Apply(const nlohmann::json& transform,
+                                  tvm::runtime::NDArray& input_array) const {
+  const size_t num_rows = input_array->shape[0];
+  const size_t num_cols = input_array->shape[1];
+  const ColumnParams params = GetParams(transform, num_cols);
+  const float* scale = params.scale.empty() ? nullptr : params.scale.data();
+  const float* offset = params.offset.data();
+  const float* replacement = params.replacement.empty() ? nullptr : params.replacement.data();
+  const float missing_value = params.missing_value;
+  float* data = static_cast<float*>(input_array->data);
+  dlr::ParallelFor(num_rows, kRowsPerTask, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      float* row = data + r * num_cols;
+      // Branch-free loops over contiguous columns, which the compiler vectorizes.
+      if (scale) {
+        for (size_t c = 0; c < num_cols; ++c) row[c] = row[c] * scale[c] + offset[c];
+      }
+      if (replacement) {
+        for (size_t c = 0; c < num_cols; ++c) {
+          const bool missing = std::isnan(row[c]) || row[c] == missing_value;
+          row[c] = missing ? replacement[c] : row[c];
+        }
+      }
+    }
+  });
+}
+
+ColumnwiseTransformer::ColumnParams StandardScalerTransformer::GetParams(
+    const nlohmann::json& transform, size_t num_cols) const {
+  ColumnParams params;
+  const std::vector<float> mean = GetColumnValues(transform, "Mean", num_cols, 0.0f);
+  params.scale = GetColumnValues(transform, "Scale", num_cols, 1.0f);
+  params.offset.resize(num_cols);
+  for (size_t c = 0; c < num_cols; ++c) {
+    // Constant columns have a Scale of 0 and are only centered, as in sklearn.
+    params.scale[c] = params.scale[c] == 0.0f ? 1.0f : 1.0f / params.scale[c];
+    params.offset[c] = -mean[c] * params.scale[c];
+  }
+  return params;
+}
+
+ColumnwiseTransformer::ColumnParams MinMaxTransformer::GetParams(const nlohmann::json& transform,
+                                                                 size_t num_cols) const {
+  ColumnParams params;
+  params.scale = GetColumnValues(transform, "Scale", num_cols);
+  params.offset = GetColumnValues(transform, "Min", num_cols);
+  return params;
+}
+
+ColumnwiseTransformer::ColumnParams ImputerTransformer::GetParams(const nlohmann::json& transform,
+                                                                  size_t num_cols) const {
+  ColumnParams params;
+  params.replacement = GetColumnValues(transform, "Statistics", num_cols);
+  if (transform.count("MissingValue") && transform["MissingValue"].is_number()) {
+    params.missing_value = transform["MissingValue"].get<float>();
+  }
+  return params;
+}
+
+int64_t OneHotTransformer::GetNumOutputColumns(const nlohmann::json& transform,
+                                               int64_t num_cols) const {
+  const nlohmann::json& categories = transform.at("Categories");
+  CHECK(categories.is_array() && static_cast<int64_t>(categories.size()) == num_cols)
+      << "Input has " << num_cols << " columns, but model requires " << categories.size();
+  int64_t width = 0;
+  for (const auto& column_categories : categories) width += column_categories.size();
+  return width;
+}
+
+std::vector<CategoricalStringTable> OneHotTransformer::Compile(
+    const nlohmann::json& transform) const {
+  std::vector<CategoricalStringTable> tables;
+  int64_t output_column = 0;
+  for (const auto& column_categories : transform.at("Categories")) {
+    CHECK(column_categories.is_array()) << "OneHot Categories must be an array per column.";
+    nlohmann::json mapping = nlohmann::json::object();
+    for (const auto& category : column_categories) {
+      if (category.is_string()) {
+        mapping[category.get<std::string>()] = output_column;
+      } else if (category.is_number()) {
+        char key[kNumericKeySize];
+        MakeNumericKey(category.get<float>(), key);
+        mapping[std::string(key, sizeof(key))] = output_column;
+      } else {
+        throw dmlc::Error("OneHot categories must be strings or numbers.");
+      }
+      ++output_column;
+    }
+    tables.emplace_back(mapping, -1.0f);
   }
-  return output_json;
+  return tables;
+}
+
+void OneHotTransformer::MapToNDArray(const nlohmann::json& input_json,
+                                     const nlohmann::json& transform,
+                                     tvm::runtime::NDArray& input_array) const {
+  MapToNDArray(input_json, Compile(transform), input_array);
+}
+
+void OneHotTransformer::MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                                     tvm::runtime::NDArray& input_array) const {
+  MapToNDArray(input, Compile(transform), input_array);
+}
+
+void OneHotTransformer::MapToNDArray(const nlohmann::json& input_json,
+                                     const std::vector<CategoricalStringTable>& tables,
+                                     tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform is only supported for CPU.";
+  const size_t num_col = input_json[0].size();
+  CHECK_EQ(num_col, tables.size())
+      << "Input has " << num_col << " columns, but model requires " << tables.size();
+  for (size_t r = 0; r < input_json.size(); ++r) {
+    CHECK_EQ(input_json[r].size(), num_col) << "Inconsistent number of columns";
+  }
+  const size_t width = input_tensor->shape[1];
+  float* data = static_cast<float*>(input_tensor->data);
+  dlr::ParallelFor(input_json.size(), kRowsPerTask, [&](size_t begin, size_t end) {
+    std::fill(data + begin * width, data + end * width, 0.0f);
+    for (size_t r = begin; r < end; ++r) {
+      const nlohmann::json& row = input_json[r];
+      for (size_t c = 0; c < num_col; ++c) {
+        const nlohmann::json& cell = row[c];
+        float index = -1.0f;
+        if (cell.is_string()) {
+          index = tables[c].Find(cell.get_ref<const std::string&>());
+        } else if (cell.is_number()) {
+          index = FindNumber(tables[c], cell.get<float>());
+        }
+        if (index >= 0.0f) data[r * width + static_cast<size_t>(index)] = 1.0f;
+      }
+    }
+  });
+}
+
+void OneHotTransformer::MapToNDArray(const ColumnarInput& input,
+                                     const std::vector<CategoricalStringTable>& tables,
+                                     tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform is only supported for CPU.";
+  const size_t num_cols = input.num_cols();
+  CHECK_EQ(num_cols, tables.size())
+      << "Input has " << num_cols << " columns, but model requires " << tables.size();
+  // Output column of each dictionary entry, looked up once.
+  std::vector<std::vector<float>> dict_index(num_cols);
+  for (size_t c = 0; c < num_cols; ++c) {
+    const ColumnarInput::Column& column = input.column(c);
+    if (column.type != ColumnarInput::kDictionary) continue;
+    dict_index[c].resize(column.dict_size);
+    for (uint32_t k = 0; k < column.dict_size; ++k) {
+      const char* str;
+      size_t length;
+      ColumnarInput::GetString(column, k, &str, &length);
+      dict_index[c][k] = tables[c].Find(str, length);
+    }
+  }
+  const size_t width = input_tensor->shape[1];
+  float* data = static_cast<float*>(input_tensor->data);
+  dlr::ParallelFor(input.num_rows(), kRowsPerTask, [&](size_t begin, size_t end) {
+    std::fill(data + begin * width, data + end * width, 0.0f);
+    for (size_t c = 0; c < num_cols; ++c) {
+      const ColumnarInput::Column& column = input.column(c);
+      for (size_t r = begin; r < end; ++r) {
+        float index;
+        if (column.type == ColumnarInput::kString) {
+          const char* str;
+          size_t length;
+          ColumnarInput::GetString(column, r, &str, &length);
+          index = tables[c].Find(str, length);
+        } else if (column.type == ColumnarInput::kDictionary) {
+          const uint32_t code = ColumnarInput::GetCode(column, r);
+          index = code == ColumnarInput::kNullCode ? -1.0f : dict_index[c][code];
+        } else {
+          index = FindNumber(tables[c], GetNumber(column, r));
+        }
+        if (index >= 0.0f) data[r * width + static_cast<size_t>(index)] = 1.0f;
+      }
+    }
+  });
+}
+
+int64_t HashingTransformer::GetNumOutputColumns(const nlohmann::json& transform,
+                                                int64_t num_cols) const {
+  const int64_t num_features = transform.at("NumFeatures").get<int64_t>();
+  CHECK(num_features > 0 && num_features <= std::numeric_limits<int32_t>::max())
+      << "Hashing NumFeatures must be a positive 32-bit integer.";
+  return num_features;
+}
+
+void HashingTransformer::MapToNDArray(const nlohmann::json& input_json,
+                                      const nlohmann::json& transform,
+                                      tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform is only supported for CPU.";
+  const size_t num_col = input_json[0].size();
+  for (size_t r = 0; r < input_json.size(); ++r) {
+    CHECK_EQ(input_json[r].size(), num_col) << "Inconsistent number of columns";
+  }
+  const HashingParams params = GetHashingParams(transform, num_col);
+  const size_t width = params.num_features;
+  float* data = static_cast<float*>(input_tensor->data);
+  dlr::ParallelFor(input_json.size(), kRowsPerTask, [&](size_t begin, size_t end) {
+    std::fill(data + begin * width, data + end * width, 0.0f);
+    std::string buffer;
+    for (size_t r = begin; r < end; ++r) {
+      const nlohmann::json& row = input_json[r];
+      float* out = data + r * width;
+      for (size_t c = 0; c < num_col; ++c) {
+        const nlohmann::json& cell = row[c];
+        if (cell.is_string()) {
+          const std::string& str = cell.get_ref<const std::string&>();
+          AddStringFeature(params, c, str.data(), str.size(), &buffer, out);
+        } else if (cell.is_number()) {
+          AddNumberFeature(params, c, cell.get<float>(), out);
+        }
+      }
+    }
+  });
+}
+
+void HashingTransformer::MapToNDArray(const ColumnarInput& input, const nlohmann::json& transform,
+                                      tvm::runtime::NDArray& input_array) const {
+  DLTensor* input_tensor = const_cast<DLTensor*>(input_array.operator->());
+  CHECK_EQ(input_tensor->ctx.device_type, DLDeviceType::kDLCPU)
+      << "DataTransform is only supported for CPU.";
+  const size_t num_cols = input.num_cols();
+  const HashingParams params = GetHashingParams(transform, num_cols);
+  // Output index and sign of each dictionary entry, hashed once.
+  std::vector<std::vector<std::pair<size_t, float>>> dict_features(num_cols);
+  std::string name;
+  for (size_t c = 0; c < num_cols; ++c) {
+    const ColumnarInput::Column& column = input.column(c);
+    if (column.type != ColumnarInput::kDictionary) continue;
+    dict_features[c].resize(column.dict_size);
+    for (uint32_t k = 0; k < column.dict_size; ++k) {
+      const char* str;
+      size_t length;
+      ColumnarInput::GetString(column, k, &str, &length);
+      if (!params.prefixes.empty()) {
+        name.assign(params.prefixes[c]);
+        name.append(str, length);
+        str = name.data();
+        length = name.size();
+      }
+      HashFeature(params, str, length, &dict_features[c][k].first, &dict_features[c][k].second);
+    }
+  }
+  const size_t width = params.num_features;
+  float* data = static_cast<float*>(input_tensor->data);
+  dlr::ParallelFor(input.num_rows(), kRowsPerTask, [&](size_t begin, size_t end) {
+    std::fill(data + begin * width, data + end * width, 0.0f);
+    std::string buffer;
+    for (size_t c = 0; c < num_cols; ++c) {
+      const ColumnarInput::Column& column = input.column(c);
+      for (size_t r = begin; r < end; ++r) {
+        float* out = data + r * width;
+        if (column.type == ColumnarInput::kString) {
+          const char* str;
+          size_t length;
+          ColumnarInput::GetString(column, r, &str, &length);
+          AddStringFeature(params, c, str, length, &buffer, out);
+        } else if (column.type == ColumnarInput::kDictionary) {
+          const uint32_t code = ColumnarInput::GetCode(column, r);
+          if (code == ColumnarInput::kNullCode) continue;
+          out[dict_features[c][code].first] += dict_features[c][code].second;
+        } else {
+          AddNumberFeature(params, c, GetNumber(column, r), out);
+        }
+      }
+    }
+  });
+}
+
+int32_t dlr::MurmurHash3(const char* key, size_t length) {
+  constexpr uint32_t c1 = 0xcc9e2d51;
+  constexpr uint32_t c2 = 0x1b873593;
+  auto rotl = [](uint32_t x, int r) { return (x << r) | (x >> (32 - r)); };
+  auto mix = [&](uint32_t k) { return rotl(k * c1, 15) * c2; };
+  uint32_t h = 0;
+  const size_t num_blocks = length / 4;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    h ^= mix(ReadUInt32(key + i * 4));
+    h = rotl(h, 13) * 5 + 0xe6546b64;
+  }
+  const unsigned char* tail = reinterpret_cast<const unsigned char*>(key + num_blocks * 4);
+  uint32_t k = 0;
+  switch (length & 3) {
+    case 3:
+      k ^= tail[2] << 16;
+      // fall through
+    case 2:
+      k ^= tail[1] << 8;
+      // fall through
+    case 1:
+      k ^= tail[0];
+      h ^= mix(k);
+  }
+  h ^= static_cast<uint32_t>(length);
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return static_cast<int32_t>(h);
+}
+
+CategoricalStringTable::CategoricalStringTable(const nlohmann::json& mapping,
+                                               float missing_value)
+    : missing_value_(missing_value) {
+  CHECK(mapping.is_object()) << "CategoricalString map must be an object.";
+  size_t capacity = 8;
+  while (capacity < 2 * mapping.size()) capacity *= 2;
+  slots_.assign(capacity, Slot{0, kEmptySlot, 0, 0.0f});
+  mask_ = capacity - 1;
+  for (auto it = mapping.begin(); it != mapping.end(); ++it) {
+    const std::string& key = it.key();
+    CHECK_LT(keys_.size() + key.size(), kEmptySlot) << "CategoricalString map is too large.";
+    const uint64_t hash = Hash(key.data(), key.size());
+    size_t i = hash & mask_;
+    // Keys of a JSON object are unique, so the key is not in the table yet.
+    while (slots_[i].offset != kEmptySlot) i = (i + 1) & mask_;
+    slots_[i].tag = static_cast<uint32_t>(hash >> 32);
+    slots_[i].offset = static_cast<uint32_t>(keys_.size());
+    slots_[i].length = static_cast<uint32_t>(key.size());
+    slots_[i].value = it.value().is_number() ? it.value().get<float>() : missing_value;
+    keys_ += key;
+    ++num_keys_;
+  }
+}
+
+float CategoricalStringTable::Find(const char* key, size_t length) const {
+  const uint64_t hash = Hash(key, length);
+  const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+  for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+    const Slot& slot = slots_[i];
+    if (slot.offset == kEmptySlot) return missing_value_;
+    if (slot.tag == tag && slot.length == length &&
+        std::memcmp(keys_.data() + slot.offset, key, length) == 0) {
+      return slot.value;
+    }
+  }
+}
+
+uint64_t CategoricalStringTable::Hash(const char* key, size_t length) {
+  // Eight bytes per multiply, with a murmur3 finalizer to spread them over all bits.
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ length;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, key + i, 8);
+    h = (h ^ word) * 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 29;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, key + i, length - i);
+  h = (h ^ tail) * 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+const std::unordered_map<std::string, std::shared_ptr<Transformer>>&
+DataTransform::GetTransformerMap() {
+  // Initialization of a function-local static is thread-safe, and the map is never modified.
+  static const std::unordered_map<std::string, std::shared_ptr<Transformer>> map = {
+      {"Float", std::make_shared<FloatTransformer>()},
+      {"CategoricalString", std::make_shared<CategoricalStringTransformer>()},
+      {"StandardScaler", std::make_shared<StandardScalerTransformer>()},
+      {"MinMax", std::make_shared<MinMaxTransformer>()},
+      {"Imputer", std::make_shared<ImputerTransformer>()},
+      {"OneHot", std::make_shared<OneHotTransformer>()},
+      {"Hashing", std::make_shared<HashingTransformer>()},
+  };
+  return map;
+}
+
+const Transformer& DataTransform::GetTransformer(const nlohmann::json& transform) {
+  const std::string& type = transform.at("Type").get_ref<const std::string&>();
+  auto it = GetTransformerMap().find(type);
+  CHECK(it != GetTransformerMap().end()) << type << " is not a valid DataTransform type.";
+  return *it->second;
+}
+
+OutputLabelTable::OutputLabelTable(const nlohmann::json& mapping,
+                                   const std::string& unknown_label)
+    : unknown_label_(nlohmann::json(unknown_label).dump()) {
+  // Only keys that std::to_string would produce match an integer output.
+  std::vector<std::pair<int64_t, std::string>> labels;
+  for (auto it = mapping.begin(); it != mapping.end(); ++it) {
+    const std::string& key = it.key();
+    char* end;
+    errno = 0;
+    const long long value = std::strtoll(key.c_str(), &end, 10);
+    if (errno == ERANGE || key.empty() || std::to_string(value) != key) continue;
+    labels.emplace_back(value, it.value().dump());
+  }
+  if (labels.empty()) return;
+  auto range = std::minmax_element(
+      labels.begin(), labels.end(),
+      [](const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) {
+        return a.first < b.first;
+      });
+  const uint64_t span =
+      static_cast<uint64_t>(range.second->first) - static_cast<uint64_t>(range.first->first);
+  if (span < 2 * labels.size() + 64) {
+    min_value_ = range.first->first;
+    dense_.resize(span + 1);
+    for (auto& label : labels) dense_[label.first - min_value_] = std::move(label.second);
+  } else {
+    for (auto& label : labels) sparse_.emplace(label.first, std::move(label.second));
+  }
+}
+
+void DataTransform::CompileOutputTransform(const nlohmann::json& metadata, int index) {
+  const auto& mapping = metadata.at("DataTransform")
+                            .at("Output")
+                            .at(std::to_string(index))
+                            .at("CategoricalString");
+  TransformedOutput& output = transformed_outputs_[index];
+  output.labels = OutputLabelTable(mapping, kUnknownLabel);
+  output.metadata = &metadata;
 }
 
 void DataTransform::TransformOutput(const nlohmann::json& metadata, int index,
                                     const tvm::runtime::NDArray& output_array) {
-  auto& mapping = metadata["DataTransform"]["Output"][std::to_string(index)]["CategoricalString"];
   const DLTensor* tensor = output_array.operator->();
   CHECK_EQ(tensor->ctx.device_type, DLDeviceType::kDLCPU)
       << "DataTransform CategoricalString is only supported for CPU.";
   CHECK(tensor->dtype.code == kDLInt && tensor->dtype.bits == 32 && tensor->dtype.lanes == 1)
       << "DataTransform CategoricalString is only supported for int32 outputs.";
-
-  std::vector<int64_t> shape(output_array->shape, output_array->shape + output_array->ndim);
-  nlohmann::json output_json;
-  if (shape.size() == 1) {
-    output_json = TransformOutputHelper1D<int>(mapping, static_cast<int*>(tensor->data), shape);
-  } else if (shape.size() == 2) {
-    output_json = TransformOutputHelper2D<int>(mapping, static_cast<int*>(tensor->data), shape);
-  } else {
+  if (tensor->ndim != 1 && tensor->ndim != 2) {
     throw dmlc::Error("DataTransform CategoricalString is only supported for 1-D or 2-D inputs.");
   }
-  transformed_outputs_[index] = output_json.dump();
+  TransformedOutput& output = transformed_outputs_[index];
+  if (output.metadata != &metadata) CompileOutputTransform(metadata, index);
+  output.array = output_array;
+  output.serialized = false;
+}
+
+const std::string& DataTransform::GetTransformedOutput(int index) const {
+  TransformedOutput& output = transformed_outputs_.at(index);
+  if (output.serialized) return output.data;
+  // Compiled at load, but not produced by a Run yet.
+  CHECK(output.array.defined()) << "Output " << index << " is not available before Run.";
+  const DLTensor* tensor = output.array.operator->();
+  const int* data = static_cast<const int*>(tensor->data);
+  const int64_t num_rows = tensor->ndim == 1 ? 1 : tensor->shape[0];
+  const int64_t num_cols = tensor->shape[tensor->ndim - 1];
+  std::string& out = output.data;
+  out.clear();
+  if (tensor->ndim == 2) out += '[';
+  for (int64_t r = 0; r < num_rows; ++r) {
+    if (r > 0) out += ',';
+    out += '[';
+    for (int64_t c = 0; c < num_cols; ++c) {
+      if (c > 0) out += ',';
+      output.labels.Append(data[r * num_cols + c], &out);
+    }
+    out += ']';
+  }
+  if (tensor->ndim == 2) out += ']';
+  output.serialized = true;
+  // The serialized output no longer needs the model's output.
+  output.array = tvm::runtime::NDArray();
+  return out;
 }
 
 void DataTransform::GetOutputShape(int index, int64_t* shape) const {
-  shape[0] = transformed_outputs_.at(index).size();
+  shape[0] = GetTransformedOutput(index).size();
 }
 
 void DataTransform::GetOutputSizeDim(int index, int64_t* size, int* dim) const {
-  *size = transformed_outputs_.at(index).size();
+  *size = GetTransformedOutput(index).size();
   *dim = 1;
 }
 
 void DataTransform::GetOutput(int index, void* output) const {
-  const std::string& output_str = transformed_outputs_.at(index);
+  const std::string& output_str = GetTransformedOutput(index);
   std::copy(output_str.begin(), output_str.end(), static_cast<char*>(output));
 }
 
 const void* DataTransform::GetOutputPtr(int index) const {
-  return static_cast<const void*>(transformed_outputs_.at(index).data());
+  return static_cast<const void*>(GetTransformedOutput(index).data());
 }
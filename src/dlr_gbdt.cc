@@ -0,0 +1,502 @@
+#include "dlr_gbdt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace dlr;
+
+const std::string GBDTModel::INPUT_NAME = "data";
+const std::string GBDTModel::INPUT_TYPE = "float32";
+const std::string GBDTModel::OUTPUT_TYPE = "float32";
+
+namespace {
+
+/*! \brief Rows per task when scoring in parallel. */
+constexpr size_t kRowsPerTask = 256;
+
+/*! \brief Node as read from the model file, with children indexed within its tree. */
+struct RawNode {
+  bool is_leaf;
+  float threshold_or_value;
+  uint32_t feature;
+  int32_t left;
+  int32_t right;
+};
+
+/*! \brief Append a tree breadth first, so that the top levels shared by all rows are adjacent.
+ * Returns the index of its root and sets depth to the number of steps to its deepest leaf.
+ */
+int32_t AppendTree(const std::vector<RawNode>& raw,
+                   std::vector<GBDTNode, DLRAllocator<GBDTNode>>* nodes, int32_t* depth) {
+  CHECK(!raw.empty()) << "Tree has no nodes.";
+  const int32_t root = static_cast<int32_t>(nodes->size());
+  std::vector<int32_t> order;
+  std::vector<int32_t> position(raw.size(), -1);
+  std::vector<int32_t> level(raw.size(), 0);
+  order.push_back(0);
+  position[0] = root;
+  *depth = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    const RawNode& node = raw[order[i]];
+    *depth = std::max(*depth, level[order[i]]);
+    if (node.is_leaf) continue;
+    for (int32_t child : {node.left, node.right}) {
+      CHECK(child > 0 && static_cast<size_t>(child) < raw.size() && position[child] < 0)
+          << "Tree is malformed.";
+      position[child] = root + static_cast<int32_t>(order.size());
+      level[child] = level[order[i]] + 1;
+      order.push_back(child);
+    }
+  }
+  for (int32_t i : order) {
+    const RawNode& node = raw[i];
+    if (node.is_leaf) {
+      nodes->push_back({node.threshold_or_value, 0, position[i], position[i]});
+    } else {
+      nodes->push_back(
+          {node.threshold_or_value, node.feature, position[node.left], position[node.right]});
+    }
+  }
+  return root;
+}
+
+/*! \brief XGBoost stores floats as numbers, strings, or strings of one element arrays. */
+float ParseXGBoostFloat(const nlohmann::json& value) {
+  if (value.is_number()) return value.get<float>();
+  std::string s = value.get<std::string>();
+  s.erase(std::remove_if(s.begin(), s.end(), [](char c) { return c == '[' || c == ']'; }),
+          s.end());
+  return std::stof(s);
+}
+
+/*! \brief Threshold t' such that x < t' holds exactly when x <= t, for every float x. */
+float LessOrEqualThreshold(double t) {
+  float f = static_cast<float>(t);
+  if (static_cast<double>(f) > t) f = std::nextafter(f, -std::numeric_limits<float>::infinity());
+  return std::nextafter(f, std::numeric_limits<float>::infinity());
+}
+
+int32_t FlattenLightGBMTree(const nlohmann::json& node, std::vector<RawNode>* raw) {
+  const int32_t index = static_cast<int32_t>(raw->size());
+  raw->push_back(RawNode());
+  if (node.find("leaf_value") != node.end()) {
+    (*raw)[index] = {true, node.at("leaf_value").get<float>(), 0, -1, -1};
+    return index;
+  }
+  const std::string decision_type = node.at("decision_type");
+  CHECK(decision_type == "<=") << "Unsupported LightGBM decision type: " << decision_type
+                               << ". Categorical splits are not supported.";
+  RawNode split;
+  split.is_leaf = false;
+  split.threshold_or_value = LessOrEqualThreshold(node.at("threshold").get<double>());
+  split.feature = node.at("split_feature").get<uint32_t>();
+  const std::string missing_type = node.value("missing_type", "None");
+  const bool default_left = node.value("default_left", true);
+  if (missing_type == "NaN") {
+    if (default_left) split.feature |= GBDTNode::kDefaultLeft;
+  } else if (missing_type == "Zero") {
+    // NaN is converted to zero, and zero goes to the default child.
+    split.feature |= GBDTNode::kZeroIsMissing;
+    if (default_left) split.feature |= GBDTNode::kDefaultLeft;
+  } else {
+    // NaN is converted to zero and compared with the threshold.
+    if (0.0f < split.threshold_or_value) split.feature |= GBDTNode::kDefaultLeft;
+  }
+  split.left = FlattenLightGBMTree(node.at("left_child"), raw);
+  split.right = FlattenLightGBMTree(node.at("right_child"), raw);
+  (*raw)[index] = split;
+  return index;
+}
+
+}  // namespace
+
+ModelPath dlr::SetGBDTPaths(const std::vector<std::string>& files) {
+  ModelPath paths;
+  dlr::InitModelPath(files, &paths);
+  if (paths.model_json.empty()) {
+    throw dmlc::Error("Invalid GBDT model artifact. Must have .json file.");
+  }
+  return paths;
+}
+
+void GBDTModel::SetupGBDTModule(const std::vector<std::string>& files) {
+  ModelPath paths = SetGBDTPaths(files);
+  nlohmann::json model;
+  LoadJsonFromFile(paths.model_json, model);
+  if (model.is_null()) {
+    throw dmlc::Error("Failed to parse GBDT model " + paths.model_json);
+  }
+  try {
+    if (model.find("learner") != model.end()) {
+      LoadXGBoost(model);
+    } else if (model.find("tree_info") != model.end()) {
+      LoadLightGBM(model);
+    } else {
+      throw dmlc::Error(paths.model_json +
+                        " is neither an XGBoost JSON model nor a LightGBM JSON dump.");
+    }
+  } catch (nlohmann::json::exception& e) {
+    throw dmlc::Error("Invalid GBDT model " + paths.model_json + ": " + e.what());
+  }
+  CHECK_GT(num_feature_, 0) << "Model has no features.";
+  CHECK_LE(num_feature_, static_cast<size_t>(GBDTNode::kFeatureMask))
+      << "Model has too many features.";
+  // Traversal addresses the 32-bit words of a node with 32-bit indices.
+  CHECK_LT(nodes_.size(), size_t(1) << 29) << "Model has too many nodes.";
+  for (const GBDTNode& node : nodes_) {
+    CHECK_LT(node.feature & GBDTNode::kFeatureMask, num_feature_)
+        << "Split feature is out of range.";
+  }
+  output_size_ = transform_ == Transform::kArgmax ? 1 : num_group_;
+
+  num_inputs_ = 1;
+  num_outputs_ = 1;
+  input_names_.push_back(INPUT_NAME);
+  input_types_.push_back(INPUT_TYPE);
+  UpdateInputShapes();
+  if (!paths.metadata.empty() && !IsFileEmpty(paths.metadata)) {
+    LoadJsonFromFile(paths.metadata, this->metadata_);
+    ValidateDeviceTypeIfExists();
+  }
+}
+
+void GBDTModel::LoadXGBoost(const nlohmann::json& model) {
+  const nlohmann::json& learner = model.at("learner");
+  const nlohmann::json& param = learner.at("learner_model_param");
+  num_feature_ = std::stoul(param.at("num_feature").get<std::string>());
+  num_group_ = std::max(std::stoi(param.at("num_class").get<std::string>()), 1);
+  const float base_score = ParseXGBoostFloat(param.at("base_score"));
+
+  // base_score is given in the output space, the margin is its inverse transform.
+  const std::string objective = learner.at("objective").at("name");
+  float base_margin = base_score;
+  if (objective == "binary:logistic" || objective == "reg:logistic") {
+    transform_ = Transform::kSigmoid;
+    base_margin = -std::log(1.0f / base_score - 1.0f);
+  } else if (objective == "binary:logitraw") {
+    base_margin = -std::log(1.0f / base_score - 1.0f);
+  } else if (objective == "multi:softprob") {
+    transform_ = Transform::kSoftmax;
+  } else if (objective == "multi:softmax") {
+    transform_ = Transform::kArgmax;
+  } else if (objective == "count:poisson" || objective == "reg:gamma" ||
+             objective == "reg:tweedie") {
+    transform_ = Transform::kExp;
+    base_margin = std::log(base_score);
+  } else if (!StartsWith(objective, "reg:") && !StartsWith(objective, "rank:")) {
+    throw dmlc::Error("Unsupported XGBoost objective: " + objective);
+  }
+  base_margin_.assign(num_group_, base_margin);
+
+  const nlohmann::json* booster = &learner.at("gradient_booster");
+  const std::string booster_name = booster->at("name");
+  std::vector<float> weight_drop;
+  if (booster_name == "dart") {
+    weight_drop = booster->at("weight_drop").get<std::vector<float>>();
+    booster = &booster->at("gbtree");
+  } else if (booster_name != "gbtree") {
+    throw dmlc::Error("Unsupported XGBoost booster: " + booster_name);
+  }
+  const nlohmann::json& trees = booster->at("model").at("trees");
+  const nlohmann::json& tree_info = booster->at("model").at("tree_info");
+  CHECK_EQ(trees.size(), tree_info.size()) << "Invalid XGBoost model: tree_info size mismatch.";
+  for (size_t t = 0; t < trees.size(); ++t) {
+    const nlohmann::json& tree = trees[t];
+    if (tree.find("split_type") != tree.end()) {
+      for (const auto& split_type : tree.at("split_type")) {
+        CHECK_EQ(split_type.get<int>(), 0) << "Categorical splits are not supported.";
+      }
+    }
+    const auto left = tree.at("left_children").get<std::vector<int32_t>>();
+    const auto right = tree.at("right_children").get<std::vector<int32_t>>();
+    const auto split_index = tree.at("split_indices").get<std::vector<uint32_t>>();
+    const auto split_condition = tree.at("split_conditions").get<std::vector<float>>();
+    const nlohmann::json& default_left = tree.at("default_left");
+    const size_t num_node = left.size();
+    CHECK(right.size() == num_node && split_index.size() == num_node &&
+          split_condition.size() == num_node && default_left.size() == num_node)
+        << "Invalid XGBoost model: tree " << t << " has arrays of different sizes.";
+    const float weight = weight_drop.empty() ? 1.0f : weight_drop.at(t);
+    std::vector<RawNode> raw(num_node);
+    for (size_t i = 0; i < num_node; ++i) {
+      if (left[i] == -1) {
+        raw[i] = {true, split_condition[i] * weight, 0, -1, -1};
+        continue;
+      }
+      const bool is_default_left = default_left[i].is_boolean() ? default_left[i].get<bool>()
+                                                                : default_left[i].get<int>() != 0;
+      raw[i] = {false, split_condition[i],
+                split_index[i] | (is_default_left ? GBDTNode::kDefaultLeft : 0), left[i],
+                right[i]};
+    }
+    Tree entry;
+    entry.root = AppendTree(raw, &nodes_, &entry.depth);
+    entry.group = tree_info[t].get<int32_t>();
+    CHECK(entry.group >= 0 && static_cast<size_t>(entry.group) < num_group_)
+        << "Invalid XGBoost model: tree " << t << " has an invalid output group.";
+    trees_.push_back(entry);
+  }
+}
+
+void GBDTModel::LoadLightGBM(const nlohmann::json& model) {
+  num_feature_ = model.at("max_feature_idx").get<size_t>() + 1;
+  num_group_ = model.value("num_tree_per_iteration", size_t(1));
+  base_margin_.assign(num_group_, 0.0f);
+
+  // For example "binary sigmoid:1" or "multiclass num_class:3".
+  std::istringstream objective(model.value("objective", std::string("regression")));
+  std::string name;
+  objective >> name;
+  for (std::string token; objective >> token;) {
+    if (StartsWith(token, "sigmoid:")) sigmoid_alpha_ = std::stof(token.substr(8));
+    if (token == "sqrt") throw dmlc::Error("LightGBM regression with sqrt is not supported.");
+  }
+  if (name == "binary" || name == "multiclassova" || name == "cross_entropy" ||
+      name == "xentropy") {
+    transform_ = Transform::kSigmoid;
+  } else if (name == "multiclass" || name == "softmax") {
+    transform_ = Transform::kSoftmax;
+  } else if (name == "poisson" || name == "gamma" || name == "tweedie") {
+    transform_ = Transform::kExp;
+  } else if (!StartsWith(name, "regression") && name != "huber" && name != "fair" &&
+             name != "quantile" && name != "mape" && name != "lambdarank" &&
+             name != "rank_xendcg") {
+    throw dmlc::Error("Unsupported LightGBM objective: " + name);
+  }
+
+  const nlohmann::json& tree_info = model.at("tree_info");
+  for (size_t t = 0; t < tree_info.size(); ++t) {
+    std::vector<RawNode> raw;
+    FlattenLightGBMTree(tree_info[t].at("tree_structure"), &raw);
+    Tree entry;
+    entry.root = AppendTree(raw, &nodes_, &entry.depth);
+    entry.group = static_cast<int32_t>(t % num_group_);
+    trees_.push_back(entry);
+  }
+  if (model.value("average_output", false) && !trees_.empty()) {
+    margin_scale_ = static_cast<float>(num_group_) / trees_.size();
+  }
+}
+
+void GBDTModel::UpdateInputShapes() {
+  input_shapes_.resize(num_inputs_);
+  input_shapes_[0] = {num_row_, static_cast<int64_t>(num_feature_)};
+}
+
+std::vector<std::string> GBDTModel::GetWeightNames() const {
+  throw dmlc::Error("GetWeightNames is not supported by GBDT backend.");
+  return std::vector<std::string>();  // unreachable
+}
+
+const char* GBDTModel::GetInputName(int index) const {
+  CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+  return INPUT_NAME.c_str();
+}
+
+const int GBDTModel::GetInputDim(int index) const { return kInputDim; }
+
+const int64_t GBDTModel::GetInputSize(int index) const {
+  CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+  if (num_row_ < 0) return -1;
+  return num_row_ * static_cast<int64_t>(num_feature_);
+}
+
+const char* GBDTModel::GetInputType(int index) const {
+  CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+  return INPUT_TYPE.c_str();
+}
+
+const char* GBDTModel::GetWeightName(int index) const {
+  throw dmlc::Error("GetWeightName is not supported by GBDT backend.");
+  return "";  // unreachable
+}
+
+void GBDTModel::SetInput(const char* name, const int64_t* shape, const void* input, int dim) {
+  // NOTE: Assume that missing values are represented by NAN
+  CHECK_SHAPE("Mismatch found in input dimension", dim, kInputDim);
+  CHECK_GE(shape[0], 0) << "Batch size must not be negative.";
+  // NOTE: If number of columns is less than num_feature, missing columns
+  //       will be automatically padded with missing values
+  CHECK(shape[1] >= 0 && static_cast<size_t>(shape[1]) <= num_feature_)
+      << "ClientError: Mismatch found in input shape at dimension 1. Value read: " << shape[1]
+      << ", Expected: " << num_feature_ << " or less";
+
+  const size_t num_row = static_cast<size_t>(shape[0]);
+  const size_t num_col = static_cast<size_t>(shape[1]);
+  const float* input_f = static_cast<const float*>(input);
+  input_.resize(num_row * num_feature_);
+  if (num_col == num_feature_) {
+    std::memcpy(input_.data(), input_f, sizeof(float) * num_row * num_col);
+  } else {
+    for (size_t i = 0; i < num_row; ++i) {
+      float* row = input_.data() + i * num_feature_;
+      std::memcpy(row, input_f + i * num_col, sizeof(float) * num_col);
+      std::fill(row + num_col, row + num_feature_, NAN);
+    }
+  }
+  num_row_ = static_cast<int64_t>(num_row);
+  margin_.resize(num_row * num_group_);
+  output_.resize(num_row * output_size_);
+  UpdateInputShapes();
+}
+
+void GBDTModel::GetInput(const char* name, void* input) {
+  throw dmlc::Error("GetInput is not supported by GBDT backend.");
+}
+
+void GBDTModel::GetOutputShape(int index, int64_t* shape) const {
+  // Use -1 if input is yet unspecified and batch size is not known
+  shape[0] = num_row_;
+  shape[1] = static_cast<int64_t>(output_size_);
+}
+
+void GBDTModel::GetOutput(int index, void* out) {
+  CHECK_GE(num_row_, 0) << "Input is not set.";
+  std::memcpy(out, output_.data(), sizeof(float) * output_.size());
+}
+
+const void* GBDTModel::GetOutputPtr(int index) const {
+  CHECK_GE(num_row_, 0) << "Input is not set.";
+  return output_.data();
+}
+
+void GBDTModel::GetOutputSizeDim(int index, int64_t* size, int* dim) {
+  *size = num_row_ < 0 ? -1 : num_row_ * static_cast<int64_t>(output_size_);
+  *dim = 2;
+}
+
+const char* GBDTModel::GetOutputType(int index) const {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+  return OUTPUT_TYPE.c_str();
+}
+
+void GBDTModel::TraverseTree(const Tree& tree, const float* rows, size_t num_row,
+                             int32_t* leaves) const {
+  const GBDTNode* nodes = nodes_.data();
+  const size_t stride = num_feature_;
+  size_t r = 0;
+#if defined(__AVX2__)
+  // Eight rows per step: gather the current node of each row and its feature value, then
+  // select the child with compare and blend instead of branches.
+  const int* words = reinterpret_cast<const int*>(nodes);
+  const __m256i row_offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                 _mm256_set1_epi32(static_cast<int>(stride)));
+  const __m256i feature_mask = _mm256_set1_epi32(GBDTNode::kFeatureMask);
+  const __m256i default_left_bit = _mm256_set1_epi32(static_cast<int>(GBDTNode::kDefaultLeft));
+  const __m256i zero_missing_bit = _mm256_set1_epi32(GBDTNode::kZeroIsMissing);
+  for (; r + 8 <= num_row; r += 8) {
+    const float* block = rows + r * stride;
+    __m256i idx = _mm256_set1_epi32(tree.root);
+    for (int32_t d = 0; d < tree.depth; ++d) {
+      const __m256i base = _mm256_slli_epi32(idx, 2);
+      const __m256 threshold =
+          _mm256_i32gather_ps(reinterpret_cast<const float*>(words), base, 4);
+      const __m256i feature =
+          _mm256_i32gather_epi32(words, _mm256_add_epi32(base, _mm256_set1_epi32(1)), 4);
+      const __m256i left =
+          _mm256_i32gather_epi32(words, _mm256_add_epi32(base, _mm256_set1_epi32(2)), 4);
+      const __m256i right =
+          _mm256_i32gather_epi32(words, _mm256_add_epi32(base, _mm256_set1_epi32(3)), 4);
+      const __m256 x = _mm256_i32gather_ps(
+          block, _mm256_add_epi32(row_offsets, _mm256_and_si256(feature, feature_mask)), 4);
+      // Ordered comparison, false for NaN.
+      const __m256 less = _mm256_cmp_ps(x, threshold, _CMP_LT_OQ);
+      const __m256 zero_missing = _mm256_and_ps(
+          _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ),
+          _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(feature, zero_missing_bit),
+                                                 zero_missing_bit)));
+      const __m256 missing = _mm256_or_ps(_mm256_cmp_ps(x, x, _CMP_UNORD_Q), zero_missing);
+      const __m256 default_left = _mm256_castsi256_ps(
+          _mm256_cmpeq_epi32(_mm256_and_si256(feature, default_left_bit), default_left_bit));
+      const __m256 go_left = _mm256_blendv_ps(less, default_left, missing);
+      idx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(right),
+                                                 _mm256_castsi256_ps(left), go_left));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(leaves + r), idx);
+  }
+#endif
+  // Step all remaining rows one level at a time, so that their node loads are independent.
+  for (size_t i = r; i < num_row; ++i) leaves[i] = tree.root;
+  for (int32_t d = 0; d < tree.depth; ++d) {
+    for (size_t i = r; i < num_row; ++i) {
+      const GBDTNode& node = nodes[leaves[i]];
+      const float x = rows[i * stride + (node.feature & GBDTNode::kFeatureMask)];
+      const bool missing =
+          std::isnan(x) || (x == 0.0f && (node.feature & GBDTNode::kZeroIsMissing));
+      const bool go_left =
+          missing ? (node.feature & GBDTNode::kDefaultLeft) != 0 : x < node.threshold;
+      leaves[i] = go_left ? node.left : node.right;
+    }
+  }
+}
+
+void GBDTModel::TransformRow(const float* margin, float* out) const {
+  switch (transform_) {
+    case Transform::kIdentity:
+      for (size_t g = 0; g < num_group_; ++g) out[g] = margin[g] * margin_scale_;
+      break;
+    case Transform::kSigmoid:
+      for (size_t g = 0; g < num_group_; ++g) {
+        out[g] = 1.0f / (1.0f + std::exp(-sigmoid_alpha_ * margin[g] * margin_scale_));
+      }
+      break;
+    case Transform::kExp:
+      for (size_t g = 0; g < num_group_; ++g) out[g] = std::exp(margin[g] * margin_scale_);
+      break;
+    case Transform::kSoftmax: {
+      const float max_margin = *std::max_element(margin, margin + num_group_) * margin_scale_;
+      float sum = 0.0f;
+      for (size_t g = 0; g < num_group_; ++g) {
+        out[g] = std::exp(margin[g] * margin_scale_ - max_margin);
+        sum += out[g];
+      }
+      for (size_t g = 0; g < num_group_; ++g) out[g] /= sum;
+      break;
+    }
+    case Transform::kArgmax:
+      out[0] = static_cast<float>(std::max_element(margin, margin + num_group_) - margin);
+      break;
+  }
+}
+
+void GBDTModel::PredictBlock(size_t begin, size_t end) {
+  const size_t num_row = end - begin;
+  float* margin = margin_.data() + begin * num_group_;
+  for (size_t r = 0; r < num_row; ++r) {
+    std::copy(base_margin_.begin(), base_margin_.end(), margin + r * num_group_);
+  }
+  // Every tree is applied to the whole block before the next one, so a tree is loaded into
+  // cache once per block rather than once per row.
+  const float* rows = input_.data() + begin * num_feature_;
+  int32_t leaves[kBlockRows];
+  for (const Tree& tree : trees_) {
+    TraverseTree(tree, rows, num_row, leaves);
+    for (size_t r = 0; r < num_row; ++r) {
+      margin[r * num_group_ + tree.group] += nodes_[leaves[r]].threshold;
+    }
+  }
+  for (size_t r = 0; r < num_row; ++r) {
+    TransformRow(margin + r * num_group_, output_.data() + (begin + r) * output_size_);
+  }
+}
+
+void GBDTModel::Run() {
+  CHECK_GE(num_row_, 0) << "Input is not set.";
+  thread_pool_.Apply();
+  dlr::ParallelFor(num_row_, kRowsPerTask, [this](size_t begin, size_t end) {
+    for (size_t block = begin; block < end; block += kBlockRows) {
+      PredictBlock(block, std::min(end, block + kBlockRows));
+    }
+  });
+}
+
+void GBDTModel::SetNumThreads(int threads) { thread_pool_.SetNumThreads(threads); }
+
+void GBDTModel::UseCPUAffinity(bool use) { thread_pool_.UseCPUAffinity(use); }
@@ -0,0 +1,416 @@
+#include "dlr_image_transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "dlr_thread_pool.h"
+
+using namespace dlr;
+
+namespace {
+
+/*! \brief Output rows per task when preprocessing in parallel. */
+constexpr size_t kRowsPerTask = 16;
+
+/*! \brief Pixels by which a crop may exceed the image, from rounding of float box coordinates. */
+constexpr double kCropTolerance = 1e-3;
+
+/*! \brief Model input dimension, or the config value if it is given or the dimension is dynamic. */
+int64_t GetSize(const nlohmann::json& config, const char* key, int64_t dim) {
+  if (config.count(key)) return config.at(key).get<int64_t>();
+  CHECK_GT(dim, 0) << "Image transform needs " << key << " for an input with dynamic shape.";
+  return dim;
+}
+
+bool IsYUV(ImageView::Format format) {
+  return format == ImageView::Format::kNV12 || format == ImageView::Format::kNV21 ||
+         format == ImageView::Format::kI420;
+}
+
+/*! \brief Values of one pixel in the row buffer. */
+int64_t GetPixelChannels(const ImageView& image) {
+  return image.format == ImageView::Format::kPacked ? image.channels : 3;
+}
+
+float Clamp(float value) { return std::min(std::max(value, 0.0f), 255.0f); }
+
+template <typename T>
+inline T Convert(float value) {
+  return value;
+}
+
+template <>
+inline int8_t Convert<int8_t>(float value) {
+  return std::lrint(std::min(std::max(value, -128.0f), 127.0f));
+}
+
+template <>
+inline uint8_t Convert<uint8_t>(float value) {
+  return std::lrint(std::min(std::max(value, 0.0f), 255.0f));
+}
+
+}  // namespace
+
+ImageTransform::ImageTransform(const nlohmann::json& config, const std::string& input_name,
+                               const std::vector<int64_t>& input_shape)
+    : input_name_(input_name) {
+  CHECK(config.is_object()) << "Image transform must be an object.";
+  CHECK_EQ(input_shape.size(), 4) << "Image transform requires a 4-D input, " << input_name_
+                                  << " has " << input_shape.size() << " dimensions.";
+  const std::string layout = config.value("Layout", "NCHW");
+  if (layout == "NCHW") {
+    layout_ = Layout::kNCHW;
+  } else if (layout == "NHWC") {
+    layout_ = Layout::kNHWC;
+  } else {
+    throw dmlc::Error("Unsupported image transform Layout: " + layout);
+  }
+  const std::string resize = config.value("Resize", "Bilinear");
+  if (resize == "Bilinear") {
+    resize_ = Resize::kBilinear;
+  } else if (resize == "Nearest") {
+    resize_ = Resize::kNearest;
+  } else {
+    throw dmlc::Error("Unsupported image transform Resize: " + resize);
+  }
+  const bool nchw = layout_ == Layout::kNCHW;
+  height_ = GetSize(config, "Height", input_shape[nchw ? 2 : 1]);
+  width_ = GetSize(config, "Width", input_shape[nchw ? 3 : 2]);
+  channels_ = GetSize(config, "Channels", input_shape[nchw ? 1 : 3]);
+  CHECK(height_ > 0 && width_ > 0) << "Image transform Height and Width must be positive.";
+  CHECK(channels_ > 0 && channels_ <= kMaxChannels)
+      << "Image transform supports 1 to " << kMaxChannels << " channels, not " << channels_;
+
+  const std::string order = config.value("ChannelOrder", "RGB");
+  CHECK(order == "RGB" || order == "BGR") << "Unsupported image transform ChannelOrder: " << order;
+  CHECK(order == "RGB" || channels_ >= 3) << "ChannelOrder BGR requires 3 or more channels.";
+  const float scale = config.value("Scale", 1.0f);
+  const std::vector<float> mean = config.value("Mean", std::vector<float>(channels_, 0.0f));
+  const std::vector<float> stddev = config.value("Std", std::vector<float>(channels_, 1.0f));
+  CHECK_EQ(mean.size(), static_cast<size_t>(channels_))
+      << "Image transform Mean must have one value per channel.";
+  CHECK_EQ(stddev.size(), static_cast<size_t>(channels_))
+      << "Image transform Std must have one value per channel.";
+  for (int c = 0; c < channels_; ++c) {
+    CHECK_NE(stddev[c], 0.0f) << "Image transform Std must not be zero.";
+    source_channel_[c] = order == "BGR" && c < 3 ? 2 - c : c;
+    scale_[c] = scale / stddev[c];
+    bias_[c] = -mean[c] / stddev[c];
+  }
+
+  // Luma weights of R and B, from which the conversion matrix follows.
+  const std::string matrix = config.value("YUVMatrix", "BT601");
+  double kr, kb;
+  if (matrix == "BT601") {
+    kr = 0.299;
+    kb = 0.114;
+  } else if (matrix == "BT709") {
+    kr = 0.2126;
+    kb = 0.0722;
+  } else {
+    throw dmlc::Error("Unsupported image transform YUVMatrix: " + matrix);
+  }
+  const std::string range = config.value("YUVRange", "Limited");
+  double chroma;
+  if (range == "Limited") {
+    luma_offset_ = 16.0f;
+    luma_ = 255.0 / 219.0;
+    chroma = 255.0 / 224.0;
+  } else if (range == "Full") {
+    luma_offset_ = 0.0f;
+    luma_ = 1.0f;
+    chroma = 1.0;
+  } else {
+    throw dmlc::Error("Unsupported image transform YUVRange: " + range);
+  }
+  const double kg = 1.0 - kr - kb;
+  rv_ = 2.0 * (1.0 - kr) * chroma;
+  bu_ = 2.0 * (1.0 - kb) * chroma;
+  gu_ = 2.0 * (1.0 - kb) * kb / kg * chroma;
+  gv_ = 2.0 * (1.0 - kr) * kr / kg * chroma;
+
+  const std::string box_order = config.value("BoxOrder", "XYXY");
+  CHECK(box_order == "XYXY" || box_order == "YXYX")
+      << "Unsupported image transform BoxOrder: " << box_order;
+  box_yx_ = box_order == "YXYX";
+  box_normalized_ = config.value("BoxNormalized", false);
+}
+
+std::vector<int64_t> ImageTransform::GetOutputShape(int64_t batch) const {
+  if (layout_ == Layout::kNCHW) return {batch, channels_, height_, width_};
+  return {batch, height_, width_, channels_};
+}
+
+std::vector<int64_t> ImageTransform::GetOutputShape(const int64_t* shape, int dim) const {
+  CHECK(dim == 3 || dim == 4) << "Image input must have shape [H, W, C] or [N, H, W, C].";
+  return GetOutputShape(dim == 4 ? shape[0] : 1);
+}
+
+std::vector<ImageTransform::Tap> ImageTransform::MakeTaps(double origin, double size,
+                                                          int64_t limit,
+                                                          int64_t dst_size) const {
+  // Samples stay within the source pixels the region touches.
+  const int64_t low = std::max<int64_t>(std::floor(origin), 0);
+  const int64_t high = std::min<int64_t>(std::ceil(origin + size), limit) - 1;
+  std::vector<Tap> taps(dst_size);
+  const double scale = size / dst_size;
+  for (int64_t i = 0; i < dst_size; ++i) {
+    // Pixel centers are aligned, as in OpenCV.
+    const double center = origin + (i + 0.5) * scale;
+    if (resize_ == Resize::kNearest) {
+      const int32_t index =
+          std::min(std::max(static_cast<int64_t>(std::floor(center)), low), high);
+      taps[i] = Tap{index, index, 0.0f};
+      continue;
+    }
+    const double src = std::min(std::max(center - 0.5, static_cast<double>(low)),
+                                static_cast<double>(high));
+    const int32_t first = static_cast<int32_t>(src);
+    const int32_t second = std::min<int64_t>(first + 1, high);
+    taps[i] = Tap{first, second, first == second ? 0.0f : static_cast<float>(src - first)};
+  }
+  return taps;
+}
+
+ImageTransform::Plan ImageTransform::MakePlan(const ImageView& image) const {
+  CHECK(image.width > 0 && image.height > 0) << "Image must not be empty.";
+  const int64_t pixel_channels = GetPixelChannels(image);
+  CHECK_EQ(pixel_channels, channels_)
+      << "Image has " << pixel_channels << " channels, but model requires " << channels_;
+  CHECK(image.planes[0] != nullptr) << "Image has no data.";
+  CHECK_GE(image.strides[0], image.width * (IsYUV(image.format) ? 1 : pixel_channels))
+      << "Image row stride is too small.";
+  const int64_t chroma_width = (image.width + 1) / 2;
+  if (image.format == ImageView::Format::kNV12 || image.format == ImageView::Format::kNV21) {
+    CHECK(image.planes[1] != nullptr) << "NV12 image has no UV plane.";
+    CHECK_GE(image.strides[1], 2 * chroma_width) << "Image UV row stride is too small.";
+  } else if (image.format == ImageView::Format::kI420) {
+    CHECK(image.planes[1] != nullptr && image.planes[2] != nullptr)
+        << "I420 image has no U or V plane.";
+    CHECK(image.strides[1] >= chroma_width && image.strides[2] >= chroma_width)
+        << "Image U or V row stride is too small.";
+  }
+
+  double x = 0.0, y = 0.0, width = image.width, height = image.height;
+  if (image.crop_width > 0.0f && image.crop_height > 0.0f) {
+    x = image.crop_x;
+    y = image.crop_y;
+    width = image.crop_width;
+    height = image.crop_height;
+    CHECK(x >= 0.0 && y >= 0.0 && x + width <= image.width + kCropTolerance &&
+          y + height <= image.height + kCropTolerance)
+        << "Crop [" << x << ", " << y << ", " << width << ", " << height
+        << "] is outside the image of size " << image.width << "x" << image.height;
+  }
+  Plan plan;
+  plan.row_taps = MakeTaps(y, height, image.height, height_);
+  plan.col_taps = MakeTaps(x, width, image.width, width_);
+  // col_taps ascend, so the sampled columns are collected in order.
+  for (Tap& tap : plan.col_taps) {
+    if (plan.columns.empty() || plan.columns.back() != tap.first) {
+      plan.columns.push_back(tap.first);
+    }
+    tap.first = plan.columns.size() - 1;
+    if (plan.columns.back() != tap.second) plan.columns.push_back(tap.second);
+    tap.second = plan.columns.size() - 1;
+  }
+  // Unless shrinking by more than half, converting the whole span is cheaper than gathering.
+  const int32_t span = plan.columns.back() - plan.columns.front() + 1;
+  plan.contiguous = static_cast<size_t>(span) <= 2 * plan.columns.size();
+  if (plan.contiguous) {
+    const int32_t front = plan.columns.front();
+    for (Tap& tap : plan.col_taps) {
+      tap.first = plan.columns[tap.first] - front;
+      tap.second = plan.columns[tap.second] - front;
+    }
+    plan.columns.resize(span);
+    for (int32_t j = 0; j < span; ++j) plan.columns[j] = front + j;
+  }
+  plan.pixel_channels = pixel_channels;
+  for (int c = 0; c < channels_; ++c) {
+    const int channel = source_channel_[c];
+    plan.source_channel[c] =
+        image.format == ImageView::Format::kBGR && channel < 3 ? 2 - channel : channel;
+  }
+  return plan;
+}
+
+void ImageTransform::LoadRow(const ImageView& image, const Plan& plan, int64_t y,
+                             float* row) const {
+  const size_t num_columns = plan.columns.size();
+  const int32_t* columns = plan.columns.data();
+  const uint8_t* src = image.planes[0] + y * image.strides[0];
+  if (!IsYUV(image.format)) {
+    const int64_t channels = plan.pixel_channels;
+    if (plan.contiguous) {
+      // One contiguous loop, which the compiler vectorizes.
+      src += columns[0] * channels;
+      const size_t size = num_columns * channels;
+      for (size_t k = 0; k < size; ++k) row[k] = src[k];
+      return;
+    }
+    for (size_t j = 0; j < num_columns; ++j) {
+      const uint8_t* pixel = src + columns[j] * channels;
+      for (int64_t c = 0; c < channels; ++c) row[j * channels + c] = pixel[c];
+    }
+    return;
+  }
+  // Chroma is shared by 2x2 luma pixels. U and V of column x are at (x / 2) * step.
+  const int64_t chroma_y = y / 2;
+  const uint8_t* u;
+  const uint8_t* v;
+  int step = 2;
+  if (image.format == ImageView::Format::kI420) {
+    u = image.planes[1] + chroma_y * image.strides[1];
+    v = image.planes[2] + chroma_y * image.strides[2];
+    step = 1;
+  } else {
+    const uint8_t* uv = image.planes[1] + chroma_y * image.strides[1];
+    const bool nv12 = image.format == ImageView::Format::kNV12;
+    u = nv12 ? uv : uv + 1;
+    v = nv12 ? uv + 1 : uv;
+  }
+  // Y, U and V are stored and blended as they are, and converted by ConvertRow.
+  for (size_t j = 0; j < num_columns; ++j) {
+    const int64_t x = columns[j];
+    const int64_t chroma_x = (x >> 1) * step;
+    row[j * 3] = src[x];
+    row[j * 3 + 1] = u[chroma_x];
+    row[j * 3 + 2] = v[chroma_x];
+  }
+}
+
+void ImageTransform::ConvertRow(size_t num_columns, float* row) const {
+  const float luma = luma_, offset = luma_offset_;
+  const float rv = rv_, gu = gu_, gv = gv_, bu = bu_;
+  for (size_t j = 0; j < num_columns; ++j) {
+    float* pixel = row + j * 3;
+    const float l = luma * (pixel[0] - offset);
+    const float cu = pixel[1] - 128.0f;
+    const float cv = pixel[2] - 128.0f;
+    // Conversion saturates like the 8-bit RGB the model was trained on.
+    pixel[0] = Clamp(l + rv * cv);
+    pixel[1] = Clamp(l - gu * cu - gv * cv);
+    pixel[2] = Clamp(l + bu * cu);
+  }
+}
+
+void ImageTransform::BlendRows(const ImageView& image, const Plan& plan, int64_t y, float* row,
+                               float* other) const {
+  const Tap& tap = plan.row_taps[y];
+  LoadRow(image, plan, tap.first, row);
+  if (tap.weight != 0.0f) {
+    LoadRow(image, plan, tap.second, other);
+    const float weight = tap.weight;
+    const size_t size = plan.columns.size() * plan.pixel_channels;
+    for (size_t k = 0; k < size; ++k) row[k] += weight * (other[k] - row[k]);
+  }
+  if (IsYUV(image.format)) ConvertRow(plan.columns.size(), row);
+}
+
+template <typename T>
+void ImageTransform::WriteRow(const Plan& plan, const float* row, int64_t y, T* out) const {
+  // Sample each model channel horizontally and normalize it.
+  const bool nchw = layout_ == Layout::kNCHW;
+  const int64_t stride = nchw ? 1 : channels_;
+  const int64_t channels = plan.pixel_channels;
+  for (int64_t c = 0; c < channels_; ++c) {
+    T* dst = nchw ? out + (c * height_ + y) * width_ : out + y * width_ * channels_ + c;
+    const float* src = row + plan.source_channel[c];
+    const float scale = scale_[c];
+    const float bias = bias_[c];
+    for (int64_t x = 0; x < width_; ++x) {
+      const Tap& tap = plan.col_taps[x];
+      const float a = src[tap.first * channels];
+      const float b = src[tap.second * channels];
+      dst[x * stride] = Convert<T>((a + tap.weight * (b - a)) * scale + bias);
+    }
+  }
+}
+
+void ImageTransform::Apply(const uint8_t* images, const int64_t* shape, int dim, DLDataType dtype,
+                           void* out) const {
+  CHECK(dim == 3 || dim == 4) << "Image input must have shape [H, W, C] or [N, H, W, C].";
+  const int64_t batch = dim == 4 ? shape[0] : 1;
+  CHECK_GT(batch, 0) << "Image input must not be empty.";
+  std::vector<ImageView> views(batch);
+  const int64_t image_size = shape[dim - 3] * shape[dim - 2] * shape[dim - 1];
+  for (int64_t n = 0; n < batch; ++n) {
+    views[n].channels = shape[dim - 1];
+    views[n].height = shape[dim - 3];
+    views[n].width = shape[dim - 2];
+    views[n].planes[0] = images + n * image_size;
+    views[n].strides[0] = shape[dim - 2] * shape[dim - 1];
+  }
+  Apply(views.data(), batch, dtype, out);
+}
+
+void ImageTransform::Apply(const ImageView* images, int64_t num_images, DLDataType dtype,
+                           void* out) const {
+  CHECK_GT(num_images, 0) << "Image input must not be empty.";
+  // Plans are made in parallel too, as there may be many small crops.
+  std::vector<Plan> plans(num_images);
+  dlr::ParallelFor(num_images, 1, [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; ++n) plans[n] = MakePlan(images[n]);
+  });
+  size_t row_size = 0;
+  for (const Plan& plan : plans) {
+    row_size = std::max(row_size, plan.columns.size() * plan.pixel_channels);
+  }
+  auto apply = [&](auto* data) {
+    const size_t out_size = height_ * width_ * channels_;
+    dlr::ParallelFor(num_images * height_, kRowsPerTask, [&](size_t begin, size_t end) {
+      std::vector<float> row(row_size), other(row_size);
+      for (size_t i = begin; i < end; ++i) {
+        const int64_t n = i / height_;
+        const int64_t y = i % height_;
+        BlendRows(images[n], plans[n], y, row.data(), other.data());
+        WriteRow(plans[n], row.data(), y, data + n * out_size);
+      }
+    });
+  };
+  if (dtype.code == kDLFloat && dtype.bits == 32 && dtype.lanes == 1) {
+    apply(static_cast<float*>(out));
+  } else if (dtype.code == kDLInt && dtype.bits == 8 && dtype.lanes == 1) {
+    apply(static_cast<int8_t*>(out));
+  } else if (dtype.code == kDLUInt && dtype.bits == 8 && dtype.lanes == 1) {
+    apply(static_cast<uint8_t*>(out));
+  } else {
+    throw dmlc::Error("Image transform supports float32, int8 and uint8 inputs only.");
+  }
+}
+
+void ImageTransform::ApplyROIs(const ImageView& frame, const float* boxes, int64_t num_boxes,
+                               int64_t batch, DLDataType dtype, void* out) const {
+  CHECK(num_boxes >= 0 && num_boxes <= batch)
+      << "Number of boxes " << num_boxes << " exceeds the batch size " << batch;
+  CHECK(frame.width > 0 && frame.height > 0) << "Frame must not be empty.";
+  const float width = frame.width;
+  const float height = frame.height;
+  std::vector<ImageView> rois(num_boxes, frame);
+  for (int64_t n = 0; n < num_boxes; ++n) {
+    const float* box = boxes + n * 4;
+    float x1 = box[box_yx_ ? 1 : 0], y1 = box[box_yx_ ? 0 : 1];
+    float x2 = box[box_yx_ ? 3 : 2], y2 = box[box_yx_ ? 2 : 3];
+    if (box_normalized_) {
+      x1 *= width;
+      x2 *= width;
+      y1 *= height;
+      y2 *= height;
+    }
+    // Clip to the frame, keeping at least one pixel so that degenerate boxes still sample it.
+    x1 = std::min(std::max(x1, 0.0f), width - 1.0f);
+    y1 = std::min(std::max(y1, 0.0f), height - 1.0f);
+    x2 = std::min(std::max(x2, x1 + 1.0f), width);
+    y2 = std::min(std::max(y2, y1 + 1.0f), height);
+    rois[n].crop_x = x1;
+    rois[n].crop_y = y1;
+    rois[n].crop_width = x2 - x1;
+    rois[n].crop_height = y2 - y1;
+  }
+  if (num_boxes > 0) Apply(rois.data(), num_boxes, dtype, out);
+  const size_t entry_bytes = height_ * width_ * channels_ * ((dtype.bits * dtype.lanes + 7) / 8);
+  std::memset(static_cast<char*>(out) + num_boxes * entry_bytes, 0,
+              (batch - num_boxes) * entry_bytes);
+}
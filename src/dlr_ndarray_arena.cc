@@ -0,0 +1,118 @@
+#include "dlr_ndarray_arena.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+using namespace dlr;
+
+namespace {
+
+size_t GetNumBytes(const std::vector<int64_t>& shape, DLDataType dtype) {
+  const size_t num_elements =
+      std::accumulate(shape.begin(), shape.end(), int64_t(1), std::multiplies<int64_t>());
+  return num_elements * ((dtype.bits * dtype.lanes + 7) / 8);
+}
+
+bool SameDataType(DLDataType a, DLDataType b) {
+  return a.code == b.code && a.bits == b.bits && a.lanes == b.lanes;
+}
+
+bool SameContext(DLContext a, DLContext b) {
+  return a.device_type == b.device_type && a.device_id == b.device_id;
+}
+
+}  // namespace
+
+tvm::runtime::NDArray NDArrayArena::Get(const std::vector<int64_t>& shape, DLDataType dtype,
+                                        DLContext ctx) {
+  CHECK(!dlr::HasNegative(shape.data(), shape.size())) << "Shape must not be negative.";
+  if (max_buckets_ == 0) {
+    stats_.misses++;
+    return tvm::runtime::NDArray::Empty(shape, dtype, ctx);
+  }
+  const size_t nbytes = GetNumBytes(shape, dtype);
+  Bucket* best = nullptr;
+  for (Bucket& bucket : buckets_) {
+    // Storage still referenced outside the arena, e.g. an earlier input, is busy.
+    if (bucket.storage.use_count() > 1 || !SameContext(bucket.storage->ctx, ctx)) continue;
+    if (bucket.shape == shape && SameDataType(bucket.dtype, dtype)) {
+      best = &bucket;
+      break;
+    }
+    // Only reuse a larger bucket if at least half of its storage is used.
+    if (bucket.nbytes >= nbytes && bucket.nbytes <= 2 * nbytes &&
+        (best == nullptr || bucket.nbytes < best->nbytes)) {
+      best = &bucket;
+    }
+  }
+  if (best != nullptr) {
+    stats_.hits++;
+    best->last_used = ++clock_;
+    if (best->shape == shape && SameDataType(best->dtype, dtype)) {
+      return best->storage;
+    }
+    return best->storage.CreateView(shape, dtype);
+  }
+
+  stats_.misses++;
+  if (buckets_.size() >= max_buckets_) {
+    EvictLeastRecentlyUsed();
+  }
+  Bucket bucket;
+  bucket.shape = shape;
+  bucket.dtype = dtype;
+  bucket.nbytes = nbytes;
+  bucket.last_used = ++clock_;
+  bucket.storage = tvm::runtime::NDArray::Empty(shape, dtype, ctx);
+  buckets_.push_back(bucket);
+  return bucket.storage;
+}
+
+void NDArrayArena::SetMaxBuckets(size_t max_buckets) {
+  max_buckets_ = max_buckets;
+  while (buckets_.size() > max_buckets_) {
+    EvictLeastRecentlyUsed();
+  }
+}
+
+void NDArrayArena::EvictLeastRecentlyUsed() {
+  if (buckets_.empty()) return;
+  auto lru = std::min_element(
+      buckets_.begin(), buckets_.end(),
+      [](const Bucket& a, const Bucket& b) { return a.last_used < b.last_used; });
+  buckets_.erase(lru);
+}
+
+size_t NDArrayArena::GetBytes() const {
+  size_t bytes = 0;
+  for (const Bucket& bucket : buckets_) {
+    bytes += bucket.nbytes;
+  }
+  return bytes;
+}
+
+size_t NDArrayArena::GetIdleBytes() const {
+  size_t bytes = 0;
+  for (const Bucket& bucket : buckets_) {
+    if (bucket.storage.use_count() == 1) bytes += bucket.nbytes;
+  }
+  return bytes;
+}
+
+size_t NDArrayArena::TrimIdle(size_t watermark_bytes) {
+  size_t idle_bytes = GetIdleBytes();
+  size_t released = 0;
+  while (idle_bytes > watermark_bytes) {
+    auto lru = buckets_.end();
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+      if (it->storage.use_count() != 1) continue;
+      if (lru == buckets_.end() || it->last_used < lru->last_used) lru = it;
+    }
+    if (lru == buckets_.end()) break;
+    idle_bytes -= lru->nbytes;
+    released += lru->nbytes;
+    buckets_.erase(lru);
+  }
+  return released;
+}
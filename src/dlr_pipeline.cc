@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <iterator>
@@ -9,15 +10,56 @@
 
 using namespace dlr;
 
+namespace {
+
+/*! \brief Index of an output of model given by name or by index in an "ROI" config. */
+int GetROIOutputIndex(const DLRModelPtr& model, const nlohmann::json& output) {
+  const int index =
+      output.is_string() ? model->GetOutputIndex(output.get<std::string>().c_str())
+                         : output.get<int>();
+  CHECK(index >= 0 && index < model->GetNumOutputs()) << "ROI output " << output << " not found.";
+  return index;
+}
+
+/*! \brief Scalar value of a count output of any numeric type. */
+int64_t ReadCount(const DLRModelPtr& model, int index) {
+  int64_t size;
+  int dim;
+  model->GetOutputSizeDim(index, &size, &dim);
+  CHECK_EQ(size, 1) << "ROI Count output must have one element.";
+  const std::string type = model->GetOutputType(index);
+  // Large enough for any element type; GetOutput copies to CPU memory.
+  int64_t buffer = 0;
+  model->GetOutput(index, &buffer);
+  if (type == "float32") {
+    float count;
+    std::memcpy(&count, &buffer, sizeof(count));
+    return static_cast<int64_t>(count);
+  } else if (type == "int32") {
+    int32_t count;
+    std::memcpy(&count, &buffer, sizeof(count));
+    return count;
+  }
+  CHECK(type == "int64") << "ROI Count output must be float32, int32 or int64, not " << type;
+  return buffer;
+}
+
+}  // namespace
+
 void PipelineModel::CheckModelsCompatibility(const DLRModelPtr& m0, const DLRModelPtr& m1,
                                              const int m1_id, const bool is_runtime_check) {
-  if (!is_runtime_check) {
+  // A model cropping boxes may consume only some outputs of the previous one, such as boxes,
+  // scores and a count for one image input.
+  if (!is_runtime_check && roi_links_[m1_id].input < 0) {
     CHECK_EQ(m0->GetNumOutputs(), m1->GetNumInputs())
         << "Number of outputs/inputs mismatch between models" << m1_id - 1 << " and " << m1_id
         << std::endl;
   }
   // Check each model input
   for (int j = 0; j < m1->GetNumInputs(); j++) {
+    if (IsROIInput(m1_id, j)) continue;
+    CHECK_LT(j, m0->GetNumOutputs()) << "No output #" << j << " of model " << m1_id - 1
+                                     << " for the input of model " << m1_id << std::endl;
     int64_t out_size;
     int out_dim;
     m0->GetOutputSizeDim(j, &out_size, &out_dim);
@@ -54,6 +96,61 @@ void PipelineModel::CheckModelsCompatibility(const DLRModelPtr& m0, const DLRMod
   }
 }
 
+PipelineModel::ROILink PipelineModel::MakeROILink(int m1_id) const {
+  ROILink link;
+  const DLRModelPtr& m0 = dlr_models_[m1_id - 1];
+  const DLRModelPtr& m1 = dlr_models_[m1_id];
+  const int image_input = m1->GetImageInputIndex();
+  if (image_input < 0) return link;
+  const nlohmann::json& config = m1->metadata_.at("DataTransform").at("Input").at("Image");
+  if (!config.count("ROI")) return link;
+  const nlohmann::json& roi = config.at("ROI");
+  CHECK(roi.is_object() && roi.count("Boxes"))
+      << "ROI of model " << m1_id << " must be an object naming the Boxes output.";
+  link.input = image_input;
+  link.boxes = GetROIOutputIndex(m0, roi.at("Boxes"));
+  CHECK_EQ(strcmp(m0->GetOutputType(link.boxes), "float32"), 0)
+      << "ROI Boxes output of model " << m1_id - 1 << " must be float32.";
+  if (roi.count("Count")) link.count = GetROIOutputIndex(m0, roi.at("Count"));
+  if (roi.count("Scores")) {
+    link.scores = GetROIOutputIndex(m0, roi.at("Scores"));
+    CHECK_EQ(strcmp(m0->GetOutputType(link.scores), "float32"), 0)
+        << "ROI Scores output of model " << m1_id - 1 << " must be float32.";
+  }
+  link.score_threshold = roi.value("ScoreThreshold", 0.0f);
+  return link;
+}
+
+int64_t PipelineModel::SelectROIs(const DLRModelPtr& m0, const ROILink& link, int64_t max_boxes,
+                                  const float** boxes) {
+  int64_t size;
+  int dim;
+  m0->GetOutputSizeDim(link.boxes, &size, &dim);
+  std::vector<int64_t> shape(dim, -1);
+  m0->GetOutputShape(link.boxes, shape.data());
+  CHECK(dim > 0 && shape.back() == 4) << "ROI Boxes output must have shape [..., 4].";
+  *boxes = static_cast<const float*>(m0->GetOutputPtr(link.boxes));
+  // Detectors pad their outputs to a fixed number of boxes; only the leading Count are valid.
+  int64_t num_boxes = size / 4;
+  if (link.count >= 0) {
+    num_boxes = std::max<int64_t>(0, std::min(num_boxes, ReadCount(m0, link.count)));
+  }
+  if (link.scores >= 0) {
+    int64_t num_scores;
+    m0->GetOutputSizeDim(link.scores, &num_scores, &dim);
+    CHECK_GE(num_scores, num_boxes) << "ROI Scores output has fewer scores than boxes.";
+    const float* scores = static_cast<const float*>(m0->GetOutputPtr(link.scores));
+    roi_boxes_.clear();
+    for (int64_t b = 0; b < num_boxes; ++b) {
+      if (scores[b] < link.score_threshold) continue;
+      roi_boxes_.insert(roi_boxes_.end(), *boxes + b * 4, *boxes + b * 4 + 4);
+    }
+    *boxes = roi_boxes_.data();
+    num_boxes = roi_boxes_.size() / 4;
+  }
+  return max_boxes >= 0 ? std::min(num_boxes, max_boxes) : num_boxes;
+}
+
 void PipelineModel::SetupPipelineModel() {
   CHECK_GT(dlr_models_.size(), 0) << "List of models is empty";
   count_ = dlr_models_.size();
@@ -65,10 +162,12 @@ void PipelineModel::SetupPipelineModel() {
     input_types_.push_back(dlr_models_[0]->GetInputType(i));
     input_shapes_.push_back(dlr_models_[0]->GetInputShape(i));
   }
+  roi_links_.resize(count_);
   // Check previous model outputs and current model inputs compatibility
   for (int i = 1; i < count_; i++) {
     const DLRModelPtr prev_model = dlr_models_[i - 1];
     const DLRModelPtr curr_model = dlr_models_[i];
+    roi_links_[i] = MakeROILink(i);
     CheckModelsCompatibility(prev_model, curr_model, i /*m1_id*/, false /*is_runtime_check*/);
   }
 }
@@ -96,25 +195,80 @@ const char* PipelineModel::GetWeightName(int index) const {
 }
 
 void PipelineModel::SetInput(const char* name, const int64_t* shape, const void* input, int dim) {
+  frames_.clear();
   dlr_models_[0]->SetInput(name, shape, input, dim);
 }
 
+void PipelineModel::SetInputBatch(const char* name, const void** samples, int n) {
+  frames_.clear();
+  dlr_models_[0]->SetInputBatch(name, samples, n);
+}
+
+void PipelineModel::SetImageInput(const char* name, const ImageView* images, int64_t n) {
+  frames_.clear();
+  dlr_models_[0]->SetImageInput(name, images, n);
+  frames_.assign(images, images + n);
+}
+
+void PipelineModel::SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                                int64_t num_boxes) {
+  frames_.assign(1, frame);
+  dlr_models_[0]->SetROIInput(name, frame, boxes, num_boxes);
+}
+
+int PipelineModel::GetImageInputIndex() const { return dlr_models_[0]->GetImageInputIndex(); }
+
+void PipelineModel::SetSparseInput(const float* data, const uint32_t* col_ind,
+                                   const size_t* row_ptr, size_t num_row, size_t num_col) {
+  frames_.clear();
+  dlr_models_[0]->SetSparseInput(data, col_ind, row_ptr, num_row, num_col);
+}
+
 void PipelineModel::GetInput(const char* name, void* input) {
   dlr_models_[0]->GetInput(name, input);
 }
 
 void PipelineModel::GetOutputShape(int index, int64_t* shape) const {
   dlr_models_.back()->GetOutputShape(index, shape);
+  if (empty_outputs_) {
+    int64_t size;
+    int dim;
+    dlr_models_.back()->GetOutputSizeDim(index, &size, &dim);
+    if (dim > 0) shape[0] = 0;
+  }
 }
 
-void PipelineModel::GetOutput(int index, void* out) { dlr_models_.back()->GetOutput(index, out); }
+void PipelineModel::GetOutput(int index, void* out) {
+  if (empty_outputs_) return;
+  dlr_models_.back()->GetOutput(index, out);
+}
+
+void PipelineModel::GetOutputBatch(int index, void** dests, int n) {
+  CHECK(!empty_outputs_) << "Output " << index << " has no batch, as no box was selected in Run.";
+  dlr_models_.back()->GetOutputBatch(index, dests, n);
+}
+
+void PipelineModel::SetOutputPostprocess(int index, const Postprocess& postprocess) {
+  dlr_models_.back()->SetOutputPostprocess(index, postprocess);
+}
+
+void PipelineModel::GetOutputClassScores(int index, DLRClassScore* results, int64_t capacity,
+                                         int64_t* num_results) {
+  if (empty_outputs_) {
+    *num_results = 0;
+    return;
+  }
+  dlr_models_.back()->GetOutputClassScores(index, results, capacity, num_results);
+}
 
 const void* PipelineModel::GetOutputPtr(int index) const {
+  if (empty_outputs_) return nullptr;
   return dlr_models_.back()->GetOutputPtr(index);
 }
 
 void PipelineModel::GetOutputSizeDim(int index, int64_t* size, int* dim) {
   dlr_models_.back()->GetOutputSizeDim(index, size, dim);
+  if (empty_outputs_) *size = 0;
 }
 
 const char* PipelineModel::GetOutputType(int index) const {
@@ -122,6 +276,7 @@ const char* PipelineModel::GetOutputType(int index) const {
 }
 
 void PipelineModel::Run() {
+  empty_outputs_ = false;
   dlr_models_[0]->Run();
   for (int i = 1; i < count_; i++) {
     const DLRModelPtr prev_model = dlr_models_[i - 1];
@@ -130,6 +285,22 @@ void PipelineModel::Run() {
     // for each model input
     for (int j = 0; j < curr_model->GetNumInputs(); j++) {
       const char* input_name = curr_model->GetInputName(j);
+      if (IsROIInput(i, j)) {
+        // Crop the boxes straight into the batched input, without copies per box.
+        CHECK_EQ(frames_.size(), 1) << "Model " << i << " crops boxes from the pipeline input, "
+                                    << "which requires one frame given to SetImageInput.";
+        // Boxes beyond a static batch size are dropped.
+        const int64_t batch = curr_model->GetInputShape(j)[0];
+        const float* boxes;
+        const int64_t num_boxes = SelectROIs(prev_model, roi_links_[i], batch, &boxes);
+        if (num_boxes == 0) {
+          // Nothing to crop, e.g. a frame without detections: the remaining models are not run.
+          empty_outputs_ = true;
+          return;
+        }
+        curr_model->SetROIInput(input_name, frames_[0], boxes, num_boxes);
+        continue;
+      }
       // Get output shape of previous output.
       int64_t prev_output_size;
       int prev_output_dim;
@@ -177,5 +348,6 @@ int PipelineModel::GetOutputIndex(const char* name) const {
 }
 
 void PipelineModel::GetOutputByName(const char* name, void* out) {
-  return dlr_models_.back()->GetOutputByName(name, out);
+  if (empty_outputs_) return;
+  dlr_models_.back()->GetOutputByName(name, out);
 }
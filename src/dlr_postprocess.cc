@@ -0,0 +1,131 @@
+#include "dlr_postprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "dlr_common.h"
+#include "dlr_thread_pool.h"
+
+using namespace dlr;
+
+namespace {
+
+/*! \brief Independent accumulators of the row reductions. Each one only depends on itself, so the
+ * loops over them vectorize without reassociating float math. */
+constexpr int64_t kLanes = 16;
+
+/*! \brief Logits checked at once against the worst selected score, and skipped if none is above. */
+constexpr int64_t kBlock = 32;
+
+/*! \brief Bits of -87.0f, below which exp underflows the normal floats. */
+constexpr int32_t kMinExpArgBits = static_cast<int32_t>(0xC2AE0000u);
+
+/*! \brief Logits per task when rows are processed in parallel. */
+constexpr int64_t kValuesPerTask = 1 << 16;
+
+/*! \brief Heap order of the selected classes: a before b if it has the higher score, or the same
+ * score and the lower index. */
+inline bool Better(const DLRClassScore& a, const DLRClassScore& b) {
+  return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+/*! \brief Whether any of kBlock values is above threshold. Comparisons are accumulated rather than
+ * branched on, since a float select does not vectorize unless trapping math is disabled. */
+inline bool AnyAbove(const float* values, float threshold) {
+  int32_t above = 0;
+  for (int64_t l = 0; l < kBlock; ++l) above |= values[l] > threshold;
+  return above != 0;
+}
+
+/*! \brief Replace the worst selected class, top[0], if index is better. Later classes with the
+ * same score are not. */
+inline void Offer(int64_t index, float score, DLRClassScore* top, int64_t k) {
+  if (!(score > top[0].score)) return;
+  std::pop_heap(top, top + k, Better);
+  top[k - 1] = {static_cast<int32_t>(index), score};
+  std::push_heap(top, top + k, Better);
+}
+
+/*! \brief Select the k best classes of a row into top, best first. top serves as the heap, so no
+ * memory is allocated. */
+void SelectTopK(const float* row, int64_t n, int64_t k, DLRClassScore* top) {
+  for (int64_t i = 0; i < k; ++i) top[i] = {static_cast<int32_t>(i), row[i]};
+  std::make_heap(top, top + k, Better);
+  int64_t i = k;
+  for (; i + kBlock <= n; i += kBlock) {
+    if (!AnyAbove(row + i, top[0].score)) continue;
+    for (int64_t l = 0; l < kBlock; ++l) Offer(i + l, row[i + l], top, k);
+  }
+  for (; i < n; ++i) Offer(i, row[i], top, k);
+  std::sort_heap(top, top + k, Better);
+}
+
+/*! \brief exp(x) for x <= 0 with a relative error of about 2e-7, branch-free so that loops over it
+ * vectorize. x below -87, -inf included, counts as -87, which is negligible next to the row
+ * maximum's exp(0). */
+inline float ExpNonPositive(float x) {
+  // Clamp on the bits: with the sign bit set, a more negative float is a larger int32.
+  int32_t x_bits;
+  std::memcpy(&x_bits, &x, sizeof(x));
+  x_bits |= std::numeric_limits<int32_t>::min();
+  x_bits = x_bits < kMinExpArgBits ? x_bits : kMinExpArgBits;
+  std::memcpy(&x, &x_bits, sizeof(x));
+  // x = n * ln(2) + r with |r| <= ln(2) / 2, ln(2) split in two parts to keep r exact.
+  const int32_t n = static_cast<int32_t>(x * 1.44269504f - 0.5f);
+  const float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.0f;
+  const int32_t bits = (n + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+float ExpSum(const float* row, int64_t n, float max) {
+  float lanes[kLanes] = {0.0f};
+  int64_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (int64_t l = 0; l < kLanes; ++l) lanes[l] += ExpNonPositive(row[i + l] - max);
+  }
+  float sum = 0.0f;
+  for (; i < n; ++i) sum += ExpNonPositive(row[i] - max);
+  for (int64_t l = 0; l < kLanes; ++l) sum += lanes[l];
+  return sum;
+}
+
+}  // namespace
+
+Postprocess::Postprocess(int64_t top_k, bool softmax) : top_k_(top_k), softmax_(softmax) {
+  CHECK_GT(top_k, 0) << "Postprocess TopK must be positive.";
+}
+
+Postprocess::Postprocess(const nlohmann::json& config)
+    : Postprocess(config.value("TopK", int64_t{1}), config.value("Softmax", false)) {}
+
+void Postprocess::Apply(const float* logits, int64_t num_rows, int64_t num_classes,
+                        DLRClassScore* results) const {
+  CHECK(Enabled()) << "Output post-processing is not configured.";
+  CHECK_LE(num_classes, std::numeric_limits<int32_t>::max()) << "Too many classes.";
+  const int64_t k = GetNumResults(num_classes);
+  if (num_rows <= 0 || k <= 0) return;
+  const size_t min_rows = std::max<int64_t>(kValuesPerTask / num_classes, 1);
+  dlr::ParallelFor(num_rows, min_rows, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      const float* row = logits + r * num_classes;
+      DLRClassScore* top = results + r * k;
+      SelectTopK(row, num_classes, k, top);
+      if (!softmax_) continue;
+      // The best selected class holds the row maximum.
+      const float max = top[0].score;
+      const float sum = ExpSum(row, num_classes, max);
+      for (int64_t i = 0; i < k; ++i) top[i].score = std::exp(top[i].score - max) / sum;
+    }
+  });
+}
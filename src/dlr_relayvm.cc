@@ -2,6 +2,8 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <numeric>
@@ -10,6 +12,117 @@ using namespace dlr;
 
 const std::string RelayVMModel::ENTRY_FUNCTION = "main";
 
+namespace {
+
+/*! \brief Buffers must be aligned like TVM allocations to be used by kernels directly. */
+constexpr size_t kZeroCopyAlignment = 64;
+
+/*! \brief Non-owning DLManagedTensor with its own copy of the shape. */
+struct BorrowedTensor {
+  DLManagedTensor managed;
+  std::vector<int64_t> shape;
+};
+
+void DeleteBorrowedTensor(DLManagedTensor* self) {
+  delete static_cast<BorrowedTensor*>(self->manager_ctx);
+}
+
+/*! \brief Whether the data of two CPU arrays overlaps. */
+bool SharesMemory(const tvm::runtime::NDArray& a, const tvm::runtime::NDArray& b) {
+  const char* a_begin = static_cast<const char*>(a->data) + a->byte_offset;
+  const char* b_begin = static_cast<const char*>(b->data) + b->byte_offset;
+  return a_begin < b_begin + tvm::runtime::GetDataSize(*b.operator->()) &&
+         b_begin < a_begin + tvm::runtime::GetDataSize(*a.operator->());
+}
+
+/*! \brief Map a metadata dtype string to DLDataType. Unknown dtypes get bits == 0. */
+DLDataType ParseDLDataType(const std::string& input_type) {
+  DLDataType dtype;
+  dtype.lanes = 1;
+  if (input_type == "bool") {
+    dtype.code = kDLUInt;
+    dtype.bits = 1;
+  } else if (input_type == "uint8") {
+    dtype.code = kDLUInt;
+    dtype.bits = 8;
+  } else if (input_type == "int8") {
+    dtype.code = kDLInt;
+    dtype.bits = 8;
+  } else if (input_type == "uint16") {
+    dtype.code = kDLUInt;
+    dtype.bits = 16;
+  } else if (input_type == "int16") {
+    dtype.code = kDLInt;
+    dtype.bits = 16;
+  } else if (input_type == "uint32") {
+    dtype.code = kDLUInt;
+    dtype.bits = 32;
+  } else if (input_type == "int32") {
+    dtype.code = kDLInt;
+    dtype.bits = 32;
+  } else if (input_type == "uint64") {
+    dtype.code = kDLUInt;
+    dtype.bits = 64;
+  } else if (input_type == "int64") {
+    dtype.code = kDLInt;
+    dtype.bits = 64;
+  } else if (input_type == "float16") {
+    dtype.code = kDLFloat;
+    dtype.bits = 16;
+  } else if (input_type == "bfloat16") {
+    dtype.code = kDLBfloat;
+    dtype.bits = 16;
+  } else if (input_type == "float32") {
+    dtype.code = kDLFloat;
+    dtype.bits = 32;
+  } else if (input_type == "float64") {
+    dtype.code = kDLFloat;
+    dtype.bits = 64;
+  } else {
+    dtype.code = kDLUInt;
+    dtype.bits = 0;
+  }
+  return dtype;
+}
+
+}  // namespace
+
+namespace dlr {
+
+/*! \brief Relay VM whose storage comes from memory pools owned by the model. */
+class RelayVirtualMachine : public tvm::runtime::vm::VirtualMachine {
+ public:
+  /*! \brief Replace the process-wide allocators chosen by init with one new pool per context in
+   * ctxs, which must be the devices the VM was initialized with.
+   */
+  std::vector<VMMemoryPool*> UseOwnPools(const std::vector<DLContext>& ctxs) {
+    std::vector<VMMemoryPool*> pools;
+    for (const DLContext& ctx : ctxs) {
+      size_t i = 0;
+      while (i < allocators_.size() &&
+             (allocators_[i] == nullptr || ctxs_[i].device_type != ctx.device_type ||
+              ctxs_[i].device_id != ctx.device_id)) {
+        i++;
+      }
+      CHECK_LT(i, allocators_.size()) << "The VM was not initialized for device "
+                                      << ctx.device_type << ":" << ctx.device_id << ".";
+      pools.push_back(new VMMemoryPool(ctx));
+      allocators_[i] = pools.back();
+    }
+    return pools;
+  }
+
+  /*! \brief Drop the reference set_input kept to input index of func_name. */
+  void ReleaseInput(const std::string& func_name, int index) {
+    auto it = inputs_.find(func_name);
+    if (it != inputs_.end() && index < it->second.size()) {
+      it->second[index] = tvm::runtime::ObjectRef();
+    }
+  }
+};
+
+}  // namespace dlr
+
 void RelayVMModel::SetupVMModule(const std::vector<std::string>& files) {
   ModelPath path;
   dlr::InitModelPath(files, &path);
@@ -75,12 +188,17 @@ void RelayVMModel::SetupVMModule(const std::vector<DLRModelElem>& model_elems) {
 
   LoadJsonFromString(metadata_data, this->metadata_);
   ValidateDeviceTypeIfExists();
+  has_input_transform_ = HasMetadata() && data_transform_.HasInputTransform(metadata_);
+  if (has_input_transform_) {
+    data_transform_.CompileInputTransform(metadata_);
+  }
 
   tvm::runtime::Module lib = tvm::runtime::Module::LoadFromFile(model_lib_path);
 
   vm_executable_ =
       std::make_shared<tvm::runtime::Module>(tvm::runtime::vm::Executable::Load(code_data, lib));
-  auto vm = tvm::runtime::make_object<tvm::runtime::vm::VirtualMachine>();
+  auto vm = tvm::runtime::make_object<RelayVirtualMachine>();
+  vm_ = vm.get();
   vm->LoadExecutable(static_cast<tvm::runtime::vm::Executable*>(
       const_cast<tvm::runtime::Object*>(vm_executable_->get())));
   vm_module_ = std::make_shared<tvm::runtime::Module>(tvm::runtime::Module(vm));
@@ -96,6 +214,22 @@ void RelayVMModel::SetupVMModule(const std::vector<DLRModelElem>& model_elems) {
          static_cast<int>(DLDeviceType::kDLCPU), 0,
          static_cast<int>(tvm::runtime::vm::AllocatorType::kPooled));
   }
+  set_input_ = vm_module_->GetFunction("set_input");
+  invoke_ = vm_module_->GetFunction("invoke");
+
+  memory_ctxs_.push_back(ctx_);
+  if (ctx_.device_type != DLDeviceType::kDLCPU) {
+    memory_ctxs_.push_back(DLContext{DLDeviceType::kDLCPU, 0});
+  }
+  vm_pools_ = vm_->UseOwnPools(memory_ctxs_);
+  peak_bytes_.resize(memory_ctxs_.size(), 0);
+}
+
+RelayVMModel::~RelayVMModel() {
+  // Outputs may still hold pool blocks, the pools delete themselves once those are freed.
+  for (VMMemoryPool* pool : vm_pools_) {
+    pool->Detach();
+  }
 }
 
 void RelayVMModel::FetchInputNodesData() {
@@ -106,6 +240,13 @@ void RelayVMModel::FetchInputNodesData() {
   input_types_.resize(num_inputs_);
   input_shapes_.resize(num_inputs_);
   inputs_.resize(num_inputs_);
+  input_arenas_.resize(num_inputs_);
+  input_borrowed_.resize(num_inputs_, false);
+  input_dtypes_.resize(num_inputs_);
+  set_input_values_.resize(num_inputs_ + 1);
+  set_input_type_codes_.resize(num_inputs_ + 1);
+  tvm::runtime::TVMArgsSetter(set_input_values_.data(), set_input_type_codes_.data())(
+      0, ENTRY_FUNCTION);
 
   try {
     for (int i = 0; i < num_inputs_; i++) {
@@ -116,10 +257,15 @@ void RelayVMModel::FetchInputNodesData() {
     }
     for (int i = 0; i < num_inputs_; i++) {
       input_types_[i] = metadata_.at("Model").at("Inputs").at(i).at("dtype");
+      input_dtypes_[i] = ParseDLDataType(input_types_[i]);
     }
   } catch (nlohmann::json::out_of_range& e) {
     throw dmlc::Error(std::string("Invalid or missing input metadata: ") + e.what());
   }
+  input_indices_ = MakeIndexMap(input_names_);
+  if (data_transform_.HasImageTransform(metadata_)) {
+    data_transform_.CompileImageTransform(metadata_, input_names_, input_shapes_);
+  }
 }
 
 void RelayVMModel::FetchOutputNodesData() {
@@ -146,10 +292,16 @@ void RelayVMModel::FetchOutputNodesData() {
   } catch (nlohmann::json::out_of_range& e) {
     throw dmlc::Error("No output metadata found.");
   }
+  output_indices_ = MakeIndexMap(output_names_);
+  has_output_transform_.resize(num_outputs_);
+  for (int i = 0; i < num_outputs_; i++) {
+    has_output_transform_[i] = data_transform_.HasOutputTransform(metadata_, i);
+    if (has_output_transform_[i]) data_transform_.CompileOutputTransform(metadata_, i);
+  }
 }
 
 const char* RelayVMModel::GetInputName(int index) const {
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     return "input";
   }
   CHECK_LT(index, num_inputs_) << "Input index is out of range.";
@@ -157,10 +309,11 @@ const char* RelayVMModel::GetInputName(int index) const {
 }
 
 const char* RelayVMModel::GetInputType(int index) const {
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     return "json";
   }
   CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+  if (index == data_transform_.GetImageInputIndex()) return "uint8";
   return input_types_[index].c_str();
 }
 
@@ -171,12 +324,13 @@ std::vector<std::string> RelayVMModel::GetWeightNames() const {
 }
 
 void RelayVMModel::GetInput(const char* name, void* input) {
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     LOG(WARNING) << "GetInput is not supported for this model.";
     return;
   }
   int index = GetInputIndex(name);
   auto in_array = inputs_[index];
+  CHECK(in_array.defined()) << "Input " << name << " is not set.";
   DLTensor input_tensor;
   input_tensor.data = input;
   input_tensor.ctx = ctx_;
@@ -189,16 +343,12 @@ void RelayVMModel::GetInput(const char* name, void* input) {
 }
 
 int RelayVMModel::GetInputIndex(const char* name) const {
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     return 0;
   }
-  std::string input_name(name);
-  for (auto i = 0; i < num_inputs_; i++) {
-    if (input_name == input_names_[i]) {
-      return i;
-    }
-  }
-  throw dmlc::Error("Invalid input node name!");
+  const int index = FindIndex(input_indices_, name);
+  if (index < 0) throw dmlc::Error("Invalid input node name!");
+  return index;
 }
 
 const int RelayVMModel::GetInputDim(int index) const {
@@ -213,58 +363,17 @@ const int64_t RelayVMModel::GetInputSize(int index) const {
                          std::multiplies<int64_t>());
 }
 
-DLDataType RelayVMModel::GetInputDLDataType(int index) {
-  auto input_type = input_types_[index];
-  DLDataType dtype;
-  dtype.lanes = 1;
-  if (input_type == "bool") {
-    dtype.code = kDLUInt;
-    dtype.bits = 1;
-  } else if (input_type == "uint8") {
-    dtype.code = kDLUInt;
-    dtype.bits = 8;
-  } else if (input_type == "int8") {
-    dtype.code = kDLInt;
-    dtype.bits = 8;
-  } else if (input_type == "uint16") {
-    dtype.code = kDLUInt;
-    dtype.bits = 16;
-  } else if (input_type == "int16") {
-    dtype.code = kDLInt;
-    dtype.bits = 16;
-  } else if (input_type == "uint32") {
-    dtype.code = kDLUInt;
-    dtype.bits = 32;
-  } else if (input_type == "int32") {
-    dtype.code = kDLInt;
-    dtype.bits = 32;
-  } else if (input_type == "uint64") {
-    dtype.code = kDLUInt;
-    dtype.bits = 64;
-  } else if (input_type == "int64") {
-    dtype.code = kDLInt;
-    dtype.bits = 64;
-  } else if (input_type == "float16") {
-    dtype.code = kDLFloat;
-    dtype.bits = 16;
-  } else if (input_type == "bfloat16") {
-    dtype.code = kDLBfloat;
-    dtype.bits = 16;
-  } else if (input_type == "float32") {
-    dtype.code = kDLFloat;
-    dtype.bits = 32;
-  } else if (input_type == "float64") {
-    dtype.code = kDLBfloat;
-    dtype.bits = 64;
-  } else {
-    throw dmlc::Error(std::string("Unknown input dtype: ") + input_type);
+DLDataType RelayVMModel::GetInputDLDataType(int index) const {
+  const DLDataType& dtype = input_dtypes_[index];
+  if (dtype.bits == 0) {
+    throw dmlc::Error(std::string("Unknown input dtype: ") + input_types_[index]);
   }
   return dtype;
 }
 
 void RelayVMModel::SetInput(const char* name, const int64_t* shape, const void* input, int dim) {
   // Handle string input.
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     std::vector<DLDataType> dtypes;
     for (size_t i = 0; i < num_inputs_; ++i) {
       dtypes.emplace_back(GetInputDLDataType(i));
@@ -274,6 +383,12 @@ void RelayVMModel::SetInput(const char* name, const int64_t* shape, const void*
   }
   int index = GetInputIndex(name);
   DLDataType dtype = GetInputDLDataType(index);
+  if (index == data_transform_.GetImageInputIndex()) {
+    // Preprocess uint8 images straight into the input storage.
+    inputs_[index] = GetInputStorage(index, data_transform_.GetImageShape(shape, dim), dtype);
+    data_transform_.TransformImage(shape, input, dim, inputs_[index]);
+    return;
+  }
   DLTensor input_tensor;
   input_tensor.data = const_cast<void*>(input);
   input_tensor.ctx = DLContext{DLDeviceType::kDLCPU, 0};
@@ -282,16 +397,17 @@ void RelayVMModel::SetInput(const char* name, const int64_t* shape, const void*
   input_tensor.strides = nullptr;
   input_tensor.byte_offset = 0;
   input_tensor.dtype = dtype;
+  if (BorrowInput(index, input_tensor)) return;
   std::vector<int64_t> arr_shape(shape, shape + dim);
 
-  tvm::runtime::NDArray input_arr = tvm::runtime::NDArray::Empty(arr_shape, dtype, ctx_);
+  tvm::runtime::NDArray input_arr = GetInputStorage(index, arr_shape, dtype);
   input_arr.CopyFrom(&input_tensor);
   inputs_[index] = input_arr;
 }
 
 void RelayVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
   // Handle string input.
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     std::vector<DLDataType> dtypes;
     for (size_t i = 0; i < num_inputs_; ++i) {
       dtypes.emplace_back(GetInputDLDataType(i));
@@ -302,38 +418,257 @@ void RelayVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
   }
 
   int index = GetInputIndex(name);
+  if (index > -1 && index == data_transform_.GetImageInputIndex()) {
+    CHECK_EQ(tensor->ctx.device_type, kDLCPU) << "Image input must be in CPU memory.";
+    SetInput(name, tensor->shape, static_cast<const char*>(tensor->data) + tensor->byte_offset,
+             tensor->ndim);
+    return;
+  }
   if (index > -1) {
+    if (BorrowInput(index, *tensor)) return;
     std::vector<int64_t> arr_shape(tensor->shape, tensor->shape + tensor->ndim);
-    tvm::runtime::NDArray input_arr = tvm::runtime::NDArray::Empty(arr_shape, tensor->dtype, ctx_);
+    tvm::runtime::NDArray input_arr = GetInputStorage(index, arr_shape, tensor->dtype);
     input_arr.CopyFrom(tensor);
     inputs_[index] = input_arr;
   }
 }
 
+void RelayVMModel::SetImageInput(const char* name, const ImageView* images, int64_t n) {
+  int index = GetInputIndex(name);
+  CHECK(index > -1 && index == data_transform_.GetImageInputIndex())
+      << "Input " << name << " has no Image transform.";
+  inputs_[index] =
+      GetInputStorage(index, data_transform_.GetImageShape(n), GetInputDLDataType(index));
+  data_transform_.TransformImage(images, n, inputs_[index]);
+}
+
+void RelayVMModel::SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                               int64_t num_boxes) {
+  int index = GetInputIndex(name);
+  CHECK(index > -1 && index == data_transform_.GetImageInputIndex())
+      << "Input " << name << " has no Image transform.";
+  // A static batch is padded with zeroed entries, a dynamic one holds the boxes only.
+  const int64_t batch = input_shapes_[index][0] > 0 ? input_shapes_[index][0] : num_boxes;
+  CHECK_GT(batch, 0) << "ROI input with a dynamic batch requires at least one box.";
+  inputs_[index] =
+      GetInputStorage(index, data_transform_.GetImageShape(batch), GetInputDLDataType(index));
+  data_transform_.TransformROIs(frame, boxes, num_boxes, inputs_[index]);
+}
+
+int RelayVMModel::GetImageInputIndex() const { return data_transform_.GetImageInputIndex(); }
+
+void RelayVMModel::SetInputBatch(const char* name, const void** samples, int n) {
+  CHECK_GT(n, 0) << "Number of samples must be positive.";
+  CHECK(!has_input_transform_)
+      << "Input transforms are not supported with SetInputBatch.";
+  int index = GetInputIndex(name);
+  CHECK_NE(index, data_transform_.GetImageInputIndex())
+      << "Image transforms are not supported with SetInputBatch.";
+  // Batch dimension comes from the caller, the rest of the shape from metadata.
+  std::vector<int64_t> arr_shape = input_shapes_[index];
+  CHECK_GT(arr_shape.size(), 0) << "SetInputBatch requires an input with a batch dimension.";
+  CHECK(!dlr::HasNegative(arr_shape.data() + 1, arr_shape.size() - 1))
+      << "SetInputBatch requires static non-batch dimensions for input " << name;
+  arr_shape[0] = n;
+  DLDataType dtype = GetInputDLDataType(index);
+
+  tvm::runtime::NDArray input_arr = GetInputStorage(index, arr_shape, dtype);
+  const size_t sample_bytes = tvm::runtime::GetDataSize(*input_arr.operator->()) / n;
+  if (ctx_.device_type == kDLCPU) {
+    dlr::GatherBatch(samples, n, sample_bytes, input_arr->data);
+  } else {
+    tvm::runtime::NDArray staging =
+        tvm::runtime::NDArray::Empty(arr_shape, dtype, DLContext{kDLCPU, 0});
+    dlr::GatherBatch(samples, n, sample_bytes, staging->data);
+    input_arr.CopyFrom(staging);
+  }
+  inputs_[index] = input_arr;
+}
+
+int64_t RelayVMModel::Warmup(const std::vector<std::vector<std::vector<int64_t>>>& shape_sets) {
+  CHECK(!has_input_transform_)
+      << "Warmup is not supported for models with input transforms.";
+  std::vector<std::vector<std::vector<int64_t>>> sets = shape_sets;
+  if (sets.empty()) {
+    sets.push_back(input_shapes_);
+  }
+  const std::vector<tvm::runtime::NDArray> saved_inputs = inputs_;
+  const std::vector<bool> saved_borrowed = input_borrowed_;
+  std::fill(input_borrowed_.begin(), input_borrowed_.end(), false);
+  for (const auto& shapes : sets) {
+    CHECK_EQ(shapes.size(), num_inputs_) << "Each warmup shape set needs one shape per input.";
+    for (int i = 0; i < num_inputs_; i++) {
+      CHECK(!dlr::HasNegative(shapes[i].data(), shapes[i].size()))
+          << "Warmup shape for input " << input_names_[i] << " is not concrete.";
+      DLDataType dtype = GetInputDLDataType(i);
+      // Not taken from the input arena, which may hold the inputs that are restored below.
+      tvm::runtime::NDArray input_arr = tvm::runtime::NDArray::Empty(shapes[i], dtype, ctx_);
+      if (ctx_.device_type == kDLCPU) {
+        std::memset(input_arr->data, 0, tvm::runtime::GetDataSize(*input_arr.operator->()));
+      } else {
+        tvm::runtime::NDArray zeros =
+            tvm::runtime::NDArray::Empty(shapes[i], dtype, DLContext{kDLCPU, 0});
+        std::memset(zeros->data, 0, tvm::runtime::GetDataSize(*zeros.operator->()));
+        input_arr.CopyFrom(zeros);
+      }
+      inputs_[i] = input_arr;
+    }
+    Run();
+  }
+  inputs_ = saved_inputs;
+  input_borrowed_ = saved_borrowed;
+  return GetVMPoolBytes();
+}
+
+int64_t RelayVMModel::GetVMPoolBytes() const {
+  int64_t bytes = 0;
+  for (const VMMemoryPool* pool : vm_pools_) {
+    bytes += pool->UsedMemory();
+  }
+  return bytes;
+}
+
+int64_t RelayVMModel::GetInputArenaBytes() const {
+  int64_t bytes = 0;
+  for (const auto& arena : input_arenas_) {
+    bytes += arena.GetBytes();
+  }
+  return bytes;
+}
+
+void RelayVMModel::UpdatePeakMemory() {
+  for (size_t i = 0; i < vm_pools_.size(); i++) {
+    int64_t bytes = vm_pools_[i]->UsedMemory();
+    // Input arenas allocate on ctx_, which is always the first device.
+    if (i == 0) bytes += GetInputArenaBytes();
+    peak_bytes_[i] = std::max(peak_bytes_[i], bytes);
+  }
+}
+
+std::vector<DLRMemoryStats> RelayVMModel::GetMemoryStats() {
+  UpdatePeakMemory();
+  std::vector<DLRMemoryStats> stats(memory_ctxs_.size());
+  for (size_t i = 0; i < memory_ctxs_.size(); i++) {
+    stats[i].device_type = static_cast<int>(memory_ctxs_[i].device_type);
+    stats[i].device_id = memory_ctxs_[i].device_id;
+    stats[i].current_bytes = vm_pools_[i]->UsedMemory();
+    stats[i].peak_bytes = peak_bytes_[i];
+    stats[i].cached_bytes = vm_pools_[i]->GetIdleBytes();
+  }
+  stats[0].current_bytes += GetInputArenaBytes();
+  for (const auto& arena : input_arenas_) {
+    stats[0].cached_bytes += arena.GetIdleBytes();
+  }
+  return stats;
+}
+
+void RelayVMModel::TrimMemory(int64_t watermark_bytes) {
+  CHECK_GE(watermark_bytes, 0) << "watermark_bytes must not be negative.";
+  UpdatePeakMemory();
+  for (size_t i = 0; i < vm_pools_.size(); i++) {
+    size_t remaining = static_cast<size_t>(watermark_bytes);
+    // Input arenas allocate on ctx_, the first device, and keep their budget first since their
+    // storage is reused by every SetInput.
+    if (i == 0) {
+      for (auto& arena : input_arenas_) {
+        arena.TrimIdle(remaining);
+        remaining -= std::min(remaining, arena.GetIdleBytes());
+      }
+    }
+    vm_pools_[i]->TrimIdle(remaining);
+  }
+}
+
+void RelayVMModel::SetZeroCopyInput(bool enable) { zero_copy_input_ = enable; }
+
+bool RelayVMModel::BorrowInput(int index, const DLTensor& tensor) {
+  input_borrowed_[index] = false;
+  if (!zero_copy_input_ || ctx_.device_type != kDLCPU || tensor.ctx.device_type != kDLCPU) {
+    return false;
+  }
+  // Sub-byte and vector types have no plain element layout in caller memory.
+  if (tensor.dtype.bits % 8 != 0 || tensor.dtype.lanes != 1 || tensor.strides != nullptr) {
+    return false;
+  }
+  const char* data = static_cast<const char*>(tensor.data) + tensor.byte_offset;
+  if (reinterpret_cast<uintptr_t>(data) % kZeroCopyAlignment != 0) return false;
+
+  BorrowedTensor* borrowed = new BorrowedTensor();
+  borrowed->shape.assign(tensor.shape, tensor.shape + tensor.ndim);
+  borrowed->managed.dl_tensor = tensor;
+  borrowed->managed.dl_tensor.data = const_cast<char*>(data);
+  borrowed->managed.dl_tensor.byte_offset = 0;
+  borrowed->managed.dl_tensor.shape = borrowed->shape.data();
+  borrowed->managed.manager_ctx = borrowed;
+  borrowed->managed.deleter = DeleteBorrowedTensor;
+  inputs_[index] = tvm::runtime::NDArray::FromDLPack(&borrowed->managed);
+  input_borrowed_[index] = true;
+  return true;
+}
+
+void RelayVMModel::ReleaseBorrowedInputs() {
+  if (std::none_of(input_borrowed_.begin(), input_borrowed_.end(), [](bool b) { return b; })) {
+    return;
+  }
+  // Outputs such as reshapes of an input share its memory, they get their own copy.
+  for (tvm::runtime::NDArray& output : outputs_) {
+    if (!output.defined() || output->ctx.device_type != kDLCPU) continue;
+    for (int i = 0; i < num_inputs_; i++) {
+      if (input_borrowed_[i] && SharesMemory(output, inputs_[i])) {
+        output = output.CopyTo(output->ctx);
+        break;
+      }
+    }
+  }
+  output_ref_ = tvm::runtime::ObjectRef();
+  for (int i = 0; i < num_inputs_; i++) {
+    if (input_borrowed_[i]) {
+      ReleaseInput(i);
+      input_borrowed_[i] = false;
+    }
+  }
+}
+
+void RelayVMModel::ReleaseInput(int index) {
+  inputs_[index] = tvm::runtime::NDArray();
+  vm_->ReleaseInput(ENTRY_FUNCTION, index);
+}
+
+tvm::runtime::NDArray RelayVMModel::GetInputStorage(int index, const std::vector<int64_t>& shape,
+                                                     DLDataType dtype) {
+  // The arena only reuses storage nothing else refers to, so the previous input is dropped first.
+  ReleaseInput(index);
+  input_borrowed_[index] = false;
+  return input_arenas_[index].Get(shape, dtype, ctx_);
+}
+
 void RelayVMModel::UpdateInputs() {
-  const int kNumArgs = num_inputs_ + 1;
-  TVMValue* values = (TVMValue*)malloc(sizeof(TVMValue) * kNumArgs);
-  int* type_codes = (int*)malloc(sizeof(int) * kNumArgs);
-  auto arg_setter = tvm::runtime::TVMArgsSetter(values, type_codes);
-  arg_setter(0, ENTRY_FUNCTION);
+  auto arg_setter =
+      tvm::runtime::TVMArgsSetter(set_input_values_.data(), set_input_type_codes_.data());
   for (int i = 0; i < inputs_.size(); i++) {
+    CHECK(inputs_[i].defined()) << "Input " << input_names_[i] << " is not set.";
     arg_setter(i + 1, inputs_[i]);
   }
-
-  tvm::runtime::PackedFunc set_input = vm_module_->GetFunction("set_input");
   tvm::runtime::TVMRetValue rv;
-  set_input.CallPacked(tvm::runtime::TVMArgs(values, type_codes, kNumArgs), &rv);
-
-  free(values);
-  free(type_codes);
+  set_input_.CallPacked(tvm::runtime::TVMArgs(set_input_values_.data(),
+                                              set_input_type_codes_.data(), num_inputs_ + 1),
+                        &rv);
 }
 
 void RelayVMModel::Run() {
   // Invoke inference
-  UpdateInputs();
-  tvm::runtime::PackedFunc invoke = vm_module_->GetFunction("invoke");
-  output_ref_ = invoke(ENTRY_FUNCTION);
-  UpdateOutputs();
+  thread_pool_config_.Apply();
+  try {
+    UpdateInputs();
+    output_ref_ = invoke_(ENTRY_FUNCTION);
+    UpdateOutputs();
+  } catch (...) {
+    // Caller buffers are only guaranteed to live until Run returns, failed or not.
+    ReleaseBorrowedInputs();
+    throw;
+  }
+  ReleaseBorrowedInputs();
+  UpdatePeakMemory();
 }
 
 void RelayVMModel::UpdateOutputs() {
@@ -350,19 +685,28 @@ void RelayVMModel::UpdateOutputs() {
   }
   // Apply DataTransform if needed.
   for (size_t i = 0; i < outputs_.size(); ++i) {
-    if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, i)) {
+    if (has_output_transform_[i]) {
       data_transform_.TransformOutput(metadata_, i, outputs_[i]);
     }
   }
 }
 
+tvm::runtime::NDArray RelayVMModel::GetOutput(int index) {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+  CHECK(!has_output_transform_[index])
+      << "Output transforms are not supported with GetOutput to an NDArray.";
+  CHECK_LT(index, outputs_.size()) << "Output " << index << " is not available before Run.";
+  return outputs_[index];
+}
+
 void RelayVMModel::GetOutput(int index, void* output) {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
-  auto out_array = outputs_[index];
-  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+  if (has_output_transform_[index]) {
     data_transform_.GetOutput(index, output);
     return;
   }
+  CHECK_LT(index, outputs_.size()) << "Output " << index << " is not available before Run.";
+  auto out_array = outputs_[index];
   DLTensor output_tensor;
   output_tensor.data = output;
   output_tensor.ctx = DLContext{DLDeviceType::kDLCPU, 0};
@@ -374,18 +718,36 @@ void RelayVMModel::GetOutput(int index, void* output) {
   out_array.CopyTo(&output_tensor);
 }
 
+void RelayVMModel::GetOutputBatch(int index, void** dests, int n) {
+  CHECK_GT(n, 0) << "Number of samples must be positive.";
+  CHECK_LT(index, outputs_.size()) << "Output index is out of range.";
+  CHECK(!has_output_transform_[index])
+      << "Output transforms are not supported with GetOutputBatch.";
+  tvm::runtime::NDArray out_array = outputs_[index];
+  CHECK_GT(out_array->ndim, 0) << "GetOutputBatch requires an output with a batch dimension.";
+  CHECK_SHAPE("Mismatch found in output batch size", static_cast<int64_t>(n),
+              out_array->shape[0]);
+  if (out_array->ctx.device_type != kDLCPU) {
+    out_array = out_array.CopyTo(DLContext{kDLCPU, 0});
+  }
+  const size_t sample_bytes = tvm::runtime::GetDataSize(*out_array.operator->()) / n;
+  dlr::ScatterBatch(static_cast<const char*>(out_array->data) + out_array->byte_offset, n,
+                    sample_bytes, dests);
+}
+
 const void* RelayVMModel::GetOutputPtr(int index) const {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
-  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+  if (has_output_transform_[index]) {
     return data_transform_.GetOutputPtr(index);
   }
+  CHECK_LT(index, outputs_.size()) << "Output " << index << " is not available before Run.";
   return outputs_[index]->data;
 }
 
 void RelayVMModel::GetOutputManagedTensorPtr(int index, const DLManagedTensor** out) {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
   auto out_array = outputs_[index];
-  CHECK(!(HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)))
+  CHECK(!has_output_transform_[index])
       << "Output transforms are not supported with GetOutputManagedTensor.";
   *out = out_array.ToDLPack();
 }
@@ -393,7 +755,7 @@ void RelayVMModel::GetOutputManagedTensorPtr(int index, const DLManagedTensor**
 void RelayVMModel::GetOutputTensor(int index, DLTensor* out) {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
   auto out_array = outputs_[index];
-  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+  if (has_output_transform_[index]) {
     data_transform_.GetOutput(index, out->data);
     return;
   }
@@ -402,7 +764,7 @@ void RelayVMModel::GetOutputTensor(int index, DLTensor* out) {
 
 void RelayVMModel::GetOutputShape(int index, int64_t* shape) const {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
-  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+  if (has_output_transform_[index]) {
     data_transform_.GetOutputShape(index, shape);
     return;
   }
@@ -418,7 +780,7 @@ void RelayVMModel::GetOutputShape(int index, int64_t* shape) const {
 
 void RelayVMModel::GetOutputSizeDim(int index, int64_t* size, int* dim) {
   CHECK_LT(index, output_shapes_.size()) << "Output index is out of range.";
-  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+  if (has_output_transform_[index]) {
     data_transform_.GetOutputSizeDim(index, size, dim);
     return;
   }
@@ -444,15 +806,30 @@ void RelayVMModel::GetOutputSizeDim(int index, int64_t* size, int* dim) {
 
 const char* RelayVMModel::GetOutputType(int index) const {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
-  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+  if (has_output_transform_[index]) {
     return "json";
   }
   return output_types_[index].c_str();
 }
 
-void RelayVMModel::SetNumThreads(int threads) { throw dmlc::Error("Not Implemented!"); }
+void RelayVMModel::SetNumThreads(int threads) { thread_pool_config_.SetNumThreads(threads); }
+
+void RelayVMModel::UseCPUAffinity(bool use) { thread_pool_config_.UseCPUAffinity(use); }
+
+void RelayVMModel::SetInputArenaMaxBuckets(size_t max_buckets) {
+  for (auto& arena : input_arenas_) {
+    arena.SetMaxBuckets(max_buckets);
+  }
+}
 
-void RelayVMModel::UseCPUAffinity(bool use) { throw dmlc::Error("Not Implemented!"); }
+NDArrayArenaStats RelayVMModel::GetInputArenaStats() const {
+  NDArrayArenaStats stats;
+  for (const auto& arena : input_arenas_) {
+    stats.hits += arena.GetStats().hits;
+    stats.misses += arena.GetStats().misses;
+  }
+  return stats;
+}
 
 const char* RelayVMModel::GetOutputName(const int index) const {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
@@ -463,13 +840,8 @@ int RelayVMModel::GetOutputIndex(const char* name) const {
   if (!this->HasMetadata()) {
     throw dmlc::Error("No metadata file was found!");
   }
-  for (int i = 0; i < this->num_outputs_; i++) {
-    const char* output_name = GetOutputName(i);
-    if (output_name == nullptr) return -1;
-    if (strcmp(output_name, name) == 0) {
-      return i;
-    }
-  }
+  const int index = FindIndex(output_indices_, name);
+  if (index >= 0) return index;
 
   std::string msg = "Couldn't find index for output node";
   msg += " " + std::string{name} + "!";
@@ -482,7 +854,7 @@ void RelayVMModel::GetOutputByName(const char* name, void* out) {
 }
 
 int RelayVMModel::GetNumInputs() const {
-  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+  if (has_input_transform_) {
     return 1;
   }
   return num_inputs_;
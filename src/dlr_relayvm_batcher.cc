@@ -0,0 +1,187 @@
+#include "dlr_relayvm_batcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+using namespace dlr;
+
+namespace {
+
+size_t GetElementBytes(const std::string& type) {
+  if (type == "bool" || type == "uint8" || type == "int8") return 1;
+  if (type == "uint16" || type == "int16" || type == "float16" || type == "bfloat16") return 2;
+  if (type == "uint32" || type == "int32" || type == "float32") return 4;
+  if (type == "uint64" || type == "int64" || type == "float64") return 8;
+  throw dmlc::Error("Unsupported input dtype for batching: " + type);
+}
+
+}  // namespace
+
+RelayVMBatcher::RelayVMBatcher(RelayVMModel* model, const RelayVMBatcherConfig& config)
+    : model_(model), config_(config) {
+  CHECK(model_ != nullptr) << "model is nullptr, create it first";
+  CHECK_GT(config_.max_batch_size, 0) << "max_batch_size must be positive.";
+  CHECK_GE(config_.max_queue_delay.count(), 0) << "max_queue_delay must not be negative.";
+  for (size_t i = 0; i < config_.bucket_boundaries.size(); i++) {
+    CHECK_GT(config_.bucket_boundaries[i], i == 0 ? 0 : config_.bucket_boundaries[i - 1])
+        << "Bucket boundaries must be positive and ascending.";
+  }
+  // Batches are stacked from raw input bytes and split from raw output tensors.
+  CHECK(!model_->HasInputTransform() && model_->GetImageInputIndex() < 0)
+      << "Models with input transforms are not supported by the batcher.";
+  for (int o = 0; o < model_->GetNumOutputs(); o++) {
+    CHECK(!model_->HasOutputTransform(o))
+        << "Models with output transforms are not supported by the batcher. Output " << o
+        << " has one.";
+  }
+  const int num_inputs = model_->GetNumInputs();
+  input_elem_bytes_.resize(num_inputs);
+  input_trailing_shapes_.resize(num_inputs);
+  for (int i = 0; i < num_inputs; i++) {
+    const std::vector<int64_t>& shape = model_->GetInputShape(i);
+    CHECK_GE(shape.size(), 2) << "Input " << model_->GetInputName(i)
+                              << " must have batch and sequence dimensions.";
+    input_trailing_shapes_[i].assign(shape.begin() + 2, shape.end());
+    CHECK(!dlr::HasNegative(input_trailing_shapes_[i].data(), input_trailing_shapes_[i].size()))
+        << "Input " << model_->GetInputName(i) << " must have static trailing dimensions.";
+    input_elem_bytes_[i] = GetElementBytes(model_->GetInputType(i));
+  }
+  buckets_.resize(config_.bucket_boundaries.size() + 1);
+  worker_ = std::thread(&RelayVMBatcher::WorkerLoop, this);
+}
+
+RelayVMBatcher::~RelayVMBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+}
+
+size_t RelayVMBatcher::GetBucketIndex(int64_t length) const {
+  const auto& bounds = config_.bucket_boundaries;
+  return std::lower_bound(bounds.begin(), bounds.end(), length) - bounds.begin();
+}
+
+void RelayVMBatcher::Predict(const std::vector<const void*>& inputs, int64_t length,
+                             std::vector<std::vector<char>>* outputs,
+                             std::vector<std::vector<int64_t>>* output_shapes) {
+  CHECK_EQ(inputs.size(), input_elem_bytes_.size()) << "Expected one buffer per model input.";
+  CHECK_GT(length, 0) << "Sequence length must be positive.";
+  Request request;
+  request.inputs = &inputs;
+  request.length = length;
+  request.outputs = outputs;
+  request.output_shapes = output_shapes;
+  request.enqueue_time = std::chrono::steady_clock::now();
+  std::future<void> done = request.done.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK(!stop_) << "Batcher is shutting down.";
+    buckets_[GetBucketIndex(length)].push_back(&request);
+  }
+  cv_.notify_one();
+  done.get();
+}
+
+int RelayVMBatcher::SelectBucket(std::chrono::steady_clock::time_point now,
+                                 std::chrono::steady_clock::time_point* wake_time) const {
+  int selected = -1;
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    if (buckets_[i].empty()) continue;
+    const auto enqueue_time = buckets_[i].front()->enqueue_time;
+    const bool ready = stop_ || buckets_[i].size() >= config_.max_batch_size ||
+                       enqueue_time + config_.max_queue_delay <= now;
+    if (!ready) {
+      *wake_time = std::min(*wake_time, enqueue_time + config_.max_queue_delay);
+    } else if (selected < 0 || enqueue_time < buckets_[selected].front()->enqueue_time) {
+      selected = static_cast<int>(i);
+    }
+  }
+  return selected;
+}
+
+void RelayVMBatcher::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    auto wake_time = std::chrono::steady_clock::time_point::max();
+    const int bucket = SelectBucket(std::chrono::steady_clock::now(), &wake_time);
+    if (bucket < 0) {
+      // SelectBucket treats every pending request as ready once stopping.
+      if (stop_) break;
+      if (wake_time == std::chrono::steady_clock::time_point::max()) {
+        cv_.wait(lock);
+      } else {
+        cv_.wait_until(lock, wake_time);
+      }
+      continue;
+    }
+    std::deque<Request*>& queue = buckets_[bucket];
+    const size_t n = std::min(queue.size(), static_cast<size_t>(config_.max_batch_size));
+    std::vector<Request*> batch(queue.begin(), queue.begin() + n);
+    queue.erase(queue.begin(), queue.begin() + n);
+    lock.unlock();
+    RunBatch(batch);
+    lock.lock();
+  }
+}
+
+void RelayVMBatcher::RunBatch(const std::vector<Request*>& batch) {
+  try {
+    const int64_t n = batch.size();
+    int64_t max_length = 0;
+    for (const Request* request : batch) {
+      max_length = std::max(max_length, request->length);
+    }
+    std::vector<char> staging;
+    for (size_t i = 0; i < input_elem_bytes_.size(); i++) {
+      const std::vector<int64_t>& trailing = input_trailing_shapes_[i];
+      const size_t step_bytes =
+          std::accumulate(trailing.begin(), trailing.end(), int64_t(1),
+                          std::multiplies<int64_t>()) *
+          input_elem_bytes_[i];
+      const size_t row_bytes = max_length * step_bytes;
+      // Zero padding past each request's length.
+      staging.assign(n * row_bytes, 0);
+      for (int64_t r = 0; r < n; r++) {
+        std::memcpy(staging.data() + r * row_bytes, (*batch[r]->inputs)[i],
+                    batch[r]->length * step_bytes);
+      }
+      std::vector<int64_t> shape = {n, max_length};
+      shape.insert(shape.end(), trailing.begin(), trailing.end());
+      model_->SetInput(model_->GetInputName(i), shape.data(), staging.data(),
+                       static_cast<int>(shape.size()));
+    }
+    model_->Run();
+
+    const DLContext cpu_ctx = {kDLCPU, 0};
+    for (int o = 0; o < model_->GetNumOutputs(); o++) {
+      tvm::runtime::NDArray output = model_->GetOutput(o);
+      if (output->ctx.device_type != kDLCPU) {
+        output = output.CopyTo(cpu_ctx);
+      }
+      CHECK(output->ndim > 0 && output->shape[0] == n)
+          << "Output " << o << " must have the batch as its first dimension.";
+      std::vector<int64_t> row_shape(output->shape, output->shape + output->ndim);
+      row_shape[0] = 1;
+      const size_t row_bytes = tvm::runtime::GetDataSize(*output.operator->()) / n;
+      const char* data = static_cast<const char*>(output->data) + output->byte_offset;
+      for (int64_t r = 0; r < n; r++) {
+        batch[r]->outputs->resize(model_->GetNumOutputs());
+        batch[r]->output_shapes->resize(model_->GetNumOutputs());
+        (*batch[r]->outputs)[o].assign(data + r * row_bytes, data + (r + 1) * row_bytes);
+        (*batch[r]->output_shapes)[o] = row_shape;
+      }
+    }
+  } catch (...) {
+    for (Request* request : batch) {
+      request->done.set_exception(std::current_exception());
+    }
+    return;
+  }
+  for (Request* request : batch) {
+    request->done.set_value();
+  }
+}
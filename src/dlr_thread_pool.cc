@@ -0,0 +1,181 @@
+#include "dlr_thread_pool.h"
+
+#include <stdlib.h>
+#include <tvm/runtime/c_backend_api.h>
+#include <tvm/runtime/registry.h>
+#include <tvm/runtime/threading_backend.h>
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+
+#ifdef __linux__
+#include <sched.h>
+#endif  // __linux__
+
+using namespace dlr;
+
+static inline int SetEnv(const char* key, const char* value) {
+#ifdef _WIN32
+  return static_cast<int>(_putenv_s(key, value));
+#else
+  return setenv(key, value, 1);
+#endif  // _WIN32
+}
+
+namespace {
+
+struct ThreadPoolSettings {
+  int num_threads;
+  bool bind;
+
+  bool operator==(const ThreadPoolSettings& other) const {
+    return num_threads == other.num_threads && bind == other.bind;
+  }
+};
+
+/*! \brief Settings TVM picks from the environment, read before any model changes it. */
+const ThreadPoolSettings& DefaultSettings() {
+  static const ThreadPoolSettings defaults = [] {
+    const char* bind = getenv("TVM_BIND_THREADS");
+    return ThreadPoolSettings{tvm::runtime::threading::MaxConcurrency(),
+                              bind == nullptr || atoi(bind) == 1};
+  }();
+  return defaults;
+}
+
+#ifdef __linux__
+/*! \brief CPU affinity of the thread that created the first model, given back to unpinned
+ * workers.
+ */
+const cpu_set_t& UnpinnedAffinity() {
+  static const cpu_set_t mask = [] {
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+      CPU_ZERO(&mask);
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &mask);
+    }
+    return mask;
+  }();
+  return mask;
+}
+
+/*! \brief Runs on each worker used by the pool, task 0 on the calling thread. */
+int UnpinTask(int task_id, TVMParallelGroupEnv* penv, void* cdata) {
+  const cpu_set_t* mask = static_cast<const cpu_set_t*>(cdata);
+  return sched_setaffinity(0, sizeof(*mask), mask) == 0 ? 0 : -1;
+}
+#endif  // __linux__
+
+/*! \brief Guards the environment and max_num_threads. */
+std::mutex env_mutex;
+/*! \brief Largest thread count requested, stored in TVM_NUM_THREADS. */
+int max_num_threads = 0;
+/*! \brief Settings the thread pool of the calling thread was last configured with. TVM keeps the
+ * pool in thread local storage, so this follows it.
+ */
+thread_local ThreadPoolSettings applied_settings = {-1, false};
+
+}  // namespace
+
+TVMThreadPoolConfig::TVMThreadPoolConfig()
+    : num_threads_(DefaultSettings().num_threads), bind_(DefaultSettings().bind) {
+#ifdef __linux__
+  UnpinnedAffinity();
+#endif  // __linux__
+}
+
+void TVMThreadPoolConfig::SetNumThreads(int threads) {
+  if (threads > 0) {
+    num_threads_ = threads;
+    {
+      std::lock_guard<std::mutex> lock(env_mutex);
+      if (threads > max_num_threads) {
+        max_num_threads = threads;
+        SetEnv("TVM_NUM_THREADS", std::to_string(threads).c_str());
+      }
+    }
+    LOG(INFO) << "Set Num Threads: " << threads;
+  }
+}
+
+void TVMThreadPoolConfig::UseCPUAffinity(bool use) {
+  bind_ = use;
+  if (use) {
+    LOG(INFO) << "CPU Affinity is enabled";
+  } else {
+    LOG(INFO) << "CPU Affinity is disabled";
+  }
+}
+
+void TVMThreadPoolConfig::Apply() const {
+  const ThreadPoolSettings settings = {num_threads_, bind_};
+  if (settings == applied_settings) return;
+  applied_settings = settings;
+  const tvm::runtime::PackedFunc* config = tvm::runtime::Registry::Get("runtime.config_threadpool");
+  if (config == nullptr) {
+    LOG(WARNING) << "runtime.config_threadpool is not available. Thread settings only apply to "
+                    "thread pools created afterwards.";
+    return;
+  }
+  {
+    // The thread pool reads TVM_BIND_THREADS whenever it is reconfigured.
+    std::lock_guard<std::mutex> lock(env_mutex);
+    SetEnv("TVM_BIND_THREADS", bind_ ? "1" : "0");
+    // Mode 0 uses all cores rather than only the big or little cluster.
+    (*config)(0, num_threads_);
+  }
+#ifdef __linux__
+  // TVM leaves workers pinned by an earlier configuration as they are.
+  if (!bind_) {
+    cpu_set_t mask = UnpinnedAffinity();
+    if (TVMBackendParallelLaunch(UnpinTask, &mask, 0) != 0) {
+      LOG(WARNING) << "Failed to reset the CPU affinity of thread pool workers.";
+    }
+  }
+#endif  // __linux__
+}
+
+namespace {
+
+struct ParallelForClosure {
+  size_t num_items;
+  size_t min_items;
+  const std::function<void(size_t, size_t)>* fn;
+  std::mutex mutex;
+  std::exception_ptr error;
+};
+
+int ParallelForTask(int task_id, TVMParallelGroupEnv* penv, void* cdata) {
+  auto* closure = static_cast<ParallelForClosure*>(cdata);
+  const size_t num_task = static_cast<size_t>(penv->num_task);
+  const size_t chunk =
+      std::max(closure->min_items, (closure->num_items + num_task - 1) / num_task);
+  const size_t begin = std::min(closure->num_items, task_id * chunk);
+  const size_t end = std::min(closure->num_items, begin + chunk);
+  if (begin >= end) return 0;
+  // Exceptions must not cross the thread pool's C interface.
+  try {
+    (*closure->fn)(begin, end);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(closure->mutex);
+    if (!closure->error) closure->error = std::current_exception();
+  }
+  return 0;
+}
+
+}  // namespace
+
+void dlr::ParallelFor(size_t num_items, size_t min_items,
+                      const std::function<void(size_t, size_t)>& fn) {
+  if (num_items <= std::max<size_t>(min_items, 1)) {
+    if (num_items > 0) fn(0, num_items);
+    return;
+  }
+  ParallelForClosure closure;
+  closure.num_items = num_items;
+  closure.min_items = std::max<size_t>(min_items, 1);
+  closure.fn = &fn;
+  CHECK_EQ(TVMBackendParallelLaunch(ParallelForTask, &closure, 0), 0) << TVMGetLastError();
+  if (closure.error) std::rethrow_exception(closure.error);
+}
@@ -1,8 +1,29 @@
 #include "dlr_treelite.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <cstdlib>
 #include <fstream>
+#include <future>
+#include <mutex>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "dlr_thread_pool.h"
 
 using namespace dlr;
 
@@ -10,6 +31,105 @@ const std::string TreeliteModel::INPUT_NAME = "data";
 const std::string TreeliteModel::INPUT_TYPE = "float32";
 const std::string TreeliteModel::OUTPUT_TYPE = "float32";
 
+namespace {
+
+/*! \brief Number of leading rows sampled to estimate the fraction of missing values. */
+constexpr size_t kSparsitySampleRows = 16;
+/*! \brief Use CSR when at least this fraction of values is missing. Below it, assembling CSR costs
+ * more than Treelite skipping missing values of a dense batch. */
+constexpr float kSparseMissingFraction = 0.75f;
+
+float SampleMissingFraction(const float* input, size_t num_row, size_t num_col) {
+  const size_t num_sampled = std::min(num_row, kSparsitySampleRows) * num_col;
+  if (num_sampled == 0) return 0.0f;
+  size_t num_missing = 0;
+  for (size_t i = 0; i < num_sampled; ++i) {
+    num_missing += std::isnan(input[i]);
+  }
+  return static_cast<float>(num_missing) / num_sampled;
+}
+
+/*! \brief Rows per task when building CSR in parallel. */
+constexpr size_t kCSRRowsPerTask = 256;
+
+/*! \brief Count values that are not NaN. */
+size_t CountNonMissing(const float* row, size_t n) {
+  size_t count = 0;
+  size_t j = 0;
+#if defined(__AVX2__)
+  for (; j + 8 <= n; j += 8) {
+    __m256 v = _mm256_loadu_ps(row + j);
+    // Ordered comparison with itself is false only for NaN.
+    int mask = _mm256_movemask_ps(_mm256_cmp_ps(v, v, _CMP_ORD_Q));
+    count += __builtin_popcount(mask);
+  }
+#elif defined(__ARM_NEON)
+  uint32x4_t acc = vdupq_n_u32(0);
+  for (; j + 4 <= n; j += 4) {
+    float32x4_t v = vld1q_f32(row + j);
+    // Lanes equal to themselves are all ones, subtracting them adds one per non-NaN value.
+    acc = vsubq_u32(acc, vceqq_f32(v, v));
+  }
+  count += vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) +
+           vgetq_lane_u32(acc, 3);
+#endif
+  for (; j < n; ++j) {
+    count += !std::isnan(row[j]);
+  }
+  return count;
+}
+
+#ifndef _WIN32
+/*! \brief Read-only mapping of a whole file. */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    CHECK_GE(fd_, 0) << "Failed to open " << path << ": " << std::strerror(errno);
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      const int err = errno;
+      close(fd_);
+      LOG(FATAL) << "Failed to stat " << path << ": " << std::strerror(err);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) return;
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data_ == MAP_FAILED) {
+      const int err = errno;
+      close(fd_);
+      LOG(FATAL) << "Failed to map " << path << ": " << std::strerror(err);
+    }
+    madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  ~MappedFile() {
+    if (data_ != nullptr) munmap(data_, size_);
+    close(fd_);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return static_cast<const char*>(data_); }
+  size_t size() const { return size_; }
+
+  /*! \brief Drop the pages of a consumed range from the resident set. They are read again from the
+   * file if accessed later. */
+  void Release(const void* begin, size_t bytes) {
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t start = reinterpret_cast<uintptr_t>(begin) & ~(page - 1);
+    const uintptr_t end = reinterpret_cast<uintptr_t>(begin) + bytes;
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+  }
+
+ private:
+  int fd_ = -1;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+#endif  // _WIN32
+
+}  // namespace
+
 // not used (was used in SetupTreeliteModule)
 std::string GetVersion(const std::string& json_path) {
   std::ifstream file(json_path);
@@ -45,14 +165,14 @@ void TreeliteModel::SetupTreeliteModule(const std::vector<std::string>& model_pa
   // If OMP_NUM_THREADS is set, use it to determine number of threads;
   // if not, use the maximum amount of threads
   const char* val = std::getenv("OMP_NUM_THREADS");
-  int num_worker_threads = (val ? std::atoi(val) : -1);
+  num_threads_ = (val ? std::atoi(val) : -1);
   num_inputs_ = 1;
   num_outputs_ = 1;
   // Give a dummy input name to Treelite model.
   input_names_.push_back(INPUT_NAME);
   input_types_.push_back(INPUT_TYPE);
-  CHECK_EQ(TreelitePredictorLoad(paths.model_lib.c_str(), num_worker_threads, &treelite_model_), 0)
-      << TreeliteGetLastError();
+  model_lib_path_ = paths.model_lib;
+  LoadPredictor(num_threads_);
   CHECK_EQ(TreelitePredictorQueryNumFeature(treelite_model_, &treelite_num_feature_), 0)
       << TreeliteGetLastError();
   treelite_input_.reset(nullptr);
@@ -61,7 +181,8 @@ void TreeliteModel::SetupTreeliteModule(const std::vector<std::string>& model_pa
   CHECK_EQ(TreelitePredictorQueryNumOutputGroup(treelite_model_, &num_output_class), 0)
       << TreeliteGetLastError();
   treelite_output_buffer_size_ = num_output_class;
-  treelite_output_.empty();
+  // Large enough for a single instance, so that batch size 1 does not allocate in Run.
+  treelite_output_.resize(num_output_class);
   // NOTE: second dimension of the output shape is smaller than num_output_class
   //       when a multi-class classifier outputs only the class prediction
   //       (argmax) To detect this edge case, run TreelitePredictorPredictInst()
@@ -127,40 +248,195 @@ void TreeliteModel::SetInput(const char* name, const int64_t* shape, const void*
       << shape[1] << ", Expected: " << treelite_num_feature_ << " or less";
 
   const size_t batch_size = static_cast<size_t>(shape[0]);
-  const uint32_t num_col = static_cast<uint32_t>(shape[1]);
-  treelite_input_.reset(new TreeliteInput);
-  CHECK(treelite_input_);
-  treelite_input_->row_ptr.push_back(0);
-  float* input_f = (float*)input;
+  const size_t num_col = static_cast<size_t>(shape[1]);
+  const float* input_f = static_cast<const float*>(input);
+  if (batch_size == 1) {
+    SetInstanceInput(input_f, num_col);
+  } else {
+    AssembleBatch(PrepareInput(), input_f, batch_size, num_col, !zero_copy_input_, true);
+  }
+  UpdateInputShapes();
+}
+
+TreeliteModel::~TreeliteModel() {
+  treelite_input_.reset(nullptr);
+  FreePredictor();
+}
+
+static inline int SetEnv(const char* key, const char* value) {
+#ifdef _WIN32
+  return static_cast<int>(_putenv_s(key, value));
+#else
+  return setenv(key, value, 1);
+#endif  // _WIN32
+}
+
+namespace {
+
+/*! \brief Guards TREELITE_BIND_THREADS, which Treelite reads when it starts the workers. */
+std::mutex bind_threads_mutex;
+
+}  // namespace
+
+void TreeliteModel::LoadPredictor(int threads) {
+  if (treelite_model_ != nullptr && threads == predictor_threads_) return;
+  PredictorHandle predictor;
+  {
+    std::lock_guard<std::mutex> lock(bind_threads_mutex);
+    SetEnv("TREELITE_BIND_THREADS", use_cpu_affinity_ ? "1" : "0");
+    CHECK_EQ(TreelitePredictorLoad(model_lib_path_.c_str(), threads, &predictor), 0)
+        << TreeliteGetLastError();
+  }
+  // The previous predictor is only freed once the new one loaded, so that it stays usable.
+  FreePredictor();
+  treelite_model_ = predictor;
+  predictor_threads_ = threads;
+}
+
+void TreeliteModel::FreePredictor() {
+  if (treelite_model_ == nullptr) return;
+  TreelitePredictorFree(treelite_model_);
+  treelite_model_ = nullptr;
+}
+
+void TreeliteInput::ReleaseBatch() {
+  if (handle == nullptr) return;
+  if (is_sparse) {
+    TreeliteDeleteSparseBatch(handle);
+  } else {
+    TreeliteDeleteDenseBatch(handle);
+  }
+  handle = nullptr;
+}
+
+TreeliteInput* TreeliteModel::PrepareInput() {
+  if (!treelite_input_) {
+    treelite_input_.reset(new TreeliteInput);
+  }
+  treelite_input_->ReleaseBatch();
+  return treelite_input_.get();
+}
+
+void TreeliteModel::SetInstanceInput(const float* input, size_t num_col) {
+  TreeliteInput* treelite_input = PrepareInput();
+  // Sized once, later calls only overwrite the entries.
+  treelite_input->inst.resize(treelite_num_feature_);
+  TreelitePredictorEntry* inst = treelite_input->inst.data();
+  for (size_t j = 0; j < num_col; ++j) {
+    if (std::isnan(input[j])) {
+      inst[j].missing = -1;
+    } else {
+      inst[j].fvalue = input[j];
+    }
+  }
+  for (size_t j = num_col; j < treelite_num_feature_; ++j) {
+    inst[j].missing = -1;
+  }
+  treelite_input->num_row = 1;
+  treelite_input->num_col = num_col;
+  treelite_input->is_instance = true;
+}
+
+void TreeliteModel::AssembleBatch(TreeliteInput* treelite_input, const float* input,
+                                  size_t num_row, size_t num_col, bool copy, bool parallel) {
+  if (SampleMissingFraction(input, num_row, num_col) >= kSparseMissingFraction) {
+    AssembleCSR(treelite_input, input, num_row, num_col, parallel);
+  } else {
+    AssembleDense(treelite_input, input, num_row, num_col, copy);
+  }
+}
+
+void TreeliteModel::AssembleDense(TreeliteInput* treelite_input, const float* input,
+                                  size_t num_row, size_t num_col, bool copy) {
+  const float* data = input;
+  if (copy) {
+    treelite_input->dense_data.assign(input, input + num_row * num_col);
+    data = treelite_input->dense_data.data();
+  }
+  treelite_input->num_row = num_row;
+  treelite_input->num_col = num_col;
+  treelite_input->is_instance = false;
+  treelite_input->is_sparse = false;
+  // Columns past num_col are treated as missing by Treelite.
+  CHECK_EQ(TreeliteAssembleDenseBatch(data, NAN, num_row, num_col, &treelite_input->handle), 0)
+      << TreeliteGetLastError();
+}
+
+void TreeliteModel::AssembleCSR(TreeliteInput* treelite_input, const float* input,
+                                size_t num_row, size_t num_col, bool parallel) {
+  auto& row_ptr = treelite_input->row_ptr;
+  auto& values = treelite_input->data;
+  auto& col_ind = treelite_input->col_ind;
 
   // NOTE: Assume row-major (C) layout
-  treelite_input_->data.reserve(batch_size * num_col);
-  treelite_input_->col_ind.reserve(batch_size * num_col);
-  treelite_input_->row_ptr.reserve(batch_size);
-  for (size_t i = 0; i < batch_size; ++i) {
-    for (uint32_t j = 0; j < num_col; ++j) {
-      if (!std::isnan(input_f[i * num_col + j]) && input_f[i * num_col + j] != 0.0f) {
-        treelite_input_->data.push_back(input_f[i * num_col + j]);
-        treelite_input_->col_ind.push_back(j);
-      }
+  // First pass counts values per row, second pass fills each row at its final offset, so that
+  // row blocks can be processed in parallel. Buffers keep their capacity across calls.
+  const size_t rows_per_task = parallel ? kCSRRowsPerTask : num_row;
+  row_ptr.resize(num_row + 1);
+  row_ptr[0] = 0;
+  dlr::ParallelFor(num_row, rows_per_task, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      row_ptr[i + 1] = CountNonMissing(input + i * num_col, num_col);
     }
-    treelite_input_->row_ptr.push_back(treelite_input_->data.size());
+  });
+  for (size_t i = 0; i < num_row; ++i) {
+    row_ptr[i + 1] += row_ptr[i];
   }
-  // Post conditions for CSR matrix initialization
-  CHECK_EQ(treelite_input_->data.size(), treelite_input_->col_ind.size());
-  CHECK_EQ(treelite_input_->data.size(), treelite_input_->row_ptr.back());
-  CHECK_EQ(treelite_input_->row_ptr.size(), batch_size + 1);
+  values.resize(row_ptr[num_row]);
+  col_ind.resize(row_ptr[num_row]);
+  dlr::ParallelFor(num_row, rows_per_task, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const float* row = input + i * num_col;
+      size_t k = row_ptr[i];
+      for (uint32_t j = 0; j < num_col; ++j) {
+        if (!std::isnan(row[j])) {
+          values[k] = row[j];
+          col_ind[k] = j;
+          ++k;
+        }
+      }
+    }
+  });
 
   // Save dimensions for input
-  treelite_input_->num_row = batch_size;
-  treelite_input_->num_col = treelite_num_feature_;
+  treelite_input->num_row = num_row;
+  treelite_input->num_col = treelite_num_feature_;
+  treelite_input->is_instance = false;
+  treelite_input->is_sparse = true;
 
   // Register CSR matrix with Treelite backend
-  CHECK_EQ(
-      TreeliteAssembleSparseBatch(treelite_input_->data.data(), treelite_input_->col_ind.data(),
-                                  treelite_input_->row_ptr.data(), batch_size,
-                                  treelite_num_feature_, &treelite_input_->handle),
-      0)
+  CHECK_EQ(TreeliteAssembleSparseBatch(values.data(), col_ind.data(), row_ptr.data(), num_row,
+                                       treelite_num_feature_, &treelite_input->handle),
+           0)
+      << TreeliteGetLastError();
+}
+
+void TreeliteModel::SetSparseInput(const float* data, const uint32_t* col_ind,
+                                   const size_t* row_ptr, size_t num_row, size_t num_col) {
+  CHECK_LE(num_col, treelite_num_feature_)
+      << "ClientError: Mismatch found in number of columns. Value read: " << num_col
+      << ", Expected: " << treelite_num_feature_ << " or less";
+  CHECK(row_ptr != nullptr) << "row_ptr must not be null.";
+  CHECK_EQ(row_ptr[0], 0) << "row_ptr[0] must be 0.";
+  for (size_t i = 0; i < num_row; ++i) {
+    CHECK_LE(row_ptr[i], row_ptr[i + 1]) << "row_ptr must not decrease, found at row " << i;
+  }
+  const size_t nnz = row_ptr[num_row];
+  CHECK(nnz == 0 || (data != nullptr && col_ind != nullptr))
+      << "data and col_ind must not be null.";
+  // Treelite indexes its per-row feature buffer with col_ind without bounds checks.
+  for (size_t k = 0; k < nnz; ++k) {
+    CHECK_LT(col_ind[k], num_col) << "col_ind out of range at entry " << k;
+  }
+
+  TreeliteInput* treelite_input = PrepareInput();
+  treelite_input->num_row = num_row;
+  treelite_input->num_col = treelite_num_feature_;
+  treelite_input->is_instance = false;
+  treelite_input->is_sparse = true;
+  CHECK_EQ(TreeliteAssembleSparseBatch(data, col_ind, row_ptr, num_row, treelite_num_feature_,
+                                       &treelite_input->handle),
+           0)
       << TreeliteGetLastError();
   UpdateInputShapes();
 }
@@ -201,20 +477,149 @@ const char* TreeliteModel::GetOutputType(int index) const {
   return OUTPUT_TYPE.c_str();
 }
 
-void TreeliteModel::Run() {
+void TreeliteModel::Predict(PredictorHandle predictor) {
   size_t out_result_size;
-  CHECK(treelite_input_);
+  CHECK(treelite_input_) << "Input is not set.";
   treelite_output_.resize(treelite_input_->num_row * treelite_output_buffer_size_);
-  CHECK_EQ(TreelitePredictorPredictBatch(treelite_model_, treelite_input_->handle, 1, 0, 0,
+  if (treelite_input_->is_instance) {
+    CHECK_EQ(TreelitePredictorPredictInst(predictor, treelite_input_->inst.data(), 0,
+                                          treelite_output_.data(), &out_result_size),
+             0)
+        << TreeliteGetLastError();
+    return;
+  }
+  CHECK(treelite_input_->handle) << "Input is not set.";
+  CHECK_EQ(TreelitePredictorPredictBatch(predictor, treelite_input_->handle,
+                                         treelite_input_->is_sparse ? 1 : 0, 0, 0,
                                          treelite_output_.data(), &out_result_size),
            0)
       << TreeliteGetLastError();
 }
 
+void TreeliteModel::Run() {
+  LoadPredictor(num_threads_);
+  Predict(treelite_model_);
+}
+
+void TreeliteModel::Run(int threads) {
+  CHECK_GT(threads, 0) << "Number of threads must be positive.";
+  LoadPredictor(threads);
+  Predict(treelite_model_);
+}
+
 void TreeliteModel::SetNumThreads(int threads) {
-  throw dmlc::Error("SetNumThreads is not supported by Treelite backend.");
+  if (threads > 0) {
+    LoadPredictor(threads);
+    num_threads_ = threads;
+    LOG(INFO) << "Set Num Threads: " << threads;
+  }
 }
 
 void TreeliteModel::UseCPUAffinity(bool use) {
-  throw dmlc::Error("UseCPUAffinity is not supported by Treelite backend.");
+  if (use == use_cpu_affinity_) return;
+  use_cpu_affinity_ = use;
+  // Reload, as Treelite only pins threads when it loads a predictor.
+  predictor_threads_ = 0;
+  LoadPredictor(num_threads_);
+  LOG(INFO) << "CPU Affinity is " << (use ? "enabled" : "disabled");
+}
+
+struct TreeliteModel::StreamChunk {
+  // Rows read from a TreeliteStreamReader. Unused when data points into a mapped file.
+  std::vector<float, DLRAllocator<float>> rows;
+  const float* data = nullptr;
+  size_t num_row = 0;
+  TreeliteInput input;
+};
+
+size_t TreeliteModel::PredictChunks(const std::function<bool(StreamChunk*)>& next_chunk,
+                                    size_t num_col, size_t chunk_rows,
+                                    const TreeliteStreamWriter& writer) {
+  CHECK_GT(num_col, 0) << "num_col must be positive.";
+  CHECK_LE(num_col, treelite_num_feature_)
+      << "ClientError: Mismatch found in number of columns. Value read: " << num_col
+      << ", Expected: " << treelite_num_feature_ << " or less";
+  CHECK_GT(chunk_rows, 0) << "chunk_rows must be positive.";
+  CHECK(writer) << "writer must not be empty.";
+  LoadPredictor(num_threads_);
+
+  // Chunks are assembled without ParallelFor, Treelite already uses every worker for prediction.
+  auto prepare = [&](StreamChunk* chunk) {
+    chunk->input.ReleaseBatch();
+    if (!next_chunk(chunk)) {
+      chunk->num_row = 0;
+      return;
+    }
+    CHECK_LE(chunk->num_row, chunk_rows) << "Stream returned more rows than requested.";
+    AssembleBatch(&chunk->input, chunk->data, chunk->num_row, num_col, false, false);
+  };
+  StreamChunk chunks[2];
+  std::vector<float, DLRAllocator<float>> output(chunk_rows * treelite_output_buffer_size_);
+  size_t num_scored = 0;
+  prepare(&chunks[0]);
+  for (int current = 0; chunks[current].num_row > 0; current = 1 - current) {
+    const StreamChunk& chunk = chunks[current];
+    // The future returned by std::async waits for the helper thread when destroyed, so the other
+    // chunk is never released while it is still being assembled, even if prediction throws.
+    std::future<void> pending = std::async(std::launch::async, prepare, &chunks[1 - current]);
+    size_t out_result_size;
+    CHECK_EQ(TreelitePredictorPredictBatch(treelite_model_, chunk.input.handle,
+                                           chunk.input.is_sparse ? 1 : 0, 0, 0, output.data(),
+                                           &out_result_size),
+             0)
+        << TreeliteGetLastError();
+    writer(output.data(), chunk.num_row, out_result_size / chunk.num_row);
+    num_scored += chunk.num_row;
+    pending.get();
+  }
+  return num_scored;
+}
+
+size_t TreeliteModel::PredictStream(const TreeliteStreamReader& reader, size_t num_col,
+                                    size_t chunk_rows, const TreeliteStreamWriter& writer) {
+  CHECK(reader) << "reader must not be empty.";
+  return PredictChunks(
+      [&](StreamChunk* chunk) {
+        chunk->rows.resize(chunk_rows * num_col);
+        chunk->data = chunk->rows.data();
+        chunk->num_row = reader(chunk->rows.data(), chunk_rows);
+        return chunk->num_row > 0;
+      },
+      num_col, chunk_rows, writer);
+}
+
+size_t TreeliteModel::PredictFile(const std::string& path, size_t num_col, size_t chunk_rows,
+                                  const TreeliteStreamWriter& writer) {
+  CHECK_GT(num_col, 0) << "num_col must be positive.";
+  const size_t row_bytes = num_col * sizeof(float);
+#ifdef _WIN32
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << "Failed to open " << path;
+  return PredictStream(
+      [&](float* buffer, size_t max_rows) {
+        file.read(reinterpret_cast<char*>(buffer), max_rows * row_bytes);
+        const size_t bytes = static_cast<size_t>(file.gcount());
+        CHECK_EQ(bytes % row_bytes, 0)
+            << path << " does not hold a whole number of rows of " << num_col << " values.";
+        return bytes / row_bytes;
+      },
+      num_col, chunk_rows, writer);
+#else
+  MappedFile file(path);
+  CHECK_EQ(file.size() % row_bytes, 0)
+      << path << " does not hold a whole number of rows of " << num_col << " values.";
+  const size_t num_row = file.size() / row_bytes;
+  const float* rows = reinterpret_cast<const float*>(file.data());
+  size_t next_row = 0;
+  return PredictChunks(
+      [&](StreamChunk* chunk) {
+        // The rows this chunk held before have been predicted.
+        if (chunk->num_row > 0) file.Release(chunk->data, chunk->num_row * row_bytes);
+        chunk->data = rows + next_row * num_col;
+        chunk->num_row = std::min(chunk_rows, num_row - next_row);
+        next_row += chunk->num_row;
+        return chunk->num_row > 0;
+      },
+      num_col, chunk_rows, writer);
+#endif  // _WIN32
 }
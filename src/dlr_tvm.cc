@@ -123,6 +123,7 @@ void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
   input_types_.resize(num_inputs_);
   for (int i = 0; i < num_inputs_; i++) {
     input_types_[i] = tvm_graph_runtime_->GetInputType(i);
+    input_indices_.emplace(input_names_[i], tvm_graph_runtime_->GetInputIndex(input_names_[i]));
   }
 
   // Get the number of output and reserve space to save output tensor
@@ -136,6 +137,10 @@ void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
     output_types_[i] = tvm_graph_runtime_->GetOutputType(i);
   }
   UpdateInputShapes();
+  FetchOutputNames();
+  if (HasMetadata() && data_transform_.HasImageTransform(metadata_)) {
+    data_transform_.CompileImageTransform(metadata_, input_names_, input_shapes_);
+  }
 }
 
 void TVMModel::UpdateInputShapes() {
@@ -148,6 +153,26 @@ void TVMModel::UpdateInputShapes() {
   }
 }
 
+void TVMModel::FetchOutputNames() {
+  if (!HasMetadata()) return;
+  // Outputs up to the first one without a name, GetOutputName reports the rest as not found.
+  try {
+    const nlohmann::json& outputs = metadata_.at("Model").at("Outputs");
+    for (int i = 0; i < num_outputs_ && i < outputs.size(); i++) {
+      output_names_.push_back(outputs[i].at("name").get<std::string>());
+    }
+  } catch (nlohmann::json::exception& e) {
+    // ignore
+  }
+  output_indices_ = MakeIndexMap(output_names_);
+}
+
+int TVMModel::GetInputIndex(const char* name) const {
+  const int index = FindIndex(input_indices_, name);
+  // Weights are rarely set by name, they are looked up in the graph.
+  return index >= 0 ? index : tvm_graph_runtime_->GetInputIndex(name);
+}
+
 std::vector<std::string> TVMModel::GetWeightNames() const {
   return tvm_graph_runtime_->GetWeightNames();
 }
@@ -159,6 +184,7 @@ const char* TVMModel::GetInputName(int index) const {
 
 const char* TVMModel::GetInputType(int index) const {
   CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+  if (index == data_transform_.GetImageInputIndex()) return "uint8";
   return input_types_[index].c_str();
 }
 
@@ -181,9 +207,14 @@ const char* TVMModel::GetWeightName(int index) const {
 }
 
 void TVMModel::SetInput(const char* name, const int64_t* shape, const void* input, int dim) {
-  std::string str(name);
-  int index = tvm_graph_runtime_->GetInputIndex(str);
+  int index = GetInputIndex(name);
   tvm::runtime::NDArray arr = tvm_graph_runtime_->GetInput(index);
+  const int image_index = data_transform_.GetImageInputIndex();
+  if (image_index >= 0 && input_names_[image_index] == name) {
+    // Preprocess uint8 images straight into the graph runtime's input storage.
+    data_transform_.TransformImage(shape, input, dim, arr);
+    return;
+  }
   DLTensor input_tensor = *(arr.operator->());
   input_tensor.ctx = DLContext{kDLCPU, 0};
   input_tensor.data = const_cast<void*>(input);
@@ -192,13 +223,19 @@ void TVMModel::SetInput(const char* name, const int64_t* shape, const void* inpu
       input_tensor.shape, input_tensor.shape + input_tensor.ndim, 1, std::multiplies<int64_t>());
   CHECK_SHAPE("Mismatch found in input data size", read_size, expected_size);
   tvm::runtime::PackedFunc set_input = tvm_module_->GetFunction("set_input");
-  set_input(str, &input_tensor);
+  set_input(name, &input_tensor);
   UpdateInputShapes();
 }
 
 void TVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
-  std::string str(name);
-  int index = tvm_graph_runtime_->GetInputIndex(str);
+  int index = GetInputIndex(name);
+  const int image_index = data_transform_.GetImageInputIndex();
+  if (image_index >= 0 && input_names_[image_index] == name) {
+    CHECK_EQ(tensor->ctx.device_type, kDLCPU) << "Image input must be in CPU memory.";
+    SetInput(name, tensor->shape, static_cast<const char*>(tensor->data) + tensor->byte_offset,
+             tensor->ndim);
+    return;
+  }
   if (index > -1) {
     tvm::runtime::NDArray arr = tvm_graph_runtime_->GetInput(index);
     DLTensor input_tensor = *(arr.operator->());
@@ -211,9 +248,51 @@ void TVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
   }
 }
 
+void TVMModel::SetImageInput(const char* name, const ImageView* images, int64_t n) {
+  const int image_index = data_transform_.GetImageInputIndex();
+  CHECK(image_index >= 0 && input_names_[image_index] == name)
+      << "Input " << name << " has no Image transform.";
+  tvm::runtime::NDArray arr = tvm_graph_runtime_->GetInput(image_index);
+  data_transform_.TransformImage(images, n, arr);
+}
+
+void TVMModel::SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                           int64_t num_boxes) {
+  const int image_index = data_transform_.GetImageInputIndex();
+  CHECK(image_index >= 0 && input_names_[image_index] == name)
+      << "Input " << name << " has no Image transform.";
+  // The compiled batch size bounds the number of boxes.
+  tvm::runtime::NDArray arr = tvm_graph_runtime_->GetInput(image_index);
+  data_transform_.TransformROIs(frame, boxes, num_boxes, arr);
+}
+
+int TVMModel::GetImageInputIndex() const { return data_transform_.GetImageInputIndex(); }
+
+void TVMModel::SetInputBatch(const char* name, const void** samples, int n) {
+  CHECK_GT(n, 0) << "Number of samples must be positive.";
+  int index = GetInputIndex(name);
+  CHECK_GE(index, 0) << "Invalid input node name: " << name;
+  const int image_index = data_transform_.GetImageInputIndex();
+  CHECK(image_index < 0 || input_names_[image_index] != name)
+      << "Image transforms are not supported with SetInputBatch.";
+  // Gather samples straight into the graph runtime's input storage.
+  tvm::runtime::NDArray arr = tvm_graph_runtime_->GetInput(index);
+  CHECK_GT(arr->ndim, 0) << "SetInputBatch requires an input with a batch dimension.";
+  CHECK_SHAPE("Mismatch found in input batch size", static_cast<int64_t>(n), arr->shape[0]);
+  const size_t sample_bytes = tvm::runtime::GetDataSize(*arr.operator->()) / n;
+  if (arr->ctx.device_type == kDLCPU) {
+    dlr::GatherBatch(samples, n, sample_bytes, static_cast<char*>(arr->data) + arr->byte_offset);
+  } else {
+    std::vector<int64_t> arr_shape(arr->shape, arr->shape + arr->ndim);
+    tvm::runtime::NDArray staging =
+        tvm::runtime::NDArray::Empty(arr_shape, arr->dtype, DLContext{kDLCPU, 0});
+    dlr::GatherBatch(samples, n, sample_bytes, staging->data);
+    arr.CopyFrom(staging);
+  }
+}
+
 void TVMModel::GetInput(const char* name, void* input) {
-  std::string str(name);
-  int index = tvm_graph_runtime_->GetInputIndex(str);
+  int index = GetInputIndex(name);
   tvm::runtime::NDArray arr = tvm_graph_runtime_->GetInput(index);
   DLTensor input_tensor;
   input_tensor.data = input;
@@ -238,6 +317,20 @@ void TVMModel::GetOutput(int index, void* out) {
   get_output(index, &output_tensor);
 }
 
+void TVMModel::GetOutputBatch(int index, void** dests, int n) {
+  CHECK_GT(n, 0) << "Number of samples must be positive.";
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+  tvm::runtime::NDArray output = tvm_graph_runtime_->GetOutput(index);
+  CHECK_GT(output->ndim, 0) << "GetOutputBatch requires an output with a batch dimension.";
+  CHECK_SHAPE("Mismatch found in output batch size", static_cast<int64_t>(n), output->shape[0]);
+  if (output->ctx.device_type != kDLCPU) {
+    output = output.CopyTo(DLContext{kDLCPU, 0});
+  }
+  const size_t sample_bytes = tvm::runtime::GetDataSize(*output.operator->()) / n;
+  dlr::ScatterBatch(static_cast<const char*>(output->data) + output->byte_offset, n, sample_bytes,
+                    dests);
+}
+
 const void* TVMModel::GetOutputPtr(int index) const {
   tvm::runtime::NDArray output = tvm_graph_runtime_->GetOutput(index);
   const DLTensor* tensor = output.operator->();
@@ -276,64 +369,33 @@ const char* TVMModel::GetOutputType(int index) const {
 }
 
 void TVMModel::Run() {
+  thread_pool_config_.Apply();
   tvm::runtime::PackedFunc run = tvm_module_->GetFunction("run");
   run();
 }
 
-static inline int SetEnv(const char* key, const char* value) {
-#ifdef _WIN32
-  return static_cast<int>(_putenv_s(key, value));
-#else
-  return setenv(key, value, 1);
-#endif  // _WIN32
-}
+void TVMModel::SetNumThreads(int threads) { thread_pool_config_.SetNumThreads(threads); }
 
-void TVMModel::SetNumThreads(int threads) {
-  if (threads > 0) {
-    SetEnv("TVM_NUM_THREADS", std::to_string(threads).c_str());
-    LOG(INFO) << "Set Num Threads: " << threads;
-  }
-}
-
-void TVMModel::UseCPUAffinity(bool use) {
-  if (use) {
-    SetEnv("TVM_BIND_THREADS", "1");
-    LOG(INFO) << "CPU Affinity is enabled";
-  } else {
-    SetEnv("TVM_BIND_THREADS", "0");
-    LOG(INFO) << "CPU Affinity is disabled";
-  }
-}
+void TVMModel::UseCPUAffinity(bool use) { thread_pool_config_.UseCPUAffinity(use); }
 
 const char* TVMModel::GetOutputName(const int index) const {
   if (!this->HasMetadata()) {
     throw dmlc::Error("No metadata file was found!");
   }
-  try {
-    return this->metadata_.at("Model")
-        .at("Outputs")
-        .at(index)
-        .at("name")
-        .get_ref<const std::string&>()
-        .c_str();
-  } catch (nlohmann::json::out_of_range& e) {
+  if (index < 0 || index >= output_names_.size()) {
     std::string msg =
         "Output node with index " + std::to_string(index) + " was not found in metadata file!";
     throw dmlc::Error(msg);
   }
+  return output_names_[index].c_str();
 }
 
 int TVMModel::GetOutputIndex(const char* name) const {
   if (!this->HasMetadata()) {
     throw dmlc::Error("No metadata file was found!");
   }
-  for (int i = 0; i < this->num_outputs_; i++) {
-    const char* output_name = GetOutputName(i);
-    if (output_name == nullptr) return -1;
-    if (strcmp(output_name, name) == 0) {
-      return i;
-    }
-  }
+  const int index = FindIndex(output_indices_, name);
+  if (index >= 0) return index;
 
   std::string msg = "Couldn't find index for output node " + std::string(name) + "!";
   throw dmlc::Error(msg);
@@ -0,0 +1,111 @@
+#include "dlr_vm_memory_pool.h"
+
+#include <tvm/runtime/device_api.h>
+
+#include <iterator>
+#include <vector>
+
+using namespace dlr;
+
+tvm::runtime::vm::Buffer VMMemoryPool::Alloc(size_t nbytes, size_t alignment,
+                                             DLDataType type_hint) {
+  tvm::runtime::vm::Buffer buffer;
+  buffer.size = (nbytes + kPageSize - 1) / kPageSize * kPageSize;
+  buffer.ctx = ctx_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(buffer.size);
+    if (it != idle_.end()) {
+      buffer.data = it->second;
+      idle_.erase(it);
+      idle_bytes_ -= buffer.size;
+      num_in_use_++;
+      return buffer;
+    }
+  }
+  tvm::runtime::DeviceAPI* device = tvm::runtime::DeviceAPI::Get(ctx_);
+  try {
+    buffer.data = device->AllocDataSpace(ctx_, buffer.size, alignment, type_hint);
+  } catch (const std::exception&) {
+    // Retry with the idle blocks released, as TVM's pools do when the device is out of memory.
+    TrimIdle(0);
+    buffer.data = device->AllocDataSpace(ctx_, buffer.size, alignment, type_hint);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  used_bytes_ += buffer.size;
+  num_in_use_++;
+  return buffer;
+}
+
+void VMMemoryPool::Free(const tvm::runtime::vm::Buffer& buffer) {
+  bool delete_pool = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_in_use_--;
+    if (!detached_) {
+      idle_.emplace(buffer.size, buffer.data);
+      idle_bytes_ += buffer.size;
+      return;
+    }
+    used_bytes_ -= buffer.size;
+    delete_pool = num_in_use_ == 0;
+  }
+  tvm::runtime::DeviceAPI::Get(ctx_)->FreeDataSpace(ctx_, buffer.data);
+  if (delete_pool) delete this;
+}
+
+size_t VMMemoryPool::UsedMemory() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_bytes_;
+}
+
+size_t VMMemoryPool::GetIdleBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_bytes_;
+}
+
+size_t VMMemoryPool::TrimIdle(size_t watermark_bytes) {
+  std::vector<void*> released;
+  size_t released_bytes = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (idle_bytes_ > watermark_bytes) {
+      auto largest = std::prev(idle_.end());
+      released.push_back(largest->second);
+      idle_bytes_ -= largest->first;
+      used_bytes_ -= largest->first;
+      released_bytes += largest->first;
+      idle_.erase(largest);
+    }
+  }
+  // Device calls are made without the lock, so that other models are not blocked on them.
+  tvm::runtime::DeviceAPI* device = tvm::runtime::DeviceAPI::Get(ctx_);
+  for (void* data : released) {
+    device->FreeDataSpace(ctx_, data);
+  }
+  return released_bytes;
+}
+
+void VMMemoryPool::Detach() {
+  const DLContext ctx = ctx_;
+  std::vector<void*> released;
+  bool delete_pool;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Blocks freed from now on are released at once, so no idle block is left behind.
+    detached_ = true;
+    for (const auto& block : idle_) {
+      released.push_back(block.second);
+      used_bytes_ -= block.first;
+    }
+    idle_.clear();
+    idle_bytes_ = 0;
+    delete_pool = num_in_use_ == 0;
+  }
+  // Unless no block is in use, a concurrent Free may delete the pool from here on.
+  tvm::runtime::DeviceAPI* device = tvm::runtime::DeviceAPI::Get(ctx);
+  for (void* data : released) {
+    device->FreeDataSpace(ctx, data);
+  }
+  if (delete_pool) delete this;
+}
@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+
 #include "dlr_relayvm.h"
 #include "test_utils.hpp"
 
@@ -147,6 +149,518 @@ TEST(DLR, DataTransformMultipleColumn) {
   }
 }
 
+TEST(DLR, CategoricalStringTable) {
+  nlohmann::json mapping = nlohmann::json::object();
+  for (int i = 0; i < 1000; ++i) {
+    mapping["key" + std::to_string(i)] = i;
+  }
+  mapping[""] = 1000;
+  mapping["not a number"] = "x";
+  dlr::CategoricalStringTable table(mapping, -1.0f);
+  EXPECT_EQ(table.size(), 1002);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(table.Find("key" + std::to_string(i)), i);
+  }
+  EXPECT_EQ(table.Find(""), 1000);
+  EXPECT_EQ(table.Find("not a number"), -1.0f);
+  EXPECT_EQ(table.Find("key1000"), -1.0f);
+  EXPECT_EQ(table.Find("key"), -1.0f);
+}
+
+TEST(DLR, DataTransformCategoricalStringCompiled) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [
+            {
+              "Type": "CategoricalString",
+              "Map": [{ "apple": 0, "banana": 1, "7": 2 }, { "a long category name": 5 }]
+            }
+          ]
+        }
+      }
+    })"_json;
+  const char* data =
+      R"([["apple", "a long category name"], ["banana", "apple"], ["7", 7], [7, null]])";
+  std::vector<int64_t> shape = {static_cast<int64_t>(std::strlen(data))};
+  std::vector<DLDataType> dtypes = {DLDataType{kDLFloat, 32, 1}};
+  DLContext ctx = DLContext{kDLCPU, 0};
+
+  // Compiled tables give the same result as looking up the JSON map.
+  dlr::DataTransform json_transform;
+  std::vector<tvm::runtime::NDArray> expected(1);
+  EXPECT_NO_THROW(json_transform.TransformInput(metadata, shape.data(), data, shape.size(),
+                                                dtypes, ctx, &expected));
+  dlr::DataTransform compiled_transform;
+  EXPECT_NO_THROW(compiled_transform.CompileInputTransform(metadata));
+  std::vector<tvm::runtime::NDArray> transformed_data(1);
+  EXPECT_NO_THROW(compiled_transform.TransformInput(metadata, shape.data(), data, shape.size(),
+                                                    dtypes, ctx, &transformed_data));
+  std::vector<float> expected_output = {0, 5, 1, -1, 2, -1, -1, -1};
+  for (size_t i = 0; i < expected_output.size(); ++i) {
+    EXPECT_EQ(static_cast<float*>(expected[0]->data)[i], expected_output[i]);
+    EXPECT_EQ(static_cast<float*>(transformed_data[0]->data)[i], expected_output[i]);
+  }
+}
+
+TEST(DLR, ParseFloat) {
+  const float kInf = std::numeric_limits<float>::infinity();
+  float value = 0;
+  EXPECT_TRUE(dlr::ParseFloat("2.345", &value));
+  EXPECT_EQ(value, 2.345f);
+  EXPECT_TRUE(dlr::ParseFloat("  -9.7e-2xyz", &value));
+  EXPECT_EQ(value, -9.7e-2f);
+  EXPECT_TRUE(dlr::ParseFloat("1e", &value));
+  EXPECT_EQ(value, 1.0f);
+  EXPECT_TRUE(dlr::ParseFloat("-0", &value));
+  EXPECT_TRUE(value == 0.0f && std::signbit(value));
+  EXPECT_TRUE(dlr::ParseFloat("-InFinITy", &value));
+  EXPECT_EQ(value, -kInf);
+  EXPECT_TRUE(dlr::ParseFloat("nan", &value));
+  EXPECT_TRUE(std::isnan(value));
+  EXPECT_TRUE(dlr::ParseFloat("0x1A", &value));
+  EXPECT_EQ(value, 26.0f);
+  EXPECT_TRUE(dlr::ParseFloat("-0x1p3", &value));
+  EXPECT_EQ(value, -8.0f);
+  EXPECT_FALSE(dlr::ParseFloat("", &value));
+  EXPECT_FALSE(dlr::ParseFloat("null", &value));
+  EXPECT_FALSE(dlr::ParseFloat("-.e5", &value));
+  EXPECT_FALSE(dlr::ParseFloat("1e39", &value));
+
+  // Same result as strtof, including the slow path for long mantissas and large exponents.
+  const char* formats[] = {"%.3f", "%.9g", "%.17g", "%.6e"};
+  uint32_t seed = 1;
+  for (int i = 0; i < 20000; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    const double x = (static_cast<double>(seed) / 4294967296.0 - 0.5) * std::pow(10.0, i % 40 - 20);
+    char str[64];
+    std::snprintf(str, sizeof(str), formats[i % 4], x);
+    EXPECT_TRUE(dlr::ParseFloat(str, &value));
+    EXPECT_EQ(value, std::strtof(str, nullptr)) << str;
+  }
+}
+
+TEST(DLR, DataTransformFloatLargeBatch) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [{ "Type": "Float" }]
+        }
+      }
+    })"_json;
+  // Enough rows to be split across threads.
+  const int num_row = 5000;
+  std::string data = "[";
+  for (int r = 0; r < num_row; ++r) {
+    data += (r ? ",[\"" : "[\"") + std::to_string(r) + ".5\", " + std::to_string(-r) + ", \"x\"]";
+  }
+  data += "]";
+  std::vector<int64_t> shape = {static_cast<int64_t>(data.size())};
+  std::vector<DLDataType> dtypes = {DLDataType{kDLFloat, 32, 1}};
+  DLContext ctx = DLContext{kDLCPU, 0};
+  dlr::DataTransform transform;
+  std::vector<tvm::runtime::NDArray> transformed_data(1);
+  EXPECT_NO_THROW(transform.TransformInput(metadata, shape.data(), data.c_str(), shape.size(),
+                                           dtypes, ctx, &transformed_data));
+  EXPECT_EQ(transformed_data[0]->shape[0], num_row);
+  EXPECT_EQ(transformed_data[0]->shape[1], 3);
+  const float* out = static_cast<const float*>(transformed_data[0]->data);
+  for (int r = 0; r < num_row; ++r) {
+    EXPECT_EQ(out[r * 3], r + 0.5f);
+    EXPECT_EQ(out[r * 3 + 1], -r);
+    EXPECT_TRUE(std::isnan(out[r * 3 + 2]));
+  }
+}
+
+namespace {
+
+/*! \brief Builds dlr::ColumnarInput buffers. */
+class ColumnarWriter {
+ public:
+  explicit ColumnarWriter(uint32_t num_rows) {
+    buffer_ = "DLRC";
+    Put<uint32_t>(1);
+    Put<uint32_t>(num_rows);
+    Put<uint32_t>(0);
+  }
+
+  template <typename T>
+  void AddNumbers(dlr::ColumnarInput::ColumnType type, const std::vector<T>& values) {
+    AddColumn(type);
+    for (T value : values) Put<T>(value);
+  }
+
+  void AddStrings(const std::vector<std::string>& values) {
+    AddColumn(dlr::ColumnarInput::kString);
+    PutStrings(values);
+  }
+
+  void AddDictionary(const std::vector<std::string>& dictionary,
+                     const std::vector<uint32_t>& codes) {
+    AddColumn(dlr::ColumnarInput::kDictionary);
+    Put<uint32_t>(dictionary.size());
+    PutStrings(dictionary);
+    for (uint32_t code : codes) Put<uint32_t>(code);
+  }
+
+  const std::string& buffer() const { return buffer_; }
+
+ private:
+  std::string buffer_;
+
+  template <typename T>
+  void Put(T value) {
+    buffer_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void AddColumn(dlr::ColumnarInput::ColumnType type) {
+    uint32_t num_cols;
+    std::memcpy(&num_cols, &buffer_[12], sizeof(num_cols));
+    ++num_cols;
+    std::memcpy(&buffer_[12], &num_cols, sizeof(num_cols));
+    Put<uint32_t>(type);
+  }
+
+  void PutStrings(const std::vector<std::string>& values) {
+    uint32_t offset = 0;
+    Put<uint32_t>(offset);
+    for (const std::string& value : values) Put<uint32_t>(offset += value.size());
+    for (const std::string& value : values) buffer_ += value;
+  }
+};
+
+}  // namespace
+
+TEST(DLR, DataTransformColumnarInput) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [
+            {
+              "Type": "Float"
+            },
+            {
+              "Type": "CategoricalString",
+              "Map": [{}, {}, {}, { "apple": 0, "banana": 1 }, { "apple": 2, "7": 3 }]
+            }
+          ]
+        }
+      }
+    })"_json;
+  ColumnarWriter writer(3);
+  writer.AddNumbers<float>(dlr::ColumnarInput::kFloat32, {1.5f, -2.0f, 3.25f});
+  writer.AddNumbers<double>(dlr::ColumnarInput::kFloat64, {0.1, 1e10, -7.0});
+  writer.AddNumbers<int64_t>(dlr::ColumnarInput::kInt64, {7, -8, 9});
+  writer.AddStrings({"banana", "2.5", "apple"});
+  writer.AddDictionary({"7", "apple", "x"}, {1, 0, dlr::ColumnarInput::kNullCode});
+  const std::string& data = writer.buffer();
+  std::vector<int64_t> shape = {static_cast<int64_t>(data.size())};
+  std::vector<DLDataType> dtypes = {DLDataType{kDLFloat, 32, 1}, DLDataType{kDLFloat, 32, 1}};
+  DLContext ctx = DLContext{kDLCPU, 0};
+  const float kNan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> expected_float = {1.5f, 0.1f, 7,    kNan, kNan, -2.0f, 1e10f, -8,
+                                       2.5f, 7,    3.25f, -7,  9,    kNan, kNan};
+  std::vector<float> expected_string = {-1, -1, -1, 1, 2, -1, -1, -1, -1, 3, -1, -1, -1, 0, -1};
+
+  dlr::DataTransform json_transform;
+  dlr::DataTransform compiled_transform;
+  EXPECT_NO_THROW(compiled_transform.CompileInputTransform(metadata));
+  for (const dlr::DataTransform* transform : {&json_transform, &compiled_transform}) {
+    std::vector<tvm::runtime::NDArray> transformed_data(2);
+    EXPECT_NO_THROW(transform->TransformInput(metadata, shape.data(), data.data(), shape.size(),
+                                              dtypes, ctx, &transformed_data));
+    EXPECT_EQ(transformed_data[0]->shape[0], 3);
+    EXPECT_EQ(transformed_data[0]->shape[1], 5);
+    for (size_t i = 0; i < expected_float.size(); ++i) {
+      ExpectFloatEq(static_cast<float*>(transformed_data[0]->data)[i], expected_float[i]);
+      EXPECT_EQ(static_cast<float*>(transformed_data[1]->data)[i], expected_string[i]);
+    }
+  }
+
+  // Truncated, trailing bytes, bad dictionary code.
+  std::vector<tvm::runtime::NDArray> transformed_data(2);
+  shape[0] = data.size() - 1;
+  EXPECT_THROW(json_transform.TransformInput(metadata, shape.data(), data.data(), shape.size(),
+                                             dtypes, ctx, &transformed_data),
+               dmlc::Error);
+  const std::string padded = data + " ";
+  shape[0] = padded.size();
+  EXPECT_THROW(json_transform.TransformInput(metadata, shape.data(), padded.data(), shape.size(),
+                                             dtypes, ctx, &transformed_data),
+               dmlc::Error);
+  ColumnarWriter bad_writer(1);
+  bad_writer.AddDictionary({"a"}, {1});
+  shape[0] = bad_writer.buffer().size();
+  EXPECT_THROW(json_transform.TransformInput(metadata, shape.data(), bad_writer.buffer().data(),
+                                             shape.size(), dtypes, ctx, &transformed_data),
+               dmlc::Error);
+}
+
+TEST(DLR, DataTransformScalers) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [
+            { "Type": "StandardScaler", "Mean": [2, 0], "Scale": [2, 0] },
+            { "Type": "MinMax", "Scale": [0.5, 0.25], "Min": [1, 0] },
+            { "Type": "Imputer", "Statistics": [10, 20], "MissingValue": -1 }
+          ]
+        }
+      }
+    })"_json;
+  const char* json_data = R"([[1, "4"], [3, null], ["x", -1]])";
+  ColumnarWriter writer(3);
+  writer.AddStrings({"1", "3", "x"});
+  writer.AddNumbers<float>(dlr::ColumnarInput::kFloat32,
+                           {4, std::numeric_limits<float>::quiet_NaN(), -1});
+  const float kNan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<std::vector<float>> expected_output = {{-0.5f, 4, 0.5f, kNan, kNan, -1},
+                                                     {1.5f, 1, 2.5f, kNan, kNan, -0.25f},
+                                                     {1, 4, 3, 20, 10, 20}};
+  std::vector<DLDataType> dtypes(3, DLDataType{kDLFloat, 32, 1});
+  DLContext ctx = DLContext{kDLCPU, 0};
+
+  dlr::DataTransform json_transform;
+  dlr::DataTransform compiled_transform;
+  EXPECT_NO_THROW(compiled_transform.CompileInputTransform(metadata));
+  for (const std::string& data : {std::string(json_data), writer.buffer()}) {
+    std::vector<int64_t> shape = {static_cast<int64_t>(data.size())};
+    for (const dlr::DataTransform* transform : {&json_transform, &compiled_transform}) {
+      std::vector<tvm::runtime::NDArray> transformed_data(3);
+      EXPECT_NO_THROW(transform->TransformInput(metadata, shape.data(), data.data(),
+                                                shape.size(), dtypes, ctx, &transformed_data));
+      for (size_t i = 0; i < expected_output.size(); ++i) {
+        EXPECT_EQ(transformed_data[i]->shape[0], 3);
+        EXPECT_EQ(transformed_data[i]->shape[1], 2);
+        for (size_t j = 0; j < expected_output[i].size(); ++j) {
+          ExpectFloatEq(static_cast<float*>(transformed_data[i]->data)[j], expected_output[i][j]);
+        }
+      }
+    }
+  }
+
+  // Parameters must have one value per column.
+  metadata["DataTransform"]["Input"]["ColumnTransform"][1]["Min"] = {1, 0, 0};
+  std::vector<int64_t> shape = {static_cast<int64_t>(std::strlen(json_data))};
+  std::vector<tvm::runtime::NDArray> transformed_data(3);
+  EXPECT_THROW(json_transform.TransformInput(metadata, shape.data(), json_data, shape.size(),
+                                             dtypes, ctx, &transformed_data),
+               dmlc::Error);
+}
+
+TEST(DLR, DataTransformOneHot) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [
+            { "Type": "OneHot", "Categories": [["a", "b", "c"], [0, 2.5, 7]] }
+          ]
+        }
+      }
+    })"_json;
+  // Strings and numbers only match categories of the same type.
+  const char* json_data = R"([["b", 7], ["c", 2.5], [null, "7"], ["a", -0.0], ["d", 1]])";
+  ColumnarWriter writer(5);
+  writer.AddDictionary({"a", "b", "c", "d"}, {1, 2, dlr::ColumnarInput::kNullCode, 0, 3});
+  writer.AddNumbers<double>(dlr::ColumnarInput::kFloat64, {7, 2.5, 3, -0.0, 1});
+  std::vector<float> expected_output = {0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 0, 0,
+                                        0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+  std::vector<DLDataType> dtypes = {DLDataType{kDLFloat, 32, 1}};
+  DLContext ctx = DLContext{kDLCPU, 0};
+
+  dlr::DataTransform json_transform;
+  dlr::DataTransform compiled_transform;
+  EXPECT_NO_THROW(compiled_transform.CompileInputTransform(metadata));
+  for (const std::string& data : {std::string(json_data), writer.buffer()}) {
+    std::vector<int64_t> shape = {static_cast<int64_t>(data.size())};
+    for (const dlr::DataTransform* transform : {&json_transform, &compiled_transform}) {
+      std::vector<tvm::runtime::NDArray> transformed_data(1);
+      EXPECT_NO_THROW(transform->TransformInput(metadata, shape.data(), data.data(),
+                                                shape.size(), dtypes, ctx, &transformed_data));
+      EXPECT_EQ(transformed_data[0]->shape[0], 5);
+      EXPECT_EQ(transformed_data[0]->shape[1], 6);
+      for (size_t i = 0; i < expected_output.size(); ++i) {
+        EXPECT_EQ(static_cast<float*>(transformed_data[0]->data)[i], expected_output[i]);
+      }
+    }
+  }
+
+  const char* bad_data = R"([["a", 0, 1]])";
+  std::vector<int64_t> shape = {static_cast<int64_t>(std::strlen(bad_data))};
+  std::vector<tvm::runtime::NDArray> transformed_data(1);
+  EXPECT_THROW(compiled_transform.TransformInput(metadata, shape.data(), bad_data, shape.size(),
+                                                 dtypes, ctx, &transformed_data),
+               dmlc::Error);
+}
+
+TEST(DLR, MurmurHash3) {
+  EXPECT_EQ(dlr::MurmurHash3("", 0), 0);
+  EXPECT_EQ(dlr::MurmurHash3("foo", 3), -156908512);
+  EXPECT_EQ(dlr::MurmurHash3("hello", 5), 613153351);
+}
+
+TEST(DLR, DataTransformHashing) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [
+            { "Type": "Hashing", "NumFeatures": 8, "Names": ["color", "size"] },
+            { "Type": "Hashing", "NumFeatures": 8, "AlternateSign": false }
+          ]
+        }
+      }
+    })"_json;
+  // Of 8 features, "color=red" and "color=blue" hash to 2, "size" to 6, "red" to 3, and "blue" and
+  // "1" to 5. Only the hash of "color=blue" is positive.
+  const char* json_data = R"([["red", 2], ["blue", null]])";
+  ColumnarWriter writer(2);
+  writer.AddDictionary({"red", "blue"}, {0, 1});
+  writer.AddNumbers<float>(dlr::ColumnarInput::kFloat32,
+                           {2, std::numeric_limits<float>::quiet_NaN()});
+  std::vector<std::vector<float>> expected_output = {
+      {0, 0, -1, 0, 0, 0, -2, 0, 0, 0, 1, 0, 0, 0, 0, 0},
+      {0, 0, 0, 1, 0, 2, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0}};
+  std::vector<DLDataType> dtypes(2, DLDataType{kDLFloat, 32, 1});
+  DLContext ctx = DLContext{kDLCPU, 0};
+
+  dlr::DataTransform transform;
+  for (const std::string& data : {std::string(json_data), writer.buffer()}) {
+    std::vector<int64_t> shape = {static_cast<int64_t>(data.size())};
+    std::vector<tvm::runtime::NDArray> transformed_data(2);
+    EXPECT_NO_THROW(transform.TransformInput(metadata, shape.data(), data.data(), shape.size(),
+                                             dtypes, ctx, &transformed_data));
+    for (size_t i = 0; i < expected_output.size(); ++i) {
+      EXPECT_EQ(transformed_data[i]->shape[0], 2);
+      EXPECT_EQ(transformed_data[i]->shape[1], 8);
+      for (size_t j = 0; j < expected_output[i].size(); ++j) {
+        EXPECT_EQ(static_cast<float*>(transformed_data[i]->data)[j], expected_output[i][j]);
+      }
+    }
+  }
+}
+
+TEST(DLR, DataTransformConcurrentInput) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Input": {
+          "ColumnTransform": [
+            { "Type": "OneHot", "Categories": [["a", "b"], [1, 2]] },
+            { "Type": "StandardScaler", "Mean": [1, 1], "Scale": [2, 4] }
+          ]
+        }
+      }
+    })"_json;
+  const int num_row = 1000;
+  std::string data = "[";
+  for (int r = 0; r < num_row; ++r) {
+    data += std::string(r ? "," : "") + (r % 2 ? "[\"a\", 2]" : "[\"b\", 1]");
+  }
+  data += "]";
+  std::vector<int64_t> shape = {static_cast<int64_t>(data.size())};
+  std::vector<DLDataType> dtypes(2, DLDataType{kDLFloat, 32, 1});
+  DLContext ctx = DLContext{kDLCPU, 0};
+  dlr::DataTransform transform;
+  transform.CompileInputTransform(metadata);
+
+  // Transformers and compiled tables are shared by all threads.
+  std::vector<int> failures(4, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < failures.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 10; ++i) {
+        std::vector<tvm::runtime::NDArray> transformed_data(2);
+        transform.TransformInput(metadata, shape.data(), data.data(), shape.size(), dtypes, ctx,
+                                 &transformed_data);
+        const float* one_hot = static_cast<const float*>(transformed_data[0]->data);
+        const float* scaled = static_cast<const float*>(transformed_data[1]->data);
+        for (int r = 0; r < num_row; ++r) {
+          const bool odd = r % 2;
+          if (one_hot[r * 4] != odd || one_hot[r * 4 + 1] != !odd || one_hot[r * 4 + 2] != !odd ||
+              one_hot[r * 4 + 3] != odd || scaled[r * 2 + 1] != (odd ? 0.25f : 0.0f)) {
+            ++failures[t];
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  for (int count : failures) EXPECT_EQ(count, 0);
+}
+
+TEST(DLR, DataTransformOutput) {
+  nlohmann::json metadata = R"(
+    {
+      "DataTransform": {
+        "Output": {
+          "0": {
+            "CategoricalString": { "0": "cat", "1": "dog", "2": "say \"hi\"", "01": "bad key" }
+          },
+          "1": {
+            "CategoricalString": { "-5": "low", "1000000": "high" }
+          }
+        }
+      }
+    })"_json;
+  dlr::DataTransform transform;
+  EXPECT_TRUE(transform.HasOutputTransform(metadata, 0));
+  EXPECT_TRUE(transform.HasOutputTransform(metadata, 1));
+  EXPECT_FALSE(transform.HasOutputTransform(metadata, 2));
+  DLContext ctx = DLContext{kDLCPU, 0};
+  tvm::runtime::NDArray labels = tvm::runtime::NDArray::Empty({4}, {kDLInt, 32, 1}, ctx);
+  int* data = static_cast<int*>(labels->data);
+  data[0] = 1;
+  data[1] = 2;
+  data[2] = 1;
+  data[3] = 3;
+  EXPECT_NO_THROW(transform.TransformOutput(metadata, 0, labels));
+  const std::string expected = R"(["dog","say \"hi\"","dog","<unknown_label>"])";
+  int64_t size;
+  int dim;
+  EXPECT_NO_THROW(transform.GetOutputSizeDim(0, &size, &dim));
+  EXPECT_EQ(size, expected.size());
+  EXPECT_EQ(dim, 1);
+  std::string output(size, '\0');
+  EXPECT_NO_THROW(transform.GetOutput(0, &output[0]));
+  EXPECT_EQ(output, expected);
+
+  // Sparse keys, 2-D output, and a second run reusing the buffer.
+  tvm::runtime::NDArray matrix = tvm::runtime::NDArray::Empty({2, 2}, {kDLInt, 32, 1}, ctx);
+  data = static_cast<int*>(matrix->data);
+  data[0] = -5;
+  data[1] = 1000000;
+  data[2] = 0;
+  data[3] = -5;
+  EXPECT_NO_THROW(transform.TransformOutput(metadata, 1, matrix));
+  EXPECT_EQ(std::string(static_cast<const char*>(transform.GetOutputPtr(1))),
+            R"([["low","high"],["<unknown_label>","low"]])");
+  data[0] = 1000000;
+  EXPECT_NO_THROW(transform.TransformOutput(metadata, 1, matrix));
+  int64_t shape[1];
+  transform.GetOutputShape(1, shape);
+  const char* ptr = static_cast<const char*>(transform.GetOutputPtr(1));
+  EXPECT_EQ(std::string(ptr, ptr + shape[0]), R"([["high","high"],["<unknown_label>","low"]])");
+
+  // Labels compiled at load give the same output.
+  dlr::DataTransform compiled_transform;
+  EXPECT_NO_THROW(compiled_transform.CompileOutputTransform(metadata, 0));
+  EXPECT_THROW(compiled_transform.GetOutputShape(0, shape), dmlc::Error);
+  EXPECT_THROW(compiled_transform.GetOutputSizeDim(0, &size, &dim), dmlc::Error);
+  EXPECT_THROW(compiled_transform.GetOutputPtr(0), dmlc::Error);
+  EXPECT_NO_THROW(compiled_transform.TransformOutput(metadata, 0, labels));
+  ptr = static_cast<const char*>(compiled_transform.GetOutputPtr(0));
+  EXPECT_EQ(std::string(ptr, ptr + expected.size()), expected);
+
+  tvm::runtime::NDArray floats = tvm::runtime::NDArray::Empty({2}, {kDLFloat, 32, 1}, ctx);
+  EXPECT_THROW(transform.TransformOutput(metadata, 0, floats), dmlc::Error);
+}
+
 TEST(DLR, RelayVMDataTransformInput) {
   DLContext ctx = {kDLCPU, 0};
   std::vector<std::string> paths = {"./automl"};
@@ -190,6 +704,8 @@ TEST(DLR, RelayVMDataTransformOutput) {
   std::vector<std::string> paths = {"./inverselabel"};
   std::vector<std::string> files = dlr::FindFiles(paths);
   dlr::RelayVMModel* model = new dlr::RelayVMModel(files, ctx);
+  int64_t shape_before_run[1];
+  EXPECT_THROW(model->GetOutputShape(0, shape_before_run), dmlc::Error);
 
   std::vector<int> input_data = {0, 1, 2, 3, -75};
   std::vector<int64_t> shape = {5};
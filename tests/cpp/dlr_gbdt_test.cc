@@ -0,0 +1,140 @@
+#include "dlr_gbdt.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+namespace {
+
+// f0 < 0.5 (missing: left) ? 0.2 : (f1 < 1 (missing: right) ? -0.1 : 0.4), plus a constant tree.
+const char* kXGBoostModel = R"({
+  "learner": {
+    "learner_model_param": {"base_score": "5E-1", "num_class": "0", "num_feature": "3"},
+    "objective": {"name": "binary:logistic"},
+    "gradient_booster": {
+      "name": "gbtree",
+      "model": {
+        "tree_info": [0, 0],
+        "trees": [
+          {"left_children": [1, -1, 3, -1, -1], "right_children": [2, -1, 4, -1, -1],
+           "split_indices": [0, 0, 1, 0, 0], "split_conditions": [0.5, 0.2, 1.0, -0.1, 0.4],
+           "default_left": [1, 0, 0, 0, 0]},
+          {"left_children": [-1], "right_children": [-1], "split_indices": [0],
+           "split_conditions": [0.05], "default_left": [0]}
+        ]
+      }
+    }
+  },
+  "version": [1, 2, 0]
+})";
+
+// f0 <= 1 (missing as zero) ? 1 : (f1 <= 0 (zero is missing: left) ? 2 : 3), plus a constant tree.
+const char* kLightGBMModel = R"({
+  "name": "tree", "version": "v3", "num_class": 1, "num_tree_per_iteration": 1,
+  "max_feature_idx": 1, "objective": "regression", "average_output": false,
+  "tree_info": [
+    {"tree_index": 0, "tree_structure": {
+      "split_feature": 0, "threshold": 1.0, "decision_type": "<=", "default_left": false,
+      "missing_type": "None",
+      "left_child": {"leaf_value": 1.0},
+      "right_child": {
+        "split_feature": 1, "threshold": 0.0, "decision_type": "<=", "default_left": true,
+        "missing_type": "Zero",
+        "left_child": {"leaf_value": 2.0}, "right_child": {"leaf_value": 3.0}}}},
+    {"tree_index": 1, "tree_structure": {"leaf_value": 0.5}}
+  ]
+})";
+
+std::string WriteModel(const std::string& path, const std::string& json) {
+  std::ofstream file(path);
+  file << json;
+  return path;
+}
+
+dlr::GBDTModel* LoadModel(const std::string& path) {
+  DLContext ctx = {kDLCPU, 0};
+  std::vector<std::string> files = dlr::FindFiles({path});
+  return new dlr::GBDTModel(files, ctx);
+}
+
+}  // namespace
+
+TEST(GBDTTest, TestGetBackend) {
+  const std::string xgboost = WriteModel("./gbdt_xgboost_test.json", kXGBoostModel);
+  const std::string lightgbm = WriteModel("./gbdt_lightgbm_test.json", kLightGBMModel);
+  EXPECT_EQ(dlr::GetBackend(dlr::FindFiles({xgboost})), dlr::DLRBackend::kGBDT);
+  EXPECT_EQ(dlr::GetBackend(dlr::FindFiles({lightgbm})), dlr::DLRBackend::kGBDT);
+  std::remove(xgboost.c_str());
+  std::remove(lightgbm.c_str());
+}
+
+TEST(GBDTTest, TestXGBoost) {
+  const std::string path = WriteModel("./gbdt_xgboost_test.json", kXGBoostModel);
+  dlr::GBDTModel* model = LoadModel(path);
+  EXPECT_EQ(model->GetBackend(), dlr::DLRBackend::kGBDT);
+  EXPECT_EQ(model->GetNumTrees(), 2);
+  std::vector<int64_t> shape{-1, 3};
+  EXPECT_EQ(model->GetInputShape(0), shape);
+
+  // Two columns only, the third is padded with missing values. More rows than one AVX2 step.
+  const float rows[5][2] = {{0.1f, 0.0f}, {0.7f, 0.5f}, {0.7f, 2.0f}, {NAN, 2.0f}, {0.7f, NAN}};
+  const float margins[5] = {0.25f, -0.05f, 0.45f, 0.25f, 0.45f};
+  const int64_t num_row = 10;
+  std::vector<float> input;
+  for (int64_t i = 0; i < num_row; i++) input.insert(input.end(), rows[i % 5], rows[i % 5] + 2);
+  const int64_t in_shape[2] = {num_row, 2};
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, input.data(), 2));
+  EXPECT_NO_THROW(model->Run());
+  int64_t out_shape[2];
+  model->GetOutputShape(0, out_shape);
+  EXPECT_EQ(out_shape[0], num_row);
+  EXPECT_EQ(out_shape[1], 1);
+  std::vector<float> output(num_row);
+  EXPECT_NO_THROW(model->GetOutput(0, output.data()));
+  for (int64_t i = 0; i < num_row; i++) {
+    EXPECT_NEAR(output[i], 1.0f / (1.0f + std::exp(-margins[i % 5])), 1e-6f) << "row " << i;
+  }
+
+  const int64_t bad_shape[2] = {1, 4};
+  EXPECT_THROW(model->SetInput("data", bad_shape, input.data(), 2), dmlc::Error);
+  delete model;
+  std::remove(path.c_str());
+}
+
+TEST(GBDTTest, TestLightGBM) {
+  const std::string path = WriteModel("./gbdt_lightgbm_test.json", kLightGBMModel);
+  dlr::GBDTModel* model = LoadModel(path);
+  EXPECT_EQ(model->GetNumTrees(), 2);
+  // f0 == threshold goes left, NaN is compared as zero, and f1 zero or NaN go to the default.
+  const float input[6][2] = {{1.0f, 5.0f}, {NAN, 5.0f}, {2.0f, 0.0f},
+                             {2.0f, NAN},  {2.0f, 0.5f}, {2.0f, -0.5f}};
+  const float expected[6] = {1.5f, 1.5f, 2.5f, 2.5f, 3.5f, 2.5f};
+  const int64_t in_shape[2] = {6, 2};
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, &input[0][0], 2));
+  EXPECT_NO_THROW(model->Run());
+  float output[6];
+  EXPECT_NO_THROW(model->GetOutput(0, output));
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(output[i], expected[i]) << "row " << i;
+  }
+  delete model;
+  std::remove(path.c_str());
+}
+
+TEST(GBDTTest, TestUnsupportedModel) {
+  std::string json = kLightGBMModel;
+  json.replace(json.find("\"<=\""), 4, "\"==\"");
+  const std::string path = WriteModel("./gbdt_categorical_test.json", json);
+  EXPECT_THROW(LoadModel(path), dmlc::Error);
+  std::remove(path.c_str());
+}
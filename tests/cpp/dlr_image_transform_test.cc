@@ -0,0 +1,357 @@
+#include "dlr_image_transform.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "dlr_data_transform.h"
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+namespace {
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+
+std::vector<uint8_t> MakeImage(int64_t height, int64_t width, int64_t channels) {
+  std::vector<uint8_t> image(height * width * channels);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>((i * 37 + i / 7) % 256);
+  }
+  return image;
+}
+
+// Straightforward bilinear sample with aligned pixel centers, like OpenCV INTER_LINEAR.
+template <typename T>
+float Sample(const std::vector<T>& image, int64_t height, int64_t width, int64_t channels,
+             int64_t c, double y, double x) {
+  y = std::max(y, 0.0);
+  x = std::max(x, 0.0);
+  const int64_t y0 = std::min<int64_t>(y, height - 1);
+  const int64_t x0 = std::min<int64_t>(x, width - 1);
+  const int64_t y1 = std::min<int64_t>(y0 + 1, height - 1);
+  const int64_t x1 = std::min<int64_t>(x0 + 1, width - 1);
+  const double wy = y1 == y0 ? 0 : y - y0;
+  const double wx = x1 == x0 ? 0 : x - x0;
+  auto at = [&](int64_t yy, int64_t xx) { return image[(yy * width + xx) * channels + c]; };
+  const double top = at(y0, x0) + wx * (at(y0, x1) - at(y0, x0));
+  const double bottom = at(y1, x0) + wx * (at(y1, x1) - at(y1, x0));
+  return top + wy * (bottom - top);
+}
+
+// Reference conversion of a YUV pixel to RGB, with BT.601 limited range or BT.709 full range.
+void ToRGB(double y, double u, double v, bool bt709, double* rgb) {
+  const double l = bt709 ? y : (y - 16) * 255.0 / 219.0;
+  const double cu = (u - 128) * (bt709 ? 1.0 : 255.0 / 224.0);
+  const double cv = (v - 128) * (bt709 ? 1.0 : 255.0 / 224.0);
+  const double r = l + (bt709 ? 1.5748 : 1.402) * cv;
+  const double g = l - (bt709 ? 0.187324 : 0.344136) * cu - (bt709 ? 0.468124 : 0.714136) * cv;
+  const double b = l + (bt709 ? 1.8556 : 1.772) * cu;
+  rgb[0] = std::min(std::max(r, 0.0), 255.0);
+  rgb[1] = std::min(std::max(g, 0.0), 255.0);
+  rgb[2] = std::min(std::max(b, 0.0), 255.0);
+}
+
+// Bilinear sample of channel c of an image of Y, U, V pixels. Y, U and V are blended vertically,
+// converted to RGB and then blended horizontally.
+float SampleYUV(const std::vector<uint8_t>& yuv, int64_t height, int64_t width, bool bt709,
+                int64_t c, double y, double x) {
+  x = std::max(x, 0.0);
+  const int64_t x0 = std::min<int64_t>(x, width - 1);
+  const double wx = x0 + 1 < width ? x - x0 : 0.0;
+  double rgb[2][3];
+  for (int i = 0; i < 2; ++i) {
+    const double column = std::min<int64_t>(x0 + i, width - 1);
+    double pixel[3];
+    for (int k = 0; k < 3; ++k) pixel[k] = Sample(yuv, height, width, 3, k, y, column);
+    ToRGB(pixel[0], pixel[1], pixel[2], bt709, rgb[i]);
+  }
+  return rgb[0][c] + wx * (rgb[1][c] - rgb[0][c]);
+}
+
+}  // namespace
+
+TEST(ImageTransform, ResizeNormalizeNCHW) {
+  nlohmann::json config = R"({
+    "ChannelOrder": "BGR", "Scale": 0.5, "Mean": [1, 2, 3], "Std": [2, 4, 8]
+  })"_json;
+  dlr::ImageTransform transform(config, "data", {1, 3, 5, 7});
+  // Columns are shrunk by more than half, rows by less.
+  const int64_t shape[4] = {2, 9, 16, 3};
+  EXPECT_EQ(transform.GetOutputShape(shape, 4), std::vector<int64_t>({2, 3, 5, 7}));
+  const std::vector<uint8_t> images = MakeImage(2 * 9, 16, 3);
+  std::vector<float> out(2 * 3 * 5 * 7);
+  transform.Apply(images.data(), shape, 4, kFloat32, out.data());
+
+  const float mean[3] = {1, 2, 3};
+  const float stddev[3] = {2, 4, 8};
+  for (int64_t n = 0; n < 2; ++n) {
+    const std::vector<uint8_t> image(images.begin() + n * 9 * 16 * 3,
+                                     images.begin() + (n + 1) * 9 * 16 * 3);
+    for (int64_t c = 0; c < 3; ++c) {
+      for (int64_t y = 0; y < 5; ++y) {
+        for (int64_t x = 0; x < 7; ++x) {
+          // Model channel c is image channel 2 - c.
+          const float pixel =
+              Sample(image, 9, 16, 3, 2 - c, (y + 0.5) * 9 / 5 - 0.5, (x + 0.5) * 16 / 7 - 0.5);
+          const float expected = (pixel * 0.5f - mean[c]) / stddev[c];
+          EXPECT_NEAR(out[((n * 3 + c) * 5 + y) * 7 + x], expected, 1e-4f)
+              << n << " " << c << " " << y << " " << x;
+        }
+      }
+    }
+  }
+}
+
+TEST(ImageTransform, NearestNHWC) {
+  nlohmann::json config =
+      R"({ "Layout": "NHWC", "Resize": "Nearest", "Height": 2, "Width": 3 })"_json;
+  dlr::ImageTransform transform(config, "data", {1, -1, -1, 1});
+  const int64_t shape[3] = {4, 6, 1};
+  EXPECT_EQ(transform.GetOutputShape(shape, 3), std::vector<int64_t>({1, 2, 3, 1}));
+  std::vector<uint8_t> image(24);
+  for (int i = 0; i < 24; ++i) image[i] = i;
+  std::vector<float> out(6);
+  transform.Apply(image.data(), shape, 3, kFloat32, out.data());
+  // Rows 1 and 3, columns 1, 3 and 5.
+  const std::vector<float> expected = {7, 9, 11, 19, 21, 23};
+  EXPECT_EQ(out, expected);
+
+  const int64_t bad_channels[3] = {4, 6, 3};
+  EXPECT_THROW(transform.Apply(image.data(), bad_channels, 3, kFloat32, out.data()), dmlc::Error);
+}
+
+TEST(ImageTransform, NV12) {
+  dlr::ImageTransform transform(R"({ "Mean": [10, 20, 30] })"_json, "data", {1, 3, 4, 5});
+  // 6x8 frame with padded rows.
+  const int64_t height = 6, width = 8, stride = 10;
+  const std::vector<uint8_t> luma = MakeImage(height, stride, 1);
+  std::vector<uint8_t> nv12 = MakeImage(height / 2, stride, 1);
+  std::vector<uint8_t> nv21(nv12.size());
+  for (size_t i = 0; i < nv12.size(); i += 2) {
+    nv21[i] = nv12[i + 1];
+    nv21[i + 1] = nv12[i];
+  }
+  std::vector<uint8_t> yuv(height * width * 3);
+  for (int64_t y = 0; y < height; ++y) {
+    for (int64_t x = 0; x < width; ++x) {
+      const uint8_t* uv = &nv12[(y / 2) * stride + (x / 2) * 2];
+      yuv[(y * width + x) * 3] = luma[y * stride + x];
+      yuv[(y * width + x) * 3 + 1] = uv[0];
+      yuv[(y * width + x) * 3 + 2] = uv[1];
+    }
+  }
+  dlr::ImageView images[2];
+  images[0].format = dlr::ImageView::Format::kNV12;
+  images[0].width = width;
+  images[0].height = height;
+  images[0].planes[0] = luma.data();
+  images[0].planes[1] = nv12.data();
+  images[0].strides[0] = images[0].strides[1] = stride;
+  images[1] = images[0];
+  images[1].format = dlr::ImageView::Format::kNV21;
+  images[1].planes[1] = nv21.data();
+  EXPECT_EQ(transform.GetOutputShape(2), std::vector<int64_t>({2, 3, 4, 5}));
+  std::vector<float> out(2 * 3 * 4 * 5);
+  transform.Apply(images, 2, kFloat32, out.data());
+
+  const float mean[3] = {10, 20, 30};
+  for (int64_t n = 0; n < 2; ++n) {
+    for (int64_t c = 0; c < 3; ++c) {
+      for (int64_t y = 0; y < 4; ++y) {
+        for (int64_t x = 0; x < 5; ++x) {
+          const float pixel = SampleYUV(yuv, height, width, false, c, (y + 0.5) * 6 / 4 - 0.5,
+                                        (x + 0.5) * 8 / 5 - 0.5);
+          EXPECT_NEAR(out[((n * 3 + c) * 4 + y) * 5 + x], pixel - mean[c], 1e-3f)
+              << n << " " << c << " " << y << " " << x;
+        }
+      }
+    }
+  }
+
+  images[0].strides[1] = width - 2;
+  EXPECT_THROW(transform.Apply(images, 1, kFloat32, out.data()), dmlc::Error);
+}
+
+TEST(ImageTransform, I420Crop) {
+  nlohmann::json config = R"({
+    "Layout": "NHWC", "ChannelOrder": "BGR", "YUVMatrix": "BT709", "YUVRange": "Full"
+  })"_json;
+  dlr::ImageTransform transform(config, "data", {1, 3, 3, 3});
+  const int64_t height = 8, width = 12;
+  const std::vector<uint8_t> luma = MakeImage(height, width, 1);
+  const std::vector<uint8_t> u = MakeImage(height / 2, width / 2, 1);
+  std::vector<uint8_t> v(u.rbegin(), u.rend());
+  // Reference is the 5x6 crop at (4, 2).
+  const int64_t crop_x = 4, crop_y = 2, crop_height = 5, crop_width = 6;
+  std::vector<uint8_t> yuv(crop_height * crop_width * 3);
+  for (int64_t y = 0; y < crop_height; ++y) {
+    for (int64_t x = 0; x < crop_width; ++x) {
+      const int64_t sy = y + crop_y, sx = x + crop_x;
+      const int64_t chroma = (sy / 2) * (width / 2) + sx / 2;
+      yuv[(y * crop_width + x) * 3] = luma[sy * width + sx];
+      yuv[(y * crop_width + x) * 3 + 1] = u[chroma];
+      yuv[(y * crop_width + x) * 3 + 2] = v[chroma];
+    }
+  }
+  dlr::ImageView image;
+  image.format = dlr::ImageView::Format::kI420;
+  image.width = width;
+  image.height = height;
+  image.planes[0] = luma.data();
+  image.planes[1] = u.data();
+  image.planes[2] = v.data();
+  image.strides[0] = width;
+  image.strides[1] = image.strides[2] = width / 2;
+  image.crop_x = crop_x;
+  image.crop_y = crop_y;
+  image.crop_width = crop_width;
+  image.crop_height = crop_height;
+  std::vector<float> out(3 * 3 * 3);
+  transform.Apply(&image, 1, kFloat32, out.data());
+  for (int64_t y = 0; y < 3; ++y) {
+    for (int64_t x = 0; x < 3; ++x) {
+      for (int64_t c = 0; c < 3; ++c) {
+        const float pixel = SampleYUV(yuv, crop_height, crop_width, true, 2 - c,
+                                      (y + 0.5) * 5 / 3 - 0.5, (x + 0.5) * 6 / 3 - 0.5);
+        EXPECT_NEAR(out[(y * 3 + x) * 3 + c], pixel, 1e-3f) << y << " " << x << " " << c;
+      }
+    }
+  }
+
+  image.crop_x = 7;
+  EXPECT_THROW(transform.Apply(&image, 1, kFloat32, out.data()), dmlc::Error);
+}
+
+TEST(ImageTransform, QuantizedOutput) {
+  // Values outside [-128, 127] saturate.
+  nlohmann::json config = R"({ "Scale": 1.5, "Mean": [128, 0, 255] })"_json;
+  dlr::ImageTransform transform(config, "data", {1, 3, 3, 4});
+  const int64_t shape[3] = {6, 7, 3};
+  const std::vector<uint8_t> image = MakeImage(6, 7, 3);
+  std::vector<float> expected(3 * 3 * 4);
+  transform.Apply(image.data(), shape, 3, kFloat32, expected.data());
+  std::vector<int8_t> out(expected.size());
+  transform.Apply(image.data(), shape, 3, {kDLInt, 8, 1}, out.data());
+  for (size_t i = 0; i < out.size(); ++i) {
+    EXPECT_EQ(out[i], std::lrint(std::min(std::max(expected[i], -128.0f), 127.0f))) << i;
+  }
+  EXPECT_THROW(transform.Apply(image.data(), shape, 3, {kDLFloat, 16, 1}, out.data()),
+               dmlc::Error);
+}
+
+TEST(ImageTransform, ROIs) {
+  nlohmann::json config = R"({ "Height": 4, "Width": 3, "Mean": [1, 2, 3] })"_json;
+  dlr::ImageTransform transform(config, "data", {-1, 3, -1, -1});
+  const std::vector<uint8_t> pixels = MakeImage(20, 30, 3);
+  dlr::ImageView frame;
+  frame.width = 30;
+  frame.height = 20;
+  frame.planes[0] = pixels.data();
+  frame.strides[0] = 30 * 3;
+  // The second box is clipped to [25, 0, 30, 8], the third to one pixel at the frame's corner.
+  const float boxes[3][4] = {{2.5f, 3.0f, 11.0f, 15.5f}, {25, -4, 40, 8}, {35, 30, 36, 31}};
+  const float crops[3][4] = {{2.5f, 3.0f, 8.5f, 12.5f}, {25, 0, 5, 8}, {29, 19, 1, 1}};
+  const size_t entry_size = 3 * 4 * 3;
+  std::vector<float> out(4 * entry_size, -1.0f);
+  transform.ApplyROIs(frame, &boxes[0][0], 3, 4, kFloat32, out.data());
+
+  dlr::ImageView images[3] = {frame, frame, frame};
+  for (int n = 0; n < 3; ++n) {
+    images[n].crop_x = crops[n][0];
+    images[n].crop_y = crops[n][1];
+    images[n].crop_width = crops[n][2];
+    images[n].crop_height = crops[n][3];
+  }
+  std::vector<float> expected(4 * entry_size, 0.0f);
+  transform.Apply(images, 3, kFloat32, expected.data());
+  EXPECT_EQ(out, expected);
+
+  // Normalized [y1, x1, y2, x2] boxes.
+  config["BoxOrder"] = "YXYX";
+  config["BoxNormalized"] = true;
+  dlr::ImageTransform normalized(config, "data", {-1, 3, -1, -1});
+  const float relative[4] = {3.0f / 20, 2.5f / 30, 15.5f / 20, 11.0f / 30};
+  normalized.ApplyROIs(frame, relative, 1, 1, kFloat32, out.data());
+  for (size_t i = 0; i < entry_size; ++i) EXPECT_NEAR(out[i], expected[i], 1e-3f) << i;
+
+  EXPECT_THROW(transform.ApplyROIs(frame, &boxes[0][0], 3, 2, kFloat32, out.data()), dmlc::Error);
+}
+
+TEST(ImageTransform, InvalidConfig) {
+  EXPECT_THROW(dlr::ImageTransform(R"({})"_json, "data", {1, 3, -1, -1}), dmlc::Error);
+  EXPECT_THROW(dlr::ImageTransform(R"({ "Layout": "CHW" })"_json, "data", {1, 3, 4, 4}),
+               dmlc::Error);
+  EXPECT_THROW(dlr::ImageTransform(R"({ "Mean": [1, 2] })"_json, "data", {1, 3, 4, 4}),
+               dmlc::Error);
+  EXPECT_THROW(dlr::ImageTransform(R"({ "ChannelOrder": "BGR" })"_json, "data", {1, 1, 4, 4}),
+               dmlc::Error);
+  EXPECT_THROW(dlr::ImageTransform(R"({ "YUVMatrix": "BT2020" })"_json, "data", {1, 3, 4, 4}),
+               dmlc::Error);
+}
+
+TEST(ImageTransform, DataTransformImage) {
+  nlohmann::json metadata = R"({
+    "DataTransform": { "Input": { "Image": { "InputName": "image", "Scale": 2 } } }
+  })"_json;
+  dlr::DataTransform transform;
+  EXPECT_TRUE(transform.HasImageTransform(metadata));
+  EXPECT_FALSE(transform.HasImageTransform(R"({ "DataTransform": { "Input": {} } })"_json));
+  EXPECT_EQ(transform.GetImageInputIndex(), -1);
+  transform.CompileImageTransform(metadata, {"other", "image"}, {{1}, {1, 3, 2, 2}});
+  EXPECT_EQ(transform.GetImageInputIndex(), 1);
+
+  // Same size as the model input, so pixels are only scaled.
+  const std::vector<uint8_t> image = MakeImage(2, 2, 3);
+  const int64_t shape[3] = {2, 2, 3};
+  tvm::runtime::NDArray input =
+      tvm::runtime::NDArray::Empty(transform.GetImageShape(shape, 3), kFloat32,
+                                   DLContext{kDLCPU, 0});
+  transform.TransformImage(shape, image.data(), 3, input);
+  const float* data = static_cast<const float*>(input->data);
+  for (int64_t c = 0; c < 3; ++c) {
+    for (int64_t i = 0; i < 4; ++i) {
+      EXPECT_EQ(data[c * 4 + i], 2.0f * image[i * 3 + c]);
+    }
+  }
+  tvm::runtime::NDArray wrong =
+      tvm::runtime::NDArray::Empty({1, 3, 4, 4}, kFloat32, DLContext{kDLCPU, 0});
+  EXPECT_THROW(transform.TransformImage(shape, image.data(), 3, wrong), dmlc::Error);
+
+  // The same pixels as BGR, into a uint8 input.
+  std::vector<uint8_t> bgr(image.size());
+  for (size_t i = 0; i < image.size(); i += 3) std::reverse_copy(&image[i], &image[i + 3], &bgr[i]);
+  dlr::ImageView view;
+  view.format = dlr::ImageView::Format::kBGR;
+  view.width = view.height = 2;
+  view.planes[0] = bgr.data();
+  view.strides[0] = 6;
+  tvm::runtime::NDArray quantized = tvm::runtime::NDArray::Empty(
+      transform.GetImageShape(1), {kDLUInt, 8, 1}, DLContext{kDLCPU, 0});
+  transform.TransformImage(&view, 1, quantized);
+  const uint8_t* values = static_cast<const uint8_t*>(quantized->data);
+  for (int64_t c = 0; c < 3; ++c) {
+    for (int64_t i = 0; i < 4; ++i) {
+      EXPECT_EQ(values[c * 4 + i], std::min(2 * image[i * 3 + c], 255));
+    }
+  }
+
+  // One box of the whole image in a batch of two.
+  tvm::runtime::NDArray rois =
+      tvm::runtime::NDArray::Empty({2, 3, 2, 2}, kFloat32, DLContext{kDLCPU, 0});
+  const float box[4] = {0, 0, 2, 2};
+  transform.TransformROIs(view, box, 1, rois);
+  const float* roi_data = static_cast<const float*>(rois->data);
+  for (int64_t c = 0; c < 3; ++c) {
+    for (int64_t i = 0; i < 4; ++i) {
+      EXPECT_EQ(roi_data[c * 4 + i], 2.0f * image[i * 3 + c]);
+      EXPECT_EQ(roi_data[12 + c * 4 + i], 0.0f);
+    }
+  }
+}
@@ -0,0 +1,104 @@
+#include "dlr_ndarray_arena.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+class NDArrayArenaTest : public ::testing::Test {
+ protected:
+  DLDataType dtype = {kDLFloat, 32, 1};
+  DLContext ctx = {kDLCPU, 0};
+};
+
+TEST_F(NDArrayArenaTest, ReusesSameShape) {
+  dlr::NDArrayArena arena;
+  void* data = arena.Get({1, 3, 8, 8}, dtype, ctx)->data;
+  tvm::runtime::NDArray b = arena.Get({1, 3, 8, 8}, dtype, ctx);
+  EXPECT_EQ(b->data, data);
+  EXPECT_EQ(arena.GetStats().hits, 1);
+  EXPECT_EQ(arena.GetStats().misses, 1);
+  EXPECT_EQ(arena.GetNumBuckets(), 1);
+}
+
+TEST_F(NDArrayArenaTest, ReusesLargerBucketAsView) {
+  dlr::NDArrayArena arena;
+  void* data = arena.Get({4, 16}, dtype, ctx)->data;
+  tvm::runtime::NDArray b = arena.Get({3, 16}, dtype, ctx);
+  EXPECT_EQ(b->data, data);
+  EXPECT_EQ(b->shape[0], 3);
+  b = tvm::runtime::NDArray();
+  // Less than half of the bucket would be used, so allocate a new one.
+  tvm::runtime::NDArray c = arena.Get({1, 16}, dtype, ctx);
+  EXPECT_NE(c->data, data);
+  EXPECT_EQ(arena.GetStats().hits, 1);
+  EXPECT_EQ(arena.GetStats().misses, 2);
+  EXPECT_EQ(arena.GetNumBuckets(), 2);
+}
+
+TEST_F(NDArrayArenaTest, SkipsBucketsInUse) {
+  dlr::NDArrayArena arena;
+  tvm::runtime::NDArray previous = arena.Get({4, 16}, dtype, ctx);
+  std::fill_n(static_cast<float*>(previous->data), 64, 1.0f);
+  // The previous array is still held, so neither its shape nor a view of it shares its storage.
+  tvm::runtime::NDArray same = arena.Get({4, 16}, dtype, ctx);
+  tvm::runtime::NDArray view = arena.Get({3, 16}, dtype, ctx);
+  EXPECT_NE(same->data, previous->data);
+  EXPECT_NE(view->data, previous->data);
+  std::fill_n(static_cast<float*>(same->data), 64, 2.0f);
+  EXPECT_EQ(static_cast<float*>(previous->data)[0], 1.0f);
+  EXPECT_EQ(arena.GetStats().hits, 0);
+  EXPECT_EQ(arena.GetStats().misses, 3);
+  // Once released, its bucket is handed out again.
+  void* data = previous->data;
+  previous = tvm::runtime::NDArray();
+  EXPECT_EQ(arena.Get({4, 16}, dtype, ctx)->data, data);
+  EXPECT_EQ(arena.GetStats().hits, 1);
+}
+
+TEST_F(NDArrayArenaTest, EvictsLeastRecentlyUsed) {
+  dlr::NDArrayArena arena(2);
+  arena.Get({1}, dtype, ctx);
+  arena.Get({10}, dtype, ctx);
+  arena.Get({1}, dtype, ctx);
+  arena.Get({100}, dtype, ctx);  // evicts {10}
+  EXPECT_EQ(arena.GetNumBuckets(), 2);
+  arena.ResetStats();
+  arena.Get({1}, dtype, ctx);
+  arena.Get({10}, dtype, ctx);
+  EXPECT_EQ(arena.GetStats().hits, 1);
+  EXPECT_EQ(arena.GetStats().misses, 1);
+}
+
+TEST_F(NDArrayArenaTest, ZeroBucketsDisablesReuse) {
+  dlr::NDArrayArena arena;
+  arena.Get({8}, dtype, ctx);
+  arena.SetMaxBuckets(0);
+  EXPECT_EQ(arena.GetNumBuckets(), 0);
+  arena.Get({8}, dtype, ctx);
+  arena.Get({8}, dtype, ctx);
+  EXPECT_EQ(arena.GetStats().hits, 0);
+  EXPECT_EQ(arena.GetStats().misses, 3);
+}
+
+TEST_F(NDArrayArenaTest, TrimIdleKeepsReferencedBuckets) {
+  dlr::NDArrayArena arena;
+  tvm::runtime::NDArray in_use = arena.Get({16}, dtype, ctx);
+  arena.Get({256}, dtype, ctx);
+  arena.Get({1024}, dtype, ctx);
+  EXPECT_EQ(arena.GetBytes(), (16 + 256 + 1024) * 4);
+  EXPECT_EQ(arena.GetIdleBytes(), (256 + 1024) * 4);
+  // Least recently used idle bucket goes first.
+  EXPECT_EQ(arena.TrimIdle(1024 * 4), 256 * 4);
+  EXPECT_EQ(arena.GetIdleBytes(), 1024 * 4);
+  EXPECT_EQ(arena.TrimIdle(0), 1024 * 4);
+  EXPECT_EQ(arena.GetNumBuckets(), 1);
+  EXPECT_EQ(arena.GetBytes(), 16 * 4);
+}
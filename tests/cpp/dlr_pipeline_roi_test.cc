@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "dlr_pipeline.h"
+
+using namespace dlr;
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+namespace {
+
+const int64_t kMaxDetections = 100;
+
+/*! \brief Model with fixed float32 outputs and an image input, that records the boxes it is given
+ * and checks them like RelayVMModel::SetROIInput.
+ */
+class FakeModel : public DLRModel {
+ public:
+  struct Tensor {
+    std::string name;
+    std::vector<int64_t> shape;
+    std::vector<float> data;
+  };
+
+  FakeModel(const std::vector<int64_t>& input_shape, const std::vector<Tensor>& outputs)
+      : DLRModel({kDLCPU, 0}, DLRBackend::kUNKNOWN), outputs_(outputs) {
+    num_inputs_ = 1;
+    num_outputs_ = outputs.size();
+    input_names_ = {"data"};
+    input_types_ = {"float32"};
+    input_shapes_ = {input_shape};
+  }
+
+  const char* GetInputName(int index) const override { return input_names_[index].c_str(); }
+  const char* GetInputType(int index) const override { return input_types_[index].c_str(); }
+  const int GetInputDim(int index) const override { return input_shapes_[index].size(); }
+  const int64_t GetInputSize(int index) const override { return -1; }
+  void GetInput(const char* name, void* input) override {}
+  void SetInput(const char* name, const int64_t* shape, const void* input, int dim) override {}
+  void SetImageInput(const char* name, const ImageView* images, int64_t n) override {}
+  void SetROIInput(const char* name, const ImageView& frame, const float* boxes,
+                   int64_t num_boxes) override {
+    const int64_t batch = input_shapes_[0][0] > 0 ? input_shapes_[0][0] : num_boxes;
+    CHECK_GT(batch, 0) << "ROI input with a dynamic batch requires at least one box.";
+    roi_boxes.assign(boxes, boxes + num_boxes * 4);
+  }
+  int GetImageInputIndex() const override { return 0; }
+
+  int GetOutputIndex(const char* name) const override {
+    for (size_t i = 0; i < outputs_.size(); ++i) {
+      if (outputs_[i].name == name) return i;
+    }
+    return -1;
+  }
+  const char* GetOutputType(int index) const override { return "float32"; }
+  void GetOutputShape(int index, int64_t* shape) const override {
+    std::copy(outputs_[index].shape.begin(), outputs_[index].shape.end(), shape);
+  }
+  void GetOutputSizeDim(int index, int64_t* size, int* dim) override {
+    *size = outputs_[index].data.size();
+    *dim = outputs_[index].shape.size();
+  }
+  void GetOutput(int index, void* out) override {
+    std::memcpy(out, outputs_[index].data.data(), outputs_[index].data.size() * sizeof(float));
+  }
+  const void* GetOutputPtr(int index) const override { return outputs_[index].data.data(); }
+
+  const char* GetWeightName(int index) const override { return nullptr; }
+  std::vector<std::string> GetWeightNames() const override { return {}; }
+  void SetNumThreads(int threads) override {}
+  void UseCPUAffinity(bool use) override {}
+  void Run() override { num_runs++; }
+
+  std::vector<Tensor> outputs_;
+  std::vector<float> roi_boxes;
+  int num_runs = 0;
+};
+
+/*! \brief Detector padded to kMaxDetections boxes, box b being {b, b, b + 1, b + 1}. */
+std::shared_ptr<FakeModel> MakeDetector(float num_detections, const std::vector<float>& scores) {
+  std::vector<float> boxes(kMaxDetections * 4);
+  for (int64_t b = 0; b < kMaxDetections; ++b) {
+    boxes[b * 4] = boxes[b * 4 + 1] = b;
+    boxes[b * 4 + 2] = boxes[b * 4 + 3] = b + 1;
+  }
+  std::vector<float> padded_scores(kMaxDetections, 0.0f);
+  std::copy(scores.begin(), scores.end(), padded_scores.begin());
+  return std::make_shared<FakeModel>(
+      std::vector<int64_t>{1, 3, 32, 32},
+      std::vector<FakeModel::Tensor>{{"detection_boxes", {1, kMaxDetections, 4}, boxes},
+                                     {"detection_scores", {1, kMaxDetections}, padded_scores},
+                                     {"num_detections", {1}, {num_detections}}});
+}
+
+std::shared_ptr<FakeModel> MakeClassifier(int64_t batch, const char* roi) {
+  auto model = std::make_shared<FakeModel>(std::vector<int64_t>{batch, 3, 8, 8},
+                                           std::vector<FakeModel::Tensor>{{"prob", {1, 10}, {}}});
+  model->metadata_ = nlohmann::json::parse(R"({"DataTransform": {"Input": {"Image": {}}}})");
+  if (roi != nullptr) {
+    model->metadata_["DataTransform"]["Input"]["Image"]["ROI"] = nlohmann::json::parse(roi);
+  }
+  return model;
+}
+
+/*! \brief Run a detector and classifier pipeline, returning the first corner of each box cropped. */
+std::vector<float> RunPipeline(const std::shared_ptr<FakeModel>& detector,
+                               const std::shared_ptr<FakeModel>& classifier) {
+  classifier->roi_boxes.clear();
+  PipelineModel pipeline({detector, classifier}, {kDLCPU, 0});
+  ImageView frame;
+  frame.width = frame.height = 32;
+  pipeline.SetImageInput("data", &frame, 1);
+  pipeline.Run();
+  std::vector<float> corners;
+  for (size_t b = 0; b < classifier->roi_boxes.size(); b += 4) {
+    corners.push_back(classifier->roi_boxes[b]);
+  }
+  return corners;
+}
+
+}  // namespace
+
+TEST(PipelineROITest, CropsOnlyDetectedBoxes) {
+  auto classifier =
+      MakeClassifier(-1, R"({"Boxes": "detection_boxes", "Count": "num_detections"})");
+  EXPECT_EQ(RunPipeline(MakeDetector(3, {}), classifier), std::vector<float>({0, 1, 2}));
+  EXPECT_EQ(classifier->roi_boxes.size(), 12);
+  EXPECT_EQ(classifier->roi_boxes[11], 3.0f);
+}
+
+TEST(PipelineROITest, SkipsModelsWithoutBoxes) {
+  auto classifier =
+      MakeClassifier(-1, R"({"Boxes": "detection_boxes", "Count": "num_detections"})");
+  classifier->outputs_[0].data.assign(10, 1.0f);
+  PipelineModel pipeline({MakeDetector(0, {}), classifier}, {kDLCPU, 0});
+  ImageView frame;
+  frame.width = frame.height = 32;
+  pipeline.SetImageInput("data", &frame, 1);
+  // A frame without detections is not cropped into an empty dynamic batch, which would throw.
+  EXPECT_NO_THROW(pipeline.Run());
+  EXPECT_EQ(classifier->num_runs, 0);
+  EXPECT_TRUE(classifier->roi_boxes.empty());
+
+  int64_t size;
+  int dim;
+  pipeline.GetOutputSizeDim(0, &size, &dim);
+  EXPECT_EQ(size, 0);
+  EXPECT_EQ(dim, 2);
+  int64_t shape[2];
+  pipeline.GetOutputShape(0, shape);
+  EXPECT_EQ(shape[0], 0);
+  EXPECT_EQ(shape[1], 10);
+  EXPECT_EQ(pipeline.GetOutputPtr(0), nullptr);
+  DLRClassScore scores[1];
+  int64_t num_scores = -1;
+  pipeline.GetOutputClassScores(0, scores, 1, &num_scores);
+  EXPECT_EQ(num_scores, 0);
+}
+
+TEST(PipelineROITest, SkipsBoxesBelowThreshold) {
+  auto classifier = MakeClassifier(-1, R"({"Boxes": 0, "Count": 2, "Scores": "detection_scores",
+                                           "ScoreThreshold": 0.5})");
+  EXPECT_EQ(RunPipeline(MakeDetector(4, {0.9f, 0.2f, 0.8f, 0.7f, 0.9f}), classifier),
+            std::vector<float>({0, 2, 3}));
+}
+
+TEST(PipelineROITest, StaticBatchKeepsLeadingBoxes) {
+  auto classifier = MakeClassifier(2, R"({"Boxes": "detection_boxes", "Count": "num_detections"})");
+  EXPECT_EQ(RunPipeline(MakeDetector(4, {}), classifier), std::vector<float>({0, 1}));
+}
+
+TEST(PipelineROITest, RequiresExplicitConfig) {
+  // Without ROI config, the outputs of the detector are not taken for boxes.
+  EXPECT_THROW(PipelineModel({MakeDetector(3, {}), MakeClassifier(-1, nullptr)}, {kDLCPU, 0}),
+               dmlc::Error);
+  EXPECT_THROW(PipelineModel({MakeDetector(3, {}), MakeClassifier(-1, R"({"Count": 2})")},
+                             {kDLCPU, 0}),
+               dmlc::Error);
+  EXPECT_THROW(PipelineModel({MakeDetector(3, {}), MakeClassifier(-1, R"({"Boxes": "boxes"})")},
+                             {kDLCPU, 0}),
+               dmlc::Error);
+}
@@ -0,0 +1,125 @@
+#include "dlr_postprocess.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "dlr_common.h"
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+namespace {
+
+// Sort the whole row and normalize every class, as classification clients usually do.
+std::vector<DLRClassScore> Reference(const float* row, int64_t n, int64_t k, bool softmax) {
+  std::vector<DLRClassScore> all(n);
+  for (int64_t i = 0; i < n; ++i) all[i] = {static_cast<int32_t>(i), row[i]};
+  std::stable_sort(all.begin(), all.end(), [](const DLRClassScore& a, const DLRClassScore& b) {
+    return a.score > b.score;
+  });
+  if (softmax) {
+    const double max = all[0].score;
+    double sum = 0.0;
+    for (int64_t i = 0; i < n; ++i) sum += std::exp(row[i] - max);
+    for (DLRClassScore& result : all) result.score = std::exp(result.score - max) / sum;
+  }
+  all.resize(std::min(k, n));
+  return all;
+}
+
+}  // namespace
+
+TEST(Postprocess, MatchesReference) {
+  std::mt19937 rng(7);
+  std::normal_distribution<float> dist(0.0f, 4.0f);
+  for (int64_t n : {1, 3, 31, 32, 100, 1000, 1001}) {
+    const int64_t num_rows = 3;
+    std::vector<float> logits(num_rows * n);
+    for (float& v : logits) v = dist(rng);
+    for (int64_t k : {1, 5, 40}) {
+      for (bool softmax : {false, true}) {
+        dlr::Postprocess postprocess(k, softmax);
+        const int64_t num_results = postprocess.GetNumResults(n);
+        EXPECT_EQ(num_results, std::min(k, n));
+        std::vector<DLRClassScore> results(num_rows * num_results);
+        postprocess.Apply(logits.data(), num_rows, n, results.data());
+        for (int64_t r = 0; r < num_rows; ++r) {
+          auto expected = Reference(logits.data() + r * n, n, k, softmax);
+          for (int64_t i = 0; i < num_results; ++i) {
+            const DLRClassScore& result = results[r * num_results + i];
+            EXPECT_EQ(result.index, expected[i].index) << "n " << n << " k " << k << " i " << i;
+            EXPECT_NEAR(result.score, expected[i].score, 1e-6f);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(Postprocess, TiesGoToLowerIndex) {
+  std::vector<float> logits(70, 1.0f);
+  logits[50] = 2.0f;
+  dlr::Postprocess postprocess(4, false);
+  std::vector<DLRClassScore> results(4);
+  postprocess.Apply(logits.data(), 1, logits.size(), results.data());
+  EXPECT_EQ(results[0].index, 50);
+  EXPECT_EQ(results[1].index, 0);
+  EXPECT_EQ(results[2].index, 1);
+  EXPECT_EQ(results[3].index, 2);
+}
+
+TEST(Postprocess, MaskedLogits) {
+  const float inf = std::numeric_limits<float>::infinity();
+  std::vector<float> logits(40, -inf);
+  logits[3] = 0.0f;
+  logits[37] = std::log(3.0f);
+  dlr::Postprocess postprocess(3, true);
+  std::vector<DLRClassScore> results(3);
+  postprocess.Apply(logits.data(), 1, logits.size(), results.data());
+  EXPECT_EQ(results[0].index, 37);
+  EXPECT_NEAR(results[0].score, 0.75f, 1e-6f);
+  EXPECT_EQ(results[1].index, 3);
+  EXPECT_NEAR(results[1].score, 0.25f, 1e-6f);
+  EXPECT_EQ(results[2].index, 0);
+  EXPECT_EQ(results[2].score, 0.0f);
+}
+
+TEST(Postprocess, ManyRows) {
+  const int64_t num_rows = 4096, n = 37;
+  std::vector<float> logits(num_rows * n);
+  for (size_t i = 0; i < logits.size(); ++i) logits[i] = static_cast<float>((i * 7919) % 101);
+  dlr::Postprocess postprocess(1, true);
+  std::vector<DLRClassScore> results(num_rows);
+  postprocess.Apply(logits.data(), num_rows, n, results.data());
+  for (int64_t r = 0; r < num_rows; ++r) {
+    auto expected = Reference(logits.data() + r * n, n, 1, true);
+    EXPECT_EQ(results[r].index, expected[0].index);
+    EXPECT_NEAR(results[r].score, expected[0].score, 1e-6f);
+  }
+}
+
+TEST(Postprocess, Config) {
+  dlr::Postprocess postprocess(nlohmann::json::parse(R"({"TopK": 5, "Softmax": true})"));
+  EXPECT_EQ(postprocess.GetTopK(), 5);
+  EXPECT_TRUE(postprocess.GetSoftmax());
+  dlr::Postprocess argmax(nlohmann::json::parse("{}"));
+  EXPECT_EQ(argmax.GetTopK(), 1);
+  EXPECT_FALSE(argmax.GetSoftmax());
+  EXPECT_THROW(dlr::Postprocess(nlohmann::json::parse(R"({"TopK": 0})")), dmlc::Error);
+
+  dlr::Postprocess disabled;
+  EXPECT_FALSE(disabled.Enabled());
+  float logits[2] = {1.0f, 2.0f};
+  DLRClassScore result;
+  EXPECT_THROW(disabled.Apply(logits, 1, 2, &result), dmlc::Error);
+}
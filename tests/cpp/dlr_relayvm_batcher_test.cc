@@ -0,0 +1,120 @@
+#include "dlr_relayvm_batcher.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "test_utils.hpp"
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+class RelayVMBatcherTest : public ::testing::Test {
+ protected:
+  size_t img_size = 512 * 512 * 3;
+  const int64_t input_shape[4] = {1, 512, 512, 3};
+  std::vector<int8_t> img{std::vector<int8_t>(img_size)};
+
+  dlr::RelayVMModel* model;
+
+  RelayVMBatcherTest() {
+    DLContext ctx = {kDLCPU, 0};
+    std::vector<std::string> paths = {"./ssd_mobilenet_v1"};
+    std::vector<std::string> files = dlr::FindFiles(paths);
+    model = new dlr::RelayVMModel(files, ctx);
+  }
+
+  ~RelayVMBatcherTest() { delete model; }
+};
+
+TEST_F(RelayVMBatcherTest, TestGetBucketIndex) {
+  dlr::RelayVMBatcherConfig config;
+  config.bucket_boundaries = {128, 512};
+  config.max_batch_size = 1;
+  dlr::RelayVMBatcher batcher(model, config);
+  EXPECT_EQ(batcher.GetBucketIndex(1), 0);
+  EXPECT_EQ(batcher.GetBucketIndex(128), 0);
+  EXPECT_EQ(batcher.GetBucketIndex(129), 1);
+  EXPECT_EQ(batcher.GetBucketIndex(512), 1);
+  EXPECT_EQ(batcher.GetBucketIndex(513), 2);
+}
+
+TEST_F(RelayVMBatcherTest, TestInvalidConfig) {
+  dlr::RelayVMBatcherConfig config;
+  config.bucket_boundaries = {64, 32};
+  EXPECT_THROW(dlr::RelayVMBatcher(model, config), dmlc::Error);
+  config.bucket_boundaries = {32};
+  config.max_batch_size = 0;
+  EXPECT_THROW(dlr::RelayVMBatcher(model, config), dmlc::Error);
+}
+
+TEST(RelayVMBatcher, TestRejectsTransforms) {
+  // The output of this model is converted to JSON labels by its metadata.
+  DLContext ctx = {kDLCPU, 0};
+  std::vector<std::string> paths = {"./inverselabel"};
+  dlr::RelayVMModel model(dlr::FindFiles(paths), ctx);
+  dlr::RelayVMBatcherConfig config;
+  EXPECT_THROW(dlr::RelayVMBatcher(&model, config), dmlc::Error);
+}
+
+TEST_F(RelayVMBatcherTest, TestPredictMatchesRun) {
+  // The image height plays the role of the sequence dimension. The model has a static batch of
+  // 1, so each request runs on its own.
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), 4));
+  EXPECT_NO_THROW(model->Run());
+  std::vector<float> expected(100);
+  EXPECT_NO_THROW(model->GetOutput(3, expected.data()));
+
+  dlr::RelayVMBatcherConfig config;
+  config.bucket_boundaries = {512};
+  config.max_batch_size = 1;
+  dlr::RelayVMBatcher batcher(model, config);
+  std::vector<std::vector<char>> outputs;
+  std::vector<std::vector<int64_t>> output_shapes;
+  EXPECT_NO_THROW(batcher.Predict({img.data()}, 512, &outputs, &output_shapes));
+  ASSERT_EQ(outputs.size(), 4);
+  EXPECT_EQ(output_shapes[3][0], 1);
+  ASSERT_EQ(outputs[3].size(), 100 * sizeof(float));
+  const float* observed = reinterpret_cast<const float*>(outputs[3].data());
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(observed[i], expected[i]);
+  }
+  EXPECT_THROW(batcher.Predict({}, 512, &outputs, &output_shapes), dmlc::Error);
+}
+
+TEST_F(RelayVMBatcherTest, TestConcurrentPredict) {
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), 4));
+  EXPECT_NO_THROW(model->Run());
+  std::vector<float> expected(100);
+  EXPECT_NO_THROW(model->GetOutput(3, expected.data()));
+
+  // Requests queue up while the worker runs one batch at a time.
+  dlr::RelayVMBatcherConfig config;
+  config.max_batch_size = 1;
+  config.max_queue_delay = std::chrono::microseconds(1000);
+  dlr::RelayVMBatcher batcher(model, config);
+  const int num_requests = 4;
+  std::vector<std::vector<std::vector<char>>> outputs(num_requests);
+  std::vector<std::vector<std::vector<int64_t>>> output_shapes(num_requests);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_requests; t++) {
+    threads.emplace_back([&, t]() {
+      batcher.Predict({img.data()}, 512, &outputs[t], &output_shapes[t]);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  for (int t = 0; t < num_requests; t++) {
+    ASSERT_EQ(outputs[t].size(), 4);
+    std::vector<int64_t> expected_shape = {1, 100};
+    EXPECT_EQ(output_shapes[t][3], expected_shape);
+    const float* observed = reinterpret_cast<const float*>(outputs[t][3].data());
+    for (int i = 0; i < 100; i++) {
+      EXPECT_EQ(observed[i], expected[i]);
+    }
+  }
+}
@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "test_utils.hpp"
 
 int main(int argc, char** argv) {
@@ -62,6 +64,12 @@ TEST_F(RelayVMTest, TestGetOutputName) {
   EXPECT_STREQ(model->GetOutputName(3), "detection_scores:0");
 }
 
+TEST_F(RelayVMTest, TestGetOutputIndex) {
+  EXPECT_EQ(model->GetOutputIndex("detection_classes:0"), 0);
+  EXPECT_EQ(model->GetOutputIndex("detection_scores:0"), 3);
+  EXPECT_THROW(model->GetOutputIndex("blah"), dmlc::Error);
+}
+
 TEST_F(RelayVMTest, TestGetOutputType) {
   EXPECT_STREQ(model->GetOutputType(0), "float32");
   EXPECT_STREQ(model->GetOutputType(1), "float32");
@@ -135,3 +143,248 @@ TEST_F(RelayVMTest, TestGetOutput) {
     EXPECT_EQ(output3_p[i], output3[i]);
   }
 }
+
+TEST_F(RelayVMTest, TestGetOutputClassScores) {
+  model->SetOutputPostprocess(3, dlr::Postprocess(5, false));
+  DLRClassScore top[5];
+  int64_t num_results;
+  float output3[100];
+  EXPECT_THROW(model->GetOutputClassScores(3, top, 5, &num_results), dmlc::Error);
+  EXPECT_THROW(model->GetOutput(3, output3), dmlc::Error);
+  EXPECT_THROW(model->GetOutputPtr(3), dmlc::Error);
+
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutputClassScores(3, top, 5, &num_results));
+  EXPECT_EQ(num_results, 5);
+  EXPECT_NO_THROW(model->GetOutput(3, output3));
+  EXPECT_EQ(top[0].score, *std::max_element(output3, output3 + 100));
+  EXPECT_EQ(top[0].score, output3[top[0].index]);
+}
+
+TEST_F(RelayVMTest, TestSetInputBatchGetOutputBatch) {
+  const void* samples[1] = {img.data()};
+  EXPECT_NO_THROW(model->SetInputBatch("image_tensor", samples, 1));
+  std::vector<int8_t> observed(img_size);
+  EXPECT_NO_THROW(model->GetInput("image_tensor", observed.data()));
+  EXPECT_EQ(observed, img);
+  EXPECT_NO_THROW(model->Run());
+
+  float output3[100];
+  float output3_batch[100];
+  void* dests[1] = {output3_batch};
+  EXPECT_NO_THROW(model->GetOutput(3, output3));
+  EXPECT_NO_THROW(model->GetOutputBatch(3, dests, 1));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(output3_batch[i], output3[i]);
+  }
+  EXPECT_THROW(model->GetOutputBatch(3, dests, 2), dmlc::Error);
+}
+
+TEST_F(RelayVMTest, TestInputArenaReuse) {
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_EQ(model->GetInputArenaStats().hits, 1);
+  EXPECT_EQ(model->GetInputArenaStats().misses, 1);
+  // The VM drops the input of the last Run on the next SetInput, so its storage is reused.
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_EQ(model->GetInputArenaStats().hits, 2);
+  EXPECT_EQ(model->GetInputArenaStats().misses, 1);
+  model->SetInputArenaMaxBuckets(0);
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_EQ(model->GetInputArenaStats().misses, 2);
+  EXPECT_NO_THROW(model->Run());
+}
+
+TEST_F(RelayVMTest, TestZeroCopyInput) {
+  model->SetZeroCopyInput(true);
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  float output3[100];
+  EXPECT_NO_THROW(model->GetOutput(3, output3));
+
+  std::vector<int8_t> buffer(img_size + 64);
+  void* aligned = buffer.data();
+  size_t space = buffer.size();
+  ASSERT_NE(std::align(64, img_size, aligned, space), nullptr);
+  std::copy(img.begin(), img.end(), static_cast<int8_t*>(aligned));
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, aligned, input_dim));
+  EXPECT_NO_THROW(model->Run());
+  float output3_zero_copy[100];
+  EXPECT_NO_THROW(model->GetOutput(3, output3_zero_copy));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(output3_zero_copy[i], output3[i]);
+  }
+  // Outputs do not refer to the buffer once Run returned.
+  std::fill(buffer.begin(), buffer.end(), 0);
+  EXPECT_NO_THROW(model->GetOutput(3, output3_zero_copy));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(output3_zero_copy[i], output3[i]);
+  }
+  // The borrowed input is released when Run returns.
+  EXPECT_THROW(model->Run(), dmlc::Error);
+}
+
+TEST_F(RelayVMTest, TestZeroCopyInputReleasedOnError) {
+  model->SetZeroCopyInput(true);
+  std::vector<int8_t> buffer(img_size + 64);
+  void* aligned = buffer.data();
+  size_t space = buffer.size();
+  ASSERT_NE(std::align(64, img_size, aligned, space), nullptr);
+  // A 2-D input makes invoke fail after the buffer is borrowed.
+  const int64_t flat_shape[2] = {1, static_cast<int64_t>(img_size)};
+  EXPECT_NO_THROW(model->SetInput("image_tensor", flat_shape, aligned, 2));
+  EXPECT_THROW(model->Run(), dmlc::Error);
+  // The borrowed input was released by the failed Run, so the buffer is not read again.
+  buffer.clear();
+  buffer.shrink_to_fit();
+  EXPECT_THROW(model->Run(), dmlc::Error);
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+}
+
+TEST_F(RelayVMTest, TestSetNumThreadsAndCPUAffinity) {
+  EXPECT_NO_THROW(model->SetNumThreads(2));
+  EXPECT_NO_THROW(model->UseCPUAffinity(true));
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->UseCPUAffinity(false));
+  EXPECT_NO_THROW(model->Run());
+}
+
+TEST_F(RelayVMTest, TestWarmup) {
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  int64_t pool_bytes = 0;
+  EXPECT_NO_THROW(pool_bytes = model->Warmup({}));
+  EXPECT_GT(pool_bytes, 0);
+  std::vector<int64_t> shape(std::begin(input_shape), std::end(input_shape));
+  EXPECT_NO_THROW(pool_bytes = model->Warmup({{shape}}));
+  EXPECT_GT(pool_bytes, 0);
+  EXPECT_THROW(model->Warmup({{shape, shape}}), dmlc::Error);
+  // Inputs set before warmup are kept.
+  std::vector<int8_t> observed(img_size);
+  EXPECT_NO_THROW(model->GetInput("image_tensor", observed.data()));
+  EXPECT_EQ(observed, img);
+  EXPECT_NO_THROW(model->Run());
+}
+
+TEST_F(RelayVMTest, TestMemoryStatsAndTrim) {
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  std::vector<DLRMemoryStats> stats = model->GetMemoryStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].device_type, kDLCPU);
+  EXPECT_GT(stats[0].current_bytes, 0);
+  EXPECT_GE(stats[0].peak_bytes, stats[0].current_bytes);
+  // Intermediate storage of the Run went back to the model's pool.
+  EXPECT_GT(stats[0].cached_bytes, 0);
+  EXPECT_LE(stats[0].cached_bytes, stats[0].current_bytes);
+  const DLRMemoryStats before = stats[0];
+
+  // Another model has its own pool, which trimming this one leaves alone.
+  std::vector<std::string> paths = {"./ssd_mobilenet_v1"};
+  dlr::RelayVMModel other(dlr::FindFiles(paths), DLContext{kDLCPU, 0});
+  EXPECT_NO_THROW(other.SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(other.Run());
+  const DLRMemoryStats other_before = other.GetMemoryStats()[0];
+
+  const int64_t watermark = before.cached_bytes / 2;
+  EXPECT_NO_THROW(model->TrimMemory(watermark));
+  stats = model->GetMemoryStats();
+  EXPECT_LE(stats[0].cached_bytes, watermark);
+  EXPECT_EQ(before.current_bytes - stats[0].current_bytes,
+            before.cached_bytes - stats[0].cached_bytes);
+  float output3[100];
+  EXPECT_NO_THROW(model->GetOutput(3, output3));
+  EXPECT_NO_THROW(model->TrimMemory(0));
+  stats = model->GetMemoryStats();
+  EXPECT_EQ(stats[0].cached_bytes, 0);
+  EXPECT_EQ(stats[0].current_bytes, before.current_bytes - before.cached_bytes);
+  EXPECT_EQ(stats[0].peak_bytes, before.peak_bytes);
+  EXPECT_THROW(model->TrimMemory(-1), dmlc::Error);
+  const DLRMemoryStats other_after = other.GetMemoryStats()[0];
+  EXPECT_EQ(other_after.current_bytes, other_before.current_bytes);
+  EXPECT_EQ(other_after.cached_bytes, other_before.cached_bytes);
+
+  // Outputs of the last Run are in use, not idle, so they survive the trim.
+  float output3_trimmed[100];
+  EXPECT_NO_THROW(model->GetOutput(3, output3_trimmed));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(output3_trimmed[i], output3[i]);
+  }
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(3, output3_trimmed));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(output3_trimmed[i], output3[i]);
+  }
+
+  // Input buckets not in use count as cached too: the 256x256 input once replaced.
+  const int64_t small_shape[4] = {1, 256, 256, 3};
+  const int64_t tiny_shape[4] = {1, 16, 16, 3};
+  EXPECT_NO_THROW(model->TrimMemory(0));
+  EXPECT_NO_THROW(model->SetInput("image_tensor", small_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->SetInput("image_tensor", tiny_shape, img.data(), input_dim));
+  EXPECT_GT(model->GetMemoryStats()[0].cached_bytes, 0);
+  EXPECT_NO_THROW(model->TrimMemory(0));
+  EXPECT_EQ(model->GetMemoryStats()[0].cached_bytes, 0);
+}
+
+TEST(RelayVM, TestImageTransformInput) {
+  // The model with an Image transform added to its metadata, which swaps the channels to BGR.
+  const std::string model_path = "./ssd_mobilenet_v1";
+  std::string code_data = dlr::LoadFileToString(model_path + "/code.ro", std::ios::binary);
+  const std::string so_file = model_path + "/compiled.so";
+  nlohmann::json metadata =
+      nlohmann::json::parse(dlr::LoadFileToString(model_path + "/compiled.meta"));
+  metadata["DataTransform"]["Input"]["Image"] = {
+      {"Layout", "NHWC"}, {"ChannelOrder", "BGR"}, {"Resize", "Nearest"}};
+  const std::string meta_str = metadata.dump();
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::RELAY_EXEC, nullptr, code_data.data(), code_data.size()},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0},
+      {DLRModelElemType::NEO_METADATA, nullptr, meta_str.c_str(), 0}};
+  dlr::RelayVMModel model(model_elems, DLContext{kDLCPU, 0});
+
+  EXPECT_STREQ(model.GetInputType(0), "uint8");
+  EXPECT_EQ(model.GetImageInputIndex(), 0);
+
+  const int64_t shape[4] = {1, 512, 512, 3};
+  std::vector<uint8_t> image(512 * 512 * 3);
+  for (size_t i = 0; i < image.size(); i++) image[i] = i % 251;
+  const std::vector<uint8_t> black(image.size(), 0);
+  std::vector<uint8_t> expected(image.size());
+  for (size_t p = 0; p < image.size(); p += 3) {
+    for (int c = 0; c < 3; c++) expected[p + c] = image[p + 2 - c];
+  }
+  std::vector<uint8_t> observed(image.size());
+
+  EXPECT_NO_THROW(model.SetInput("image_tensor", shape, image.data(), 4));
+  EXPECT_NO_THROW(model.GetInput("image_tensor", observed.data()));
+  EXPECT_EQ(observed, expected);
+
+  EXPECT_NO_THROW(model.SetInput("image_tensor", shape, black.data(), 4));
+  DLTensor tensor;
+  tensor.data = image.data();
+  tensor.ctx = DLContext{kDLCPU, 0};
+  tensor.ndim = 4;
+  tensor.dtype = DLDataType{kDLUInt, 8, 1};
+  tensor.shape = const_cast<int64_t*>(shape);
+  tensor.strides = nullptr;
+  tensor.byte_offset = 0;
+  EXPECT_NO_THROW(model.SetInputTensor("image_tensor", &tensor));
+  EXPECT_NO_THROW(model.GetInput("image_tensor", observed.data()));
+  EXPECT_EQ(observed, expected);
+
+  EXPECT_NO_THROW(model.SetInput("image_tensor", shape, black.data(), 4));
+  dlr::ImageView view;
+  view.width = 512;
+  view.height = 512;
+  view.planes[0] = image.data();
+  view.strides[0] = 512 * 3;
+  EXPECT_NO_THROW(model.SetImageInput("image_tensor", &view, 1));
+  EXPECT_NO_THROW(model.GetInput("image_tensor", observed.data()));
+  EXPECT_EQ(observed, expected);
+  EXPECT_NO_THROW(model.Run());
+}
@@ -0,0 +1,65 @@
+#include "dlr_thread_pool.h"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <tvm/runtime/registry.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif  // __linux__
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+TEST(TVMThreadPoolConfigTest, AlternatesModelSettings) {
+  // Record the configurations of the thread pool, still applying them.
+  const tvm::runtime::PackedFunc tvm_config =
+      *tvm::runtime::Registry::Get("runtime.config_threadpool");
+  std::vector<std::pair<int, std::string>> configs;
+  tvm::runtime::Registry::Register("runtime.config_threadpool", true)
+      .set_body([&](tvm::runtime::TVMArgs args, tvm::runtime::TVMRetValue* rv) {
+        configs.emplace_back(args[1], getenv("TVM_BIND_THREADS"));
+        tvm_config.CallPacked(args, rv);
+      });
+
+  dlr::TVMThreadPoolConfig pinned, unpinned;
+  pinned.SetNumThreads(2);
+  pinned.UseCPUAffinity(true);
+  unpinned.SetNumThreads(1);
+  unpinned.UseCPUAffinity(false);
+#ifdef __linux__
+  cpu_set_t initial;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(initial), &initial), 0);
+#endif  // __linux__
+  for (int i = 0; i < 2; ++i) {
+    pinned.Apply();
+    pinned.Apply();
+#ifdef __linux__
+    // Unpinning also covers the calling thread, which runs the first task.
+    cpu_set_t one_cpu;
+    CPU_ZERO(&one_cpu);
+    CPU_SET(0, &one_cpu);
+    ASSERT_EQ(sched_setaffinity(0, sizeof(one_cpu), &one_cpu), 0);
+#endif  // __linux__
+    unpinned.Apply();
+#ifdef __linux__
+    cpu_set_t current;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(current), &current), 0);
+    EXPECT_TRUE(CPU_EQUAL(&current, &initial));
+#endif  // __linux__
+  }
+  // Each model gets its own settings back after the other ran, and only then.
+  std::vector<std::pair<int, std::string>> expected = {{2, "1"}, {1, "0"}, {2, "1"}, {1, "0"}};
+  EXPECT_EQ(configs, expected);
+
+  tvm::runtime::Registry::Register("runtime.config_threadpool", true).set_body(tvm_config);
+}
@@ -2,6 +2,24 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif  // _WIN32
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+
+#include <set>
+#endif  // __linux__
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
@@ -10,6 +28,27 @@ int main(int argc, char** argv) {
   return RUN_ALL_TESTS();
 }
 
+#ifdef __linux__
+std::set<pid_t> ListThreads() {
+  std::set<pid_t> tids;
+  DIR* dir = opendir("/proc/self/task");
+  if (dir == nullptr) return tids;
+  while (dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') tids.insert(std::atoi(entry->d_name));
+  }
+  closedir(dir);
+  return tids;
+}
+
+/*! \brief Number of threads, waiting up to a second for joined threads to leave the list. */
+size_t CountThreads(size_t expected) {
+  for (int i = 0; i < 100 && ListThreads().size() > expected; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return ListThreads().size();
+}
+#endif  // __linux__
+
 class TreeliteTest : public ::testing::Test {
  protected:
   const int64_t in_size = 69;
@@ -113,3 +152,185 @@ TEST_F(TreeliteTest, TestGetOutput) {
   EXPECT_NO_THROW(output_p = (float*)model->GetOutputPtr(0));
   EXPECT_EQ(output_p[0], output[0]);
 }
+
+TEST_F(TreeliteTest, TestDenseAndSparseInputs) {
+  const int64_t batch_shape[2] = {2, in_size};
+  // Few missing values: dense batch.
+  std::vector<float> input = data;
+  input.insert(input.end(), data.begin(), data.end());
+  input[0] = NAN;
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, input.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float expected[2];
+  EXPECT_NO_THROW(model->GetOutput(0, expected));
+
+  model->SetZeroCopyInput(true);
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, input.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float observed[2];
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[0]);
+  EXPECT_EQ(observed[1], expected[1]);
+  model->SetZeroCopyInput(false);
+
+  // Mostly missing values: CSR batch. Zeros are values, not missing.
+  std::vector<float> sparse(2 * in_size, NAN);
+  sparse[1] = 0.0f;
+  sparse[in_size + 5] = 0.5f;
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, sparse.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, expected));
+  EXPECT_FALSE(std::isnan(expected[0]));
+  EXPECT_FALSE(std::isnan(expected[1]));
+}
+
+TEST_F(TreeliteTest, TestSingleInstanceMatchesBatch) {
+  const int64_t batch_shape[2] = {2, in_size};
+  std::vector<float> input = data;
+  input.insert(input.end(), data.begin(), data.end());
+  input[in_size + 3] = NAN;
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, input.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float expected[2];
+  EXPECT_NO_THROW(model->GetOutput(0, expected));
+
+  float observed[1];
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, input.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[0]);
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, input.data() + in_size, in_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[1]);
+}
+
+TEST_F(TreeliteTest, TestThreadControl) {
+  const int64_t batch_shape[2] = {2, in_size};
+  std::vector<float> input = data;
+  input.insert(input.end(), data.begin(), data.end());
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, input.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float expected[2];
+  EXPECT_NO_THROW(model->GetOutput(0, expected));
+
+  float observed[2];
+  EXPECT_NO_THROW(model->SetNumThreads(2));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[0]);
+  EXPECT_NO_THROW(model->Run(1));
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[1], expected[1]);
+  EXPECT_THROW(model->Run(0), dmlc::Error);
+#ifdef __linux__
+  cpu_set_t mask;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(mask), &mask), 0);
+  EXPECT_NO_THROW(model->UseCPUAffinity(false));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[0]);
+  // The reloaded workers are not pinned either.
+  for (pid_t tid : ListThreads()) {
+    cpu_set_t thread_mask;
+    ASSERT_EQ(sched_getaffinity(tid, sizeof(thread_mask), &thread_mask), 0);
+    EXPECT_TRUE(CPU_EQUAL(&thread_mask, &mask)) << "thread " << tid;
+  }
+#endif
+}
+
+#ifdef __linux__
+TEST_F(TreeliteTest, TestReleasesPreviousWorkers) {
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, data.data(), in_dim));
+  EXPECT_NO_THROW(model->Run(2));
+  float expected[1];
+  EXPECT_NO_THROW(model->GetOutput(0, expected));
+  // Treelite starts threads - 1 workers, the calling thread being the other one.
+  const size_t num_threads = ListThreads().size();
+  EXPECT_NO_THROW(model->Run(1));
+  EXPECT_EQ(CountThreads(num_threads - 1), num_threads - 1);
+  float observed[1];
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[0]);
+  EXPECT_NO_THROW(model->Run(2));
+  EXPECT_EQ(CountThreads(num_threads), num_threads);
+}
+#endif
+
+TEST_F(TreeliteTest, TestSetSparseInput) {
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, data.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float expected[1];
+  EXPECT_NO_THROW(model->GetOutput(0, expected));
+
+  std::vector<uint32_t> col_ind(in_size);
+  for (uint32_t j = 0; j < in_size; j++) col_ind[j] = j;
+  std::vector<size_t> row_ptr = {0, static_cast<size_t>(in_size)};
+  EXPECT_NO_THROW(
+      model->SetSparseInput(data.data(), col_ind.data(), row_ptr.data(), 1, in_size));
+  EXPECT_EQ(model->GetInputShape(0)[0], 1);
+  EXPECT_NO_THROW(model->Run());
+  float observed[1];
+  EXPECT_NO_THROW(model->GetOutput(0, observed));
+  EXPECT_EQ(observed[0], expected[0]);
+
+  col_ind[3] = in_size;
+  EXPECT_THROW(model->SetSparseInput(data.data(), col_ind.data(), row_ptr.data(), 1, in_size),
+               dmlc::Error);
+  col_ind[3] = 3;
+  row_ptr[0] = 1;
+  EXPECT_THROW(model->SetSparseInput(data.data(), col_ind.data(), row_ptr.data(), 1, in_size),
+               dmlc::Error);
+}
+
+TEST_F(TreeliteTest, TestPredictStream) {
+  const int64_t num_row = 5;
+  std::vector<float> input;
+  for (int64_t i = 0; i < num_row; i++) input.insert(input.end(), data.begin(), data.end());
+  // Mostly missing rows, so that some chunks are assembled as CSR.
+  for (int64_t j = 0; j < in_size; j++) {
+    if (j % 8 != 0) input[3 * in_size + j] = input[4 * in_size + j] = NAN;
+  }
+  const int64_t batch_shape[2] = {num_row, in_size};
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, input.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  std::vector<float> expected(num_row);
+  EXPECT_NO_THROW(model->GetOutput(0, expected.data()));
+
+  size_t next_row = 0;
+  std::vector<float> observed;
+  auto writer = [&](const float* out, size_t n, size_t row_size) {
+    EXPECT_EQ(row_size, 1);
+    EXPECT_LE(n, 2);
+    observed.insert(observed.end(), out, out + n);
+  };
+  size_t num_scored = 0;
+  EXPECT_NO_THROW(num_scored = model->PredictStream(
+                      [&](float* buffer, size_t max_rows) {
+                        const size_t n = std::min<size_t>(max_rows, num_row - next_row);
+                        std::copy_n(input.data() + next_row * in_size, n * in_size, buffer);
+                        next_row += n;
+                        return n;
+                      },
+                      in_size, 2, writer));
+  EXPECT_EQ(num_scored, num_row);
+  EXPECT_EQ(observed, expected);
+  // The batch set before is left untouched.
+  EXPECT_EQ(model->GetInputShape(0)[0], num_row);
+
+#ifndef _WIN32
+  char path[] = "/tmp/dlr_treelite_stream_XXXXXX";
+  const int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(input.data()), input.size() * sizeof(float));
+  file.close();
+  observed.clear();
+  EXPECT_NO_THROW(num_scored = model->PredictFile(path, in_size, 2, writer));
+  EXPECT_EQ(num_scored, num_row);
+  EXPECT_EQ(observed, expected);
+  EXPECT_THROW(model->PredictFile(path, in_size + 1, 2, writer), dmlc::Error);
+  std::remove(path);
+#endif  // _WIN32
+}
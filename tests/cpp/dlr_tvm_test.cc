@@ -52,6 +52,23 @@ TEST_F(TVMTest, TestGetInputSize) { EXPECT_EQ(model->GetInputSize(0), 1 * 224 *
 
 TEST_F(TVMTest, TestGetInputDim) { EXPECT_EQ(model->GetInputDim(0), 4); }
 
+TEST_F(TVMTest, TestSetInputBatchGetOutputBatch) {
+  const void* samples[1] = {img.data()};
+  EXPECT_NO_THROW(model->SetInputBatch("input_tensor", samples, 1));
+  std::vector<float> observed_input_data(img_size);
+  EXPECT_NO_THROW(model->GetInput("input_tensor", observed_input_data.data()));
+  EXPECT_EQ(img, observed_input_data);
+  EXPECT_THROW(model->SetInputBatch("input_tensor", samples, 2), dmlc::Error);
+  EXPECT_NO_THROW(model->Run());
+
+  std::vector<float> output(1001);
+  std::vector<float> output_batch(1001);
+  void* dests[1] = {output_batch.data()};
+  EXPECT_NO_THROW(model->GetOutput(1, output.data()));
+  EXPECT_NO_THROW(model->GetOutputBatch(1, dests, 1));
+  EXPECT_EQ(output, output_batch);
+}
+
 TEST(TVM, TestTvmModelApisWithOutputMetadata) {
   const int device_type = 1;  // 1 - kDLCPU
   const int device_id = 0;
@@ -225,6 +242,68 @@ TEST(TVM, TestTvmModelGetDeviceTypeFromMetadata) {
   std::rename(metadata_file_bak.c_str(), metadata_file.c_str());
 }
 
+TEST(TVM, TestImageTransformInput) {
+  // The model with an Image transform added to its metadata, which swaps the channels to BGR.
+  const std::string model_path = "./resnet_v1_5_50";
+  std::string graph_str = dlr::LoadFileToString(model_path + "/compiled_model.json");
+  std::string params_str =
+      dlr::LoadFileToString(model_path + "/compiled.params", std::ios::in | std::ios::binary);
+  const std::string so_file = model_path + "/compiled.so";
+  nlohmann::json metadata =
+      nlohmann::json::parse(dlr::LoadFileToString(model_path + "/compiled.meta"));
+  metadata["DataTransform"]["Input"]["Image"] = {
+      {"Layout", "NHWC"}, {"ChannelOrder", "BGR"}, {"Resize", "Nearest"}};
+  const std::string meta_str = metadata.dump();
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, nullptr, graph_str.c_str(), 0},
+      {DLRModelElemType::TVM_PARAMS, nullptr, params_str.data(), params_str.size()},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0},
+      {DLRModelElemType::NEO_METADATA, nullptr, meta_str.c_str(), 0}};
+  dlr::TVMModel model(model_elems, DLContext{kDLCPU, 0});
+
+  // The float32 input takes uint8 images.
+  EXPECT_STREQ(model.GetInputType(0), "uint8");
+  EXPECT_EQ(model.GetImageInputIndex(), 0);
+
+  const int64_t shape[4] = {1, 224, 224, 3};
+  std::vector<uint8_t> image(224 * 224 * 3);
+  for (size_t i = 0; i < image.size(); i++) image[i] = i % 251;
+  const std::vector<uint8_t> black(image.size(), 0);
+  std::vector<float> expected(image.size());
+  for (size_t p = 0; p < image.size(); p += 3) {
+    for (int c = 0; c < 3; c++) expected[p + c] = image[p + 2 - c];
+  }
+  std::vector<float> observed(image.size());
+
+  EXPECT_NO_THROW(model.SetInput("input_tensor", shape, image.data(), 4));
+  EXPECT_NO_THROW(model.GetInput("input_tensor", observed.data()));
+  EXPECT_EQ(observed, expected);
+
+  EXPECT_NO_THROW(model.SetInput("input_tensor", shape, black.data(), 4));
+  DLTensor tensor;
+  tensor.data = image.data();
+  tensor.ctx = DLContext{kDLCPU, 0};
+  tensor.ndim = 4;
+  tensor.dtype = DLDataType{kDLUInt, 8, 1};
+  tensor.shape = const_cast<int64_t*>(shape);
+  tensor.strides = nullptr;
+  tensor.byte_offset = 0;
+  EXPECT_NO_THROW(model.SetInputTensor("input_tensor", &tensor));
+  EXPECT_NO_THROW(model.GetInput("input_tensor", observed.data()));
+  EXPECT_EQ(observed, expected);
+
+  EXPECT_NO_THROW(model.SetInput("input_tensor", shape, black.data(), 4));
+  dlr::ImageView view;
+  view.width = 224;
+  view.height = 224;
+  view.planes[0] = image.data();
+  view.strides[0] = 224 * 3;
+  EXPECT_NO_THROW(model.SetImageInput("input_tensor", &view, 1));
+  EXPECT_NO_THROW(model.GetInput("input_tensor", observed.data()));
+  EXPECT_EQ(observed, expected);
+  EXPECT_NO_THROW(model.Run());
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
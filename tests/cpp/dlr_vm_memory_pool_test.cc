@@ -0,0 +1,73 @@
+#include "dlr_vm_memory_pool.h"
+
+#include <gtest/gtest.h>
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+class VMMemoryPoolTest : public ::testing::Test {
+ protected:
+  DLDataType dtype = {kDLFloat, 32, 1};
+  DLContext ctx = {kDLCPU, 0};
+  const size_t page = dlr::VMMemoryPool::kPageSize;
+  dlr::VMMemoryPool* pool = new dlr::VMMemoryPool(ctx);
+
+  ~VMMemoryPoolTest() { pool->Detach(); }
+};
+
+TEST_F(VMMemoryPoolTest, ReusesFreedBlocks) {
+  tvm::runtime::vm::Buffer a = pool->Alloc(100, 64, dtype);
+  EXPECT_EQ(a.size, page);
+  EXPECT_EQ(pool->UsedMemory(), page);
+  EXPECT_EQ(pool->GetIdleBytes(), 0);
+  pool->Free(a);
+  EXPECT_EQ(pool->UsedMemory(), page);
+  EXPECT_EQ(pool->GetIdleBytes(), page);
+  // Same rounded size.
+  tvm::runtime::vm::Buffer b = pool->Alloc(page, 64, dtype);
+  EXPECT_EQ(b.data, a.data);
+  EXPECT_EQ(pool->GetIdleBytes(), 0);
+  tvm::runtime::vm::Buffer c = pool->Alloc(page + 1, 64, dtype);
+  EXPECT_EQ(c.size, 2 * page);
+  EXPECT_EQ(pool->UsedMemory(), 3 * page);
+  pool->Free(b);
+  pool->Free(c);
+}
+
+TEST_F(VMMemoryPoolTest, TrimsToWatermark) {
+  std::vector<tvm::runtime::vm::Buffer> buffers;
+  for (size_t pages : {1, 2, 4}) {
+    buffers.push_back(pool->Alloc(pages * page, 64, dtype));
+  }
+  tvm::runtime::vm::Buffer in_use = pool->Alloc(8 * page, 64, dtype);
+  for (const auto& buffer : buffers) pool->Free(buffer);
+  EXPECT_EQ(pool->GetIdleBytes(), 7 * page);
+  EXPECT_EQ(pool->UsedMemory(), 15 * page);
+
+  // Largest idle blocks go first, the block in use stays.
+  EXPECT_EQ(pool->TrimIdle(3 * page), 4 * page);
+  EXPECT_EQ(pool->GetIdleBytes(), 3 * page);
+  EXPECT_EQ(pool->UsedMemory(), 11 * page);
+  EXPECT_EQ(pool->TrimIdle(0), 3 * page);
+  EXPECT_EQ(pool->GetIdleBytes(), 0);
+  EXPECT_EQ(pool->UsedMemory(), 8 * page);
+  pool->Free(in_use);
+  EXPECT_EQ(pool->GetIdleBytes(), 8 * page);
+}
+
+TEST_F(VMMemoryPoolTest, OutlivesDetachWhileInUse) {
+  dlr::VMMemoryPool* detached = new dlr::VMMemoryPool(ctx);
+  tvm::runtime::vm::Buffer idle = detached->Alloc(page, 64, dtype);
+  tvm::runtime::vm::Buffer in_use = detached->Alloc(page, 64, dtype);
+  detached->Free(idle);
+  detached->Detach();
+  // The idle block is released at once, the block in use when it is freed, with the pool.
+  EXPECT_EQ(detached->UsedMemory(), page);
+  EXPECT_EQ(detached->GetIdleBytes(), 0);
+  detached->Free(in_use);
+}
@@ -1,6 +1,7 @@
 // dlr
 #include "dlr.h"
 #include "dlr_tvm.h"
+#include "dlr_postprocess.h"
 #include "amba_tvm.h"
 
 // system
@@ -228,44 +229,21 @@ static int dlr_read_binary(const char* filename, float *t, int64_t size)
 
 static int dlr_process_classification(dlr_ctx_t *p_ctx, const float* out, int num_cls)
 {
-	auto out_iter = out;
-	auto max_iter = std::max_element(out_iter, out_iter + num_cls);
-	auto max_index = std::distance(out_iter, max_iter);
+	dlr::Postprocess top5(5, true);
+	DLRClassScore top[5];
+	int num = top5.GetNumResults(num_cls);
 
-	float prob_sum = 0.0;
-	float prob_softmax[num_cls] = {0.0};
-	int prob_id[num_cls] = {0};
+	top5.Apply(out, 1, num_cls, top);
 
-	for(int i = 0; i < num_cls; ++i) {
-		prob_softmax[i] = exp(out_iter[i] - out_iter[max_index]);
-		prob_sum += prob_softmax[i];
-	}
-	for (int i = 0; i < num_cls; ++i) {
-		prob_softmax[i] /= prob_sum;
-		prob_id[i] = i;
+	printf("Top %d categories:", num);
+	for (int i = 0; i < num; ++i) {
+		printf("%s %d", i ? "," : "", top[i].index);
 	}
-	for (int i = 0; i < 5; ++ i) {
-		float max_conf = prob_softmax[i];
-		int max_id = i;
-		for (int j = i + 1; j < num_cls; ++ j) {
-			float conf = prob_softmax[j];
-			if (conf > max_conf) {
-				max_id = j;
-				max_conf = conf;
-			}
-		}
-		if (max_id != i) {
-			prob_id[max_id] = i;
-			prob_softmax[max_id] = prob_softmax[i];
-			prob_id[i] = max_id;
-			prob_softmax[i] = max_conf;
-		}
+	printf("\nTop %d scores:", num);
+	for (int i = 0; i < num; ++i) {
+		printf("%s %.4f", i ? "," : "", top[i].score);
 	}
-
-	printf("Top 5 categories: %d, %d, %d, %d, %d\n", prob_id[0], prob_id[1], prob_id[2],
-		prob_id[3], prob_id[4]);
-	printf("Top 5 scores: %.4f, %.4f, %.4f, %.4f, %.4f\n", prob_softmax[0], prob_softmax[1],
-		prob_softmax[2], prob_softmax[3], prob_softmax[4]);
+	printf("\n");
 
 	return 0;
 }